@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CODES_COLLECTIVES_H
+#define CODES_COLLECTIVES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* Decomposition of MPI-style collectives into point-to-point schedules.
+ *
+ * A collective over nranks ranks is described by a codes_col_desc. Its
+ * schedule is a sequence of rounds that is the same for every rank; in each
+ * round a rank sends at most one message and receives at most one message
+ * (either may be absent). A message sent from a to b in round r is received
+ * by b in round r, so running the rounds in order with each round completed
+ * before the next one starts never deadlocks, whatever the network does.
+ *
+ * Nothing here touches LP or simulation state: a schedule is a pure
+ * function of the descriptor, so callers can regenerate any round on demand
+ * (e.g. after a rollback) instead of storing it. The library does link
+ * against ROSS, for tw_error on invalid descriptors and algorithm names.
+ *
+ * num_bytes follows the MPI call the collective stands for:
+ * - BCAST, REDUCE, ALLREDUCE: size of the whole buffer
+ * - ALLGATHER: size of each rank's contribution
+ * - ALLTOALL: size of the block sent to each rank
+ */
+
+enum codes_col_type {
+    CODES_COL_BCAST,
+    CODES_COL_REDUCE,
+    CODES_COL_ALLREDUCE,
+    CODES_COL_ALLGATHER,
+    CODES_COL_ALLTOALL
+};
+
+enum codes_col_algo {
+    /* pick by type, size and rank count (see codes_col_thresholds) */
+    CODES_COL_ALGO_AUTO,
+    /* BCAST/REDUCE */
+    CODES_COL_ALGO_BINOMIAL,
+    /* ALLREDUCE, ALLGATHER */
+    CODES_COL_ALGO_RING,
+    CODES_COL_ALGO_RECURSIVE_DOUBLING,
+    /* ALLREDUCE: recursive-halving reduce-scatter + recursive-doubling
+     * allgather */
+    CODES_COL_ALGO_RABENSEIFNER,
+    /* ALLTOALL */
+    CODES_COL_ALGO_PAIRWISE
+};
+
+/* size thresholds (in bytes, as num_bytes above) for CODES_COL_ALGO_AUTO.
+ * The defaults follow MPICH:
+ * - ALLREDUCE: recursive doubling below allreduce_short, Rabenseifner above
+ *   it, ring above allreduce_long
+ * - ALLGATHER: recursive doubling while the gathered total is below
+ *   allgather_long and nranks is a power of two, ring otherwise */
+struct codes_col_thresholds {
+    int64_t allreduce_short;
+    int64_t allreduce_long;
+    int64_t allgather_long;
+};
+
+extern struct codes_col_thresholds const codes_col_default_thresholds;
+
+struct codes_col_desc {
+    enum codes_col_type type;
+    enum codes_col_algo algo; /* never AUTO once initialized */
+    int nranks;
+    int rank;
+    int root;
+    int64_t num_bytes;
+};
+
+/* one round of a rank's schedule. A peer of -1 means no send / receive in
+ * this round */
+struct codes_col_step {
+    int send_peer;
+    int64_t send_bytes;
+    int recv_peer;
+    int64_t recv_bytes;
+};
+
+/* fill d for the given collective as seen from rank. algo may be AUTO, in
+ * which case th (or the defaults, if th is NULL) select the algorithm.
+ * tw_error on an algorithm that cannot implement the collective */
+void codes_col_init(
+        struct codes_col_desc *d,
+        enum codes_col_type type,
+        enum codes_col_algo algo,
+        int nranks,
+        int rank,
+        int root,
+        int64_t num_bytes,
+        struct codes_col_thresholds const *th);
+
+/* number of rounds in the schedule (identical across the ranks of a
+ * collective) */
+int codes_col_num_rounds(struct codes_col_desc const *d);
+
+/* the calling rank's part of round 0 <= round < codes_col_num_rounds(d) */
+void codes_col_get_step(
+        struct codes_col_desc const *d,
+        int round,
+        struct codes_col_step *step);
+
+/* tag of the messages of round of a rank's seq-th collective. Tags below -1
+ * (MPI_ANY_TAG) never collide with the application's */
+#define CODES_COL_TAG(seq, round) (-2 - ((((seq) & 0x3ff) << 20) | (round)))
+#define CODES_COL_IS_TAG(tag) ((tag) < -1)
+
+/* whether a receive posted for tag from source (-1: any) takes a message
+ * with msg_tag from msg_source. MPI runs collectives on a communicator of
+ * their own, so wildcards never take a message of a collective
+ * (msg_is_col) */
+int codes_col_recv_matches(int tag, int source, int msg_tag, int msg_source,
+        int msg_is_col);
+
+/* parse an algorithm name as found in config files / command lines ("auto",
+ * "ring", "recursive-doubling", "rabenseifner", "binomial", "pairwise").
+ * tw_error on anything else */
+enum codes_col_algo codes_col_algo_from_str(char const *str);
+char const * codes_col_algo_to_str(enum codes_col_algo algo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CODES_COLLECTIVES_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
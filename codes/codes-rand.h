@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef CODES_RAND_H
+#define CODES_RAND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <ross.h>
+
+/* Counter-based random numbers (Philox-4x32-10).
+ *
+ * Every draw is a pure function of (LP, event, draw index): the LP's global
+ * ID and the seed form the key, and the event is identified by the LP's
+ * current time and a caller-chosen salt (e.g. the event type). A handler
+ * calls codes_rand_begin when it starts processing an event and then draws
+ * as it likes. Nothing has to be counted in the message and nothing has to
+ * be undone in the reverse handler: when the event is executed again after a
+ * rollback, it gets the same numbers.
+ *
+ * Events of an LP with the same timestamp and salt get the same numbers. The
+ * network models jitter their timestamps, so this does not happen in
+ * practice; when it can, use a salt that tells such events apart.
+ *
+ * The stream is kept in the LP state but needs no reverse computation, as
+ * codes_rand_begin resets it for every event. */
+typedef struct codes_rand
+{
+    uint32_t key[2];
+    uint32_t ctr[4]; /* draw index, salt, event time */
+} codes_rand;
+
+/* seed mixed into every key (codes_mapping_setup_with_seed_offset sets it to
+ * its offset) */
+void codes_rand_set_seed(uint32_t seed);
+
+/* start the stream of the event lp is about to process */
+void codes_rand_begin(codes_rand *r, tw_lp *lp, uint32_t salt);
+
+/* uniform in (0,1) */
+double codes_rand_unif(codes_rand *r);
+/* uniform in [low,high], low if high < low (as tw_rand_integer) */
+long codes_rand_integer(codes_rand *r, long low, long high);
+/* exponential with the given mean */
+double codes_rand_exponential(codes_rand *r, double mean);
+
+/* raw Philox-4x32-10 block function: ctr is replaced by the output */
+void codes_rand_philox4x32(uint32_t ctr[4], const uint32_t key[2]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CODES_RAND_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -241,6 +241,7 @@ struct codes_workload_op
         /* TODO: non-stub for other collectives */
         struct {
             int num_bytes;
+            int root; /* root rank of rooted collectives (bcast, reduce) */
         } collective;
         struct {
             int count;
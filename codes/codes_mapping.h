@@ -37,6 +37,25 @@ void codes_mapping_setup(void);
  */
 void codes_mapping_setup_with_seed_offset(int offset);
 
+/* Placement hint for PARAMS:pe_partition="group": LPs of type lp_type_name
+ * form topology units (e.g. the routers of a dragonfly group) of
+ * lps_per_unit LPs each, and the repetitions of the LP group holding one unit
+ * are kept on the same PE. Must be called before codes_mapping_setup (model-net
+ * networks do so in model_net_register).
+ *
+ * The PE partition is selected by PARAMS:pe_partition:
+ * - "block" (default): contiguous, evenly sized ranges of LP IDs
+ * - "group": contiguous ranges of LP IDs, split only between topology units
+ *   (or between repetitions of an LP group if no hint applies)
+ * - "file": the PE of every LP is read from PARAMS:pe_partition_file (relative
+ *   to the configuration file), one partition number per line in LP ID order
+ *   (e.g. a METIS partition of the LP communication graph); partition p goes
+ *   to PE p % (number of PEs)
+ * PARAMS:kp_partition="block" places contiguous LPs of a PE on the same KP
+ * instead of dealing them round-robin ("round-robin", the default). */
+void codes_mapping_add_partition_hint(const char * lp_type_name,
+        int lps_per_unit);
+
 /*Takes the group name and returns the number of repetitions in the group */
 int codes_mapping_get_group_reps(const char* group_name);
 
@@ -31,6 +31,30 @@ int lp_io_write_rev(tw_lpid gid, char* identifier);
 /* to be called (collectively) after tw_run() to flush data to disk */
 int lp_io_flush(lp_io_handle handle, MPI_Comm comm);
 
+/* Shared per-PE formatting buffer for finalize and sampling output, so that
+ * LP states do not have to embed their own scratch buffers. A record is
+ * built with one or more lp_io_fmt calls and handed to lp_io_write with
+ * lp_io_fmt_write, which also starts the next record. The buffer grows as
+ * needed. Only one record may be under construction at a time */
+
+/* append printf-style output to the current record; returns the number of
+ * characters appended */
+int lp_io_fmt(char const * fmt, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+
+/* lp_io_write the current record and start a new one */
+int lp_io_fmt_write(tw_lpid gid, char* identifier);
+
+/* discard the current record */
+void lp_io_fmt_reset(void);
+
+/* the current record (NUL-terminated) and its length */
+char const * lp_io_fmt_buf(void);
+int lp_io_fmt_len(void);
+
 /* retrieves the directory name for a handle */
 static inline char* lp_io_handle_to_dir(lp_io_handle handle)
 {
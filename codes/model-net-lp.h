@@ -32,6 +32,8 @@ extern "C" {
 #include "net/simplep2p.h"
 #include "net/torus.h"
 #include "net/express-mesh.h"
+#include "net/flownet.h"
+#include "net/graphnet.h"
 
 extern int model_net_base_magic;
 
@@ -112,14 +114,26 @@ enum model_net_base_event_type {
     // gather a sample from the underlying model
     MN_BASE_SAMPLE,
     // message goes directly down to topology-specific event handler
-    MN_BASE_PASS
+    MN_BASE_PASS,
+    // batch of messages from model_net_event_multi
+    MN_BASE_NEW_MULTI
 };
 
+// one destination of an MN_BASE_NEW_MULTI event. The event carries the
+// remote/self event templates right after the wrap message, followed by
+// num_dests of these
+typedef struct model_net_multi_dest {
+    tw_lpid final_dest_lp;
+    tw_lpid dest_mn_lp;
+    uint64_t msg_size;
+} model_net_multi_dest;
+
 typedef struct model_net_base_msg {
     // no need for event type - in wrap message
     model_net_request req;
     int is_from_remote;
     int isQueueReq;
+    int num_dests; // MN_BASE_NEW_MULTI only
     tw_stime save_ts;
     // parameters to pass to new messages (via model_net_set_msg_params)
     // TODO: make this a union for multiple types of parameters
@@ -142,6 +156,8 @@ typedef struct model_net_wrap_msg {
         sp_message              m_sp2p;  // simplep2p
         nodes_message           m_torus; // torus
         em_message              m_em; // express-mesh
+        fn_message              m_flow; // flownet
+        graph_message           m_graph; // graphnet
         // add new ones here
     } msg;
 } model_net_wrap_msg;
@@ -12,6 +12,7 @@ extern "C" {
 #endif
 
 #include <ross.h>
+#include "codes/codes.h"
 
 // forward decl of model_net_method since we currently have a circular include
 // (method needs sched def, sched needs method def)
@@ -65,10 +66,44 @@ struct model_net_method
     final_f mn_sample_fini_fn;
     void (*mn_model_stat_register)(st_model_types *base_type);
     const st_model_types* (*mn_get_model_stat_types)();
+    /* Report the topology units of the network (dragonfly groups, fat-tree
+     * pods) through codes_mapping_add_partition_hint. Called by
+     * model_net_register, before codes_mapping_setup. May be NULL. */
+    void (*mn_partition_hint)();
+    /* Minimum offset of the events the network's LPs send to LPs that may be
+     * mapped to another PE, derived from the configured latencies (called
+     * after codes_mapping_setup and mn_configure). Used for
+     * PARAMS:topology_lookahead; 0 or a NULL callback means the network
+     * can't guarantee one. */
+    tw_stime (*mn_lookahead)();
 };
 
 extern struct model_net_method * method_array[];
 
+/* set by model_net_configure when g_tw_lookahead was derived from the
+ * network latencies (PARAMS:topology_lookahead) */
+extern int mn_topology_lookahead;
+
+/* Offset of an event crossing a link of the given latency. g_tw_lookahead is
+ * added as a safety margin, unless it was derived from the latencies: they
+ * then cover it already, and padding them would slow every link down. */
+static inline tw_stime model_net_link_offset(tw_stime latency)
+{
+    return mn_topology_lookahead ? latency : g_tw_lookahead + latency;
+}
+
+/* codes_local_latency for the self events of network LPs, which don't need
+ * the lookahead margin either in that case (reversed by
+ * codes_local_latency_reverse) */
+static inline tw_stime model_net_self_latency(tw_lp *lp)
+{
+    if (!mn_topology_lookahead)
+        return codes_local_latency(lp);
+    int r = g_tw_nRNG_per_lp-1;
+    return CODES_MIN_LATENCY +
+        tw_rand_unif(&lp->rng[r]) * CODES_LATENCY_RANGE;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -79,6 +79,9 @@ typedef struct mn_stats mn_stats;
     X(DRAGONFLY_PLUS_ROUTER, "modelnet_dragonfly_plus_router", "dragonfly_plus_router", &dragonfly_plus_router_method)\
     X(DRAGONFLY_DALLY, "modelnet_dragonfly_dally", "dragonfly_dally", &dragonfly_dally_method)\
     X(DRAGONFLY_DALLY_ROUTER, "modelnet_dragonfly_dally_router", "dragonfly_dally_router", &dragonfly_dally_router_method)\
+    X(FLOWNET,   "modelnet_flownet",   "flownet",   &flownet_method)\
+    X(GRAPHNET,  "modelnet_graphnet",  "graphnet",  &graphnet_method)\
+    X(GRAPHNET_ROUTER, "modelnet_graphnet_router", "graphnet_router", &graphnet_router_method)\
     X(MAX_NETS,  NULL,                 NULL,        NULL)
 
 #define X(a,b,c,d) a,
@@ -290,6 +293,37 @@ model_net_event_return model_net_event_mctx(
         tw_lp *sender);
 
 
+/*
+ * Batched variant of model_net_event for collectives and all-to-all style
+ * traffic: sends one message of message_sizes[i] bytes to each
+ * final_dest_lps[i], i < num_dests. remote_event and self_event are
+ * templates - every destination receives its own copy of remote_event and
+ * the sender receives one self_event per message, exactly as if
+ * model_net_event had been called once per destination. Parameters set with
+ * model_net_set_msg_param apply to every message of the batch.
+ *
+ * Instead of one modelnet event per destination, the destinations are packed
+ * into as few events as g_tw_msg_sz allows, each enqueued on the sender's
+ * modelnet LP in one pass (and undone by a single reverse handler).
+ * Destinations attached to the sender's own modelnet LP take the regular
+ * model_net_event path.
+ *
+ * Reverse with model_net_event_rc2 on the returned value.
+ */
+model_net_event_return model_net_event_multi(
+        int net_id,
+        char const * category,
+        int num_dests,
+        tw_lpid const * final_dest_lps,
+        uint64_t const * message_sizes,
+        tw_stime offset,
+        int remote_event_size,
+        void const * remote_event,
+        int self_event_size,
+        void const * self_event,
+        tw_lp *sender);
+
+
 /* model_net_find_local_device()
  *
  * returns the LP id of the network card attached to the calling LP using the
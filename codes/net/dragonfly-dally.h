@@ -13,6 +13,9 @@ extern "C" {
 
 #include <ross.h>
 
+/* most QoS levels a dragonfly-dally network can be configured with */
+#define DFLY_DALLY_MAX_QOS_LEVELS 3
+
 typedef struct terminal_dally_message terminal_dally_message;
 
 /* this message is used for both dragonfly compute nodes and routers */
@@ -49,6 +52,10 @@ struct terminal_dally_message
   short my_l_hop, my_g_hop;
   short saved_channel;
   short saved_vc;
+  /* rail (plane) the chunk travels on, on terminal buffer messages the rail
+   * credited and on T_SEND the rail to send on; T_GENERATE: rail the packet
+   * was put on (unless striped) */
+  short rail_id;
 
   int next_stop;
 
@@ -64,6 +71,11 @@ struct terminal_dally_message
   int saved_src_chan;
 
    uint32_t chunk_id;
+   /* packet trains: chunks chunk_id .. chunk_id+train_len-1 of the packet
+    * travel as one event, chunk i arriving train_gap*i after the first.
+    * On buffer messages, the number of chunks credited back. */
+   uint32_t train_len;
+   tw_stime train_gap;
    uint32_t packet_size;
    uint32_t message_id;
    uint32_t total_size;
@@ -74,25 +86,36 @@ struct terminal_dally_message
   // For buffer message
    short vc_index;
    int output_chan;
+   /* R_CREDIT_FLUSH: sender owed the held credits and the batch they belong
+    * to (see credit_batch in dragonfly-dally.C) */
+   tw_lpid credit_dest;
+   unsigned long credit_gen;
    model_net_event_return event_rc;
    int is_pull;
    uint32_t pull_size;
    int path_type;
 
-   /* for reverse computation */   
-   short num_rngs;
+   /* R_FAULT: failure schedule entry applied by the event */
+   int fault_id;
+   int saved_faults_applied; /* entries in force before the event */
+
+   /* for reverse computation (random numbers need none, see
+    * codes/codes-rand.h) */
    short num_cll;
+   uint32_t saved_train_len;
+   uint32_t saved_credits;
+   uint32_t saved_send_loops; /* rails whose send loop a T_GENERATE started */
 
    /* qos related attributes */
    short last_saved_qos;
    short qos_reset1;
    short qos_reset2;
 
-   /* new qos rc - These are calloced in forward events, free'd in RC or commit_f */
-   /* note: dynamic memory here is OK since it's only accessed by the LP that alloced it in the first place. */
-   short rc_is_qos_set;
-   unsigned long long * rc_qos_data;
-   int * rc_qos_status;
+   /* qos bandwidth window closed by this send (-1 if none) and the
+    * counters it held */
+   long saved_qos_window;
+   int saved_qos_data[DFLY_DALLY_MAX_QOS_LEVELS];
+   short saved_qos_status[DFLY_DALLY_MAX_QOS_LEVELS];
 
    tw_stime saved_available_time;
    tw_stime saved_avg_time;
@@ -87,6 +87,11 @@ struct fattree_message
   size_t qos_table_index;
   size_t qos_table_counter;
 
+  /* S_FAULT: entry of the failure schedule, and the entries in force
+   * before it for reverse computation */
+  int fault_id;
+  int saved_faults_applied;
+
 };
 
 #endif /* end of include guard: FATTREE_H */
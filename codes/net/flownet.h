@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef FLOWNET_H
+#define FLOWNET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct fn_message fn_message;
+
+enum fn_event_type
+{
+    FN_FLOW_START = 1, /* (controller) a new flow enters the network */
+    FN_FLOW_TIMER,     /* (controller) earliest active flow may be done */
+    FN_FLOW_ARRIVE,    /* (destination) last byte of a flow arrived */
+    FN_FLOW_SENT,      /* (source) last byte of a flow left the source */
+};
+
+struct fn_message
+{
+    int magic; /* magic number */
+    enum fn_event_type event_type;
+    tw_lpid src_gid; /* who transmitted this msg? */
+    tw_lpid src_mn_lp; // src modelnet id, provided by sender
+    tw_lpid final_dest_gid; /* who is eventually targetted with this msg? */
+    tw_lpid dest_mn_lp; // destination modelnet id, provided by sender
+    uint64_t net_msg_size_bytes;     /* size of modeled network message */
+    int event_size_bytes;     /* size of simulator event message that will be tunnelled to destination */
+    int local_event_size_bytes;     /* size of simulator event message that delivered locally upon local completion */
+    char category[CATEGORY_NAME_MAX]; /* category for communication */
+
+    model_net_event_return event_rc;
+    int is_pull;
+    uint64_t pull_size;
+
+    /* FN_FLOW_TIMER: rate allocation the timer was scheduled under */
+    uint64_t timer_gen;
+    /* FN_FLOW_ARRIVE/SENT: time the flow spent in the network */
+    tw_stime flow_time;
+
+    /* for reverse computation */
+    int num_done; /* flows completed by this controller event */
+    int is_stale; /* timer from an outdated rate allocation */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: FLOWNET_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef NET_FAULTS_H
+#define NET_FAULTS_H
+
+/* failure schedules: links or routers of a network model that go down, come
+ * back up or change their bandwidth at given times. The models apply the
+ * entries as timestamped events and route around the ports that are down
+ * (graphnet, dragonfly-dally, fattree and torus). */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum net_fault_target
+{
+  FAULT_LINK = 1,
+  FAULT_ROUTER
+};
+
+enum net_fault_action
+{
+  FAULT_DOWN = 1,
+  FAULT_UP,
+  FAULT_BANDWIDTH
+};
+
+/* an entry of the failure schedule */
+struct net_fault
+{
+  double time;
+  int target; /* link a-b (every link between the two routers) or router a */
+  int a, b;
+  int action;
+  double bandwidth; /* FAULT_BANDWIDTH: new bandwidth of the link(s) */
+};
+
+/* reads the failure schedule in fname, of routers 0..num_routers-1:
+ *   <time (ns)> link <router> <router> down|up|<bandwidth (GiB/s)>
+ *   <time (ns)> router <router> down|up
+ * one entry per line, '#' comments. Returns the number of entries, and in
+ * *faults (malloc'ed) the entries sorted by time; entries with the same time
+ * stay in file order. Whether the links exist is up to the model. */
+int net_read_faults(const char *fname, int num_routers,
+    struct net_fault **faults);
+
+/* whether fault f concerns the links between routers u and v */
+int net_fault_hits(const struct net_fault *f, int u, int v);
+
+/* whether the links between routers u and v are down after the first n
+ * entries of the schedule, because of the links or of either router */
+int net_link_down(const struct net_fault *faults, int n, int u, int v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: NET_FAULTS_H */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef NET_JOBS_H
+#define NET_JOBS_H
+
+/* per-job slowdown of a network model: the latency of the packets of each
+ * job over their zero-load latency, which the model estimates. Jobs come
+ * from an MPI-replay style allocation file (PARAMS:job_alloc_file, rank i on
+ * terminal i); without it all terminals are job 0. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct codes_jobmap_ctx;
+
+struct net_jobs
+{
+  struct codes_jobmap_ctx *map;
+  int num_jobs;
+  /* whether the report is printed, i.e. packets have to be recorded */
+  int enabled;
+  long *packets;
+  double *latency;
+  double *ideal;
+};
+
+/* reads PARAMS:job_alloc_file. The report is enabled by the file, or by
+ * force (e.g. when the model has a failure schedule). */
+void net_jobs_init(struct net_jobs *jobs, int force);
+
+/* a packet from terminal src arrived after latency, ideal at zero load, and
+ * its reverse */
+void net_jobs_packet(struct net_jobs *jobs, int src, double latency,
+    double ideal);
+void net_jobs_packet_rc(struct net_jobs *jobs, int src, double latency,
+    double ideal);
+
+/* reduces the counters of all processes and prints the report on the first
+ * one; collective, a no-op unless enabled */
+void net_jobs_report(struct net_jobs *jobs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: NET_JOBS_H */
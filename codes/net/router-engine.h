@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef ROUTER_ENGINE_H
+#define ROUTER_ENGINE_H
+
+/**
+ * router-engine.h -- router port state and chunk pipeline shared by the
+ * packet-level network models (C++ only)
+ *
+ * The models derived from net-template.C all carry the same per-port
+ * machinery: VC occupancy and credits, pending and queued chunk lists, the
+ * output port's next available time, busy time and link traffic, plus the
+ * receive/send/credit handlers over them and their reverse handlers. This
+ * header holds one copy of it:
+ *
+ * - PortBlock<NPorts, NVcs> keeps the state of every port of an LP in a single
+ *   allocation, laid out as a struct of arrays. When the port or VC count is
+ *   known at compile time it is a template argument and all the offsets fold
+ *   into constants; RE_DYNAMIC takes the count at init() instead.
+ * - RouterEngine<Policy> implements the router pipeline on top of a
+ *   PortBlock. Everything topology specific is in the Policy class: how
+ *   the next port and VC are chosen, where credits and chunks go, link
+ *   timing and VC arbitration. A new topology only has to write a policy.
+ *
+ * See the graphnet and dragonfly-dally models for policies.
+ */
+
+#include <ross.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codes/model-net-method.h"
+#include "codes/net/common-net.h"
+#include "codes/rc-stack.h"
+
+/* port or VC count given at run time, to PortBlock::init */
+#define RE_DYNAMIC 0
+
+/**
+ * @brief Per-port state of a router or terminal, in one contiguous block.
+ *
+ * Arrays indexed by port: next_output_available_time, last_buf_full,
+ * busy_time, busy_time_sample, link_traffic, link_traffic_sample,
+ * in_send_loop, queued_count. Arrays indexed by port and VC: vc_occupancy,
+ * pending, pending_tail, queued, queued_tail; the accessors taking a port
+ * return that port's row, which is what the chunk list helpers (those of
+ * common-net.h for message_list chunks) expect. Chunk is the list entry
+ * type of the model.
+ *
+ * @note The LP state is raw memory, so PortBlock has no constructor; call
+ * init() from the LP's init function and destroy() from its final function.
+ */
+template <int NPorts = RE_DYNAMIC, int NVcs = RE_DYNAMIC,
+         class Chunk = message_list>
+struct PortBlock
+{
+  int rt_ports, rt_vcs; /* used when the template arguments are RE_DYNAMIC */
+  char *base;
+
+  int ports() const { return NPorts ? NPorts : rt_ports; }
+  int vcs() const { return NVcs ? NVcs : rt_vcs; }
+
+  /* layout, from the widest type down so that no padding is needed */
+  tw_stime* next_output_available_time() const { return (tw_stime*)base; }
+  tw_stime* last_buf_full() const { return next_output_available_time() + ports(); }
+  tw_stime* busy_time() const { return last_buf_full() + ports(); }
+  tw_stime* busy_time_sample() const { return busy_time() + ports(); }
+  int64_t* link_traffic() const { return (int64_t*)(busy_time_sample() + ports()); }
+  int64_t* link_traffic_sample() const { return link_traffic() + ports(); }
+  Chunk** pending_base() const { return (Chunk**)(link_traffic_sample() + ports()); }
+  Chunk** pending_tail_base() const { return pending_base() + ports() * vcs(); }
+  Chunk** queued_base() const { return pending_tail_base() + ports() * vcs(); }
+  Chunk** queued_tail_base() const { return queued_base() + ports() * vcs(); }
+  int* vc_occupancy_base() const { return (int*)(queued_tail_base() + ports() * vcs()); }
+  int* in_send_loop() const { return vc_occupancy_base() + ports() * vcs(); }
+  int* queued_count() const { return in_send_loop() + ports(); }
+
+  int* vc_occupancy(int port) const { return vc_occupancy_base() + port * vcs(); }
+  Chunk** pending(int port) const { return pending_base() + port * vcs(); }
+  Chunk** pending_tail(int port) const { return pending_tail_base() + port * vcs(); }
+  Chunk** queued(int port) const { return queued_base() + port * vcs(); }
+  Chunk** queued_tail(int port) const { return queued_tail_base() + port * vcs(); }
+
+  size_t bytes() const {
+    return (char*)(queued_count() + ports()) - base;
+  }
+
+  /* allocate and zero the block; the counts are ignored where they are
+   * template arguments */
+  void init(int num_ports, int num_vcs) {
+    rt_ports = num_ports;
+    rt_vcs = num_vcs;
+    base = NULL;
+    size_t sz = bytes();
+    base = (char*)calloc(1, sz);
+    if(!base)
+      tw_error(TW_LOC, "Could not allocate the state of %d ports\n", ports());
+  }
+
+  void destroy() {
+    free(base);
+    base = NULL;
+  }
+};
+
+/* a VC of the port picked at random among those with chunks pending, -1 if
+ * there is none; draws a random number only when it picks one */
+template <class Block>
+int re_random_vc(const Block & pb, int port, tw_lp * lp)
+{
+  int num_ready = 0;
+  for(int i = 0; i < pb.vcs(); i++)
+    if(pb.pending(port)[i] != NULL)
+      num_ready++;
+  if(num_ready == 0)
+    return -1;
+
+  int pick = tw_rand_integer(lp->rng, 0, num_ready - 1);
+  int use_vc = 0;
+  for(; use_vc < pb.vcs(); use_vc++) {
+    if(pb.pending(port)[use_vc] != NULL && pick-- == 0)
+      break;
+  }
+  return use_vc;
+}
+
+/**
+ * @brief Chunk list operations of a policy whose chunks are the message_list
+ * of common-net.h.
+ */
+struct re_message_list_ops
+{
+  typedef message_list chunk_type;
+
+  static void append(message_list ** q, message_list ** tail, int vc,
+      message_list * c)
+  {
+    append_to_message_list(q, tail, vc, c);
+  }
+  static void prepend(message_list ** q, message_list ** tail, int vc,
+      message_list * c)
+  {
+    prepend_to_message_list(q, tail, vc, c);
+  }
+  static message_list* pop_head(message_list ** q, message_list ** tail, int vc)
+  {
+    return return_head(q, tail, vc);
+  }
+  static message_list* pop_tail(message_list ** q, message_list ** tail, int vc)
+  {
+    return return_tail(q, tail, vc);
+  }
+  static void free_chunk(void * c) { delete_message_list(c); }
+};
+
+/**
+ * @brief Defaults of the optional policy hooks, see RouterEngine. A policy
+ * derives from this and defines the hooks it needs; its own definitions hide
+ * these.
+ */
+struct RouterPolicyDefaults
+{
+  template <class S, class M>
+  static int receive_begin(S *, tw_bf *, M *, tw_lp *) { return 1; }
+  template <class S, class M>
+  static void receive_begin_rc(S *, tw_bf *, M *, tw_lp *) {}
+
+  template <class S, class C, class M>
+  static int admit(S *, C *, int, int, M *, tw_lp *) { return 1; }
+
+  template <class M>
+  static uint32_t chunks(const M *) { return 1; }
+
+  template <class S>
+  static int cut_through(S *, int) { return 0; }
+
+  template <class S, class M>
+  static void stall(S *, M *, M *, int) {}
+  template <class S>
+  static void stall_rc(S *, int) {}
+
+  static tw_stime local_delay(tw_lp * lp) { return codes_local_latency(lp); }
+
+  template <class S, class M>
+  static void send_idle(S *, tw_bf *, M *, tw_lp *, int) {}
+  template <class S, class M>
+  static void send_idle_rc(S *, tw_bf *, M *, tw_lp *, int) {}
+  template <class S, class M>
+  static void send_start(S *, tw_bf *, M *, tw_lp *, int) {}
+  template <class S, class M>
+  static void send_start_rc(S *, tw_bf *, M *, tw_lp *, int) {}
+  template <class S, class M>
+  static int more_to_send(S *, tw_bf *, M *, tw_lp *, int) { return 1; }
+
+  template <class S, class M>
+  static void busy(S *, M *, int, tw_stime) {}
+  template <class S, class M>
+  static void busy_rc(S *, M *, int) {}
+};
+
+/**
+ * @class RouterEngine
+ *
+ * @brief Router chunk pipeline (receive, send, credit update and their
+ * reverse handlers) over a PortBlock, parameterized by a routing policy.
+ *
+ * The Policy class provides, as static members:
+ *
+ *   typedef ... state_type;   router LP state
+ *   typedef ... msg_type;     network message; must have the fields of the
+ *                             net-template.C message (vc_index, output_chan,
+ *                             my_N_hop, saved_vc, saved_channel,
+ *                             saved_available_time, saved_busy_time, ...)
+ *                             and saved_train_len
+ *   typedef ... chunk_type;   list entry of a chunk, with next and prev
+ *   typedef PortBlock<..., chunk_type> port_block;
+ *
+ *   port_block& ports(state_type *s);
+ *   rc_stack* reverse_stack(state_type *s);
+ *   msg_type& chunk_msg(chunk_type *c);          the message of a chunk
+ *   chunk_type* new_chunk(msg_type *msg);        chunk holding a copy of msg
+ *                                                and its remote event data
+ *   append, prepend, pop_head, pop_tail, free_chunk
+ *                                                chunk list operations, see
+ *                                                re_message_list_ops
+ *   int chunk_size(state_type *s);
+ *   int buffer_size(state_type *s, int port);    VC capacity of the port
+ *
+ *   void next_stop(state_type *s, msg_type *chunk, tw_bf *bf, tw_lp *lp,
+ *       int *port, int *vc);                     may update the chunk
+ *   void next_stop_rc(state_type *s, msg_type *msg, tw_bf *bf);
+ *   void credit_send(state_type *s, msg_type *msg, tw_lp *lp, int queued);
+ *                                                queued: the chunk had waited
+ *                                                for buffer space
+ *   void credit_send_rc(state_type *s, tw_lp *lp);
+ *   void schedule_send(state_type *s, tw_stime ts, int port, tw_lp *lp);
+ *   int pick_vc(state_type *s, tw_bf *bf, msg_type *msg, tw_lp *lp);
+ *   void pick_vc_rc(state_type *s, tw_bf *bf, msg_type *msg, tw_lp *lp);
+ *                                                VC of port msg->vc_index a
+ *                                                send takes a chunk from, -1
+ *                                                if none can go
+ *   int send_chunk(state_type *s, tw_bf *bf, msg_type *msg, tw_lp *lp,
+ *       int port, int vc, chunk_type *c);        send the chunk to its next
+ *                                                stop, moving the port's
+ *                                                next_output_available_time
+ *                                                past it; returns its bytes
+ *   int send_chunk_rc(state_type *s, tw_bf *bf, msg_type *msg, tw_lp *lp,
+ *       int port, chunk_type *c);                returns the same bytes
+ *   tw_stime pipeline_delay(state_type *s, int port);
+ *                                                part of the arrival time that
+ *                                                does not keep the port busy
+ *   tw_stime next_send_delay(state_type *s, tw_stime ts, tw_lp *lp);
+ *   void next_send_delay_rc(state_type *s, tw_lp *lp);
+ *                                                delay of the next send event,
+ *                                                ts being the port's time
+ *                                                to free
+ *
+ * and may redefine the hooks of RouterPolicyDefaults:
+ *
+ *   receive_begin     0 when the arrival is handled otherwise
+ *   admit             0 when the routed chunk is not taken as it is (it is
+ *                     freed, the policy having dealt with the arrival)
+ *   chunks            chunks carried by a message, and credits by a credit
+ *   cut_through       chunks may leave an idle port without a send event
+ *   stall             a chunk is queued for lack of buffer space
+ *   local_delay       delay of a send event a receive or credit starts; it
+ *                     is undone with codes_local_latency_reverse
+ *   send_idle         a send event found nothing to send
+ *   send_start        a send event is about to send a chunk
+ *   more_to_send      0 ends the send loop after a chunk
+ *   busy              dt of busy time has been added to the port
+ *
+ * each with a _rc function where it changes state. The engine keeps the bf
+ * bits c1 to c6 for itself; the policy may use the others in its hooks.
+ */
+template <class Policy>
+struct RouterEngine
+{
+  typedef typename Policy::state_type state_type;
+  typedef typename Policy::msg_type msg_type;
+  typedef typename Policy::chunk_type chunk_type;
+  typedef typename Policy::port_block port_block;
+
+  /* Packet arrives at the router and a credit is sent back to the sending
+   * terminal/router */
+  static void packet_receive(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    if(!Policy::receive_begin(s, bf, msg, lp))
+      return;
+
+    port_block &pb = Policy::ports(s);
+    int chunk_size = Policy::chunk_size(s);
+    int next_port, next_vc;
+
+    chunk_type * cur_chunk = Policy::new_chunk(msg);
+    Policy::next_stop(s, &Policy::chunk_msg(cur_chunk), bf, lp, &next_port,
+        &next_vc);
+    Policy::chunk_msg(cur_chunk).my_N_hop++;
+    bf->c1 = 1;
+
+    if(!Policy::admit(s, cur_chunk, next_port, next_vc, msg, lp)) {
+      Policy::free_chunk(cur_chunk);
+      return;
+    }
+
+    if(pb.vc_occupancy(next_port)[next_vc] + chunk_size
+        <= Policy::buffer_size(s, next_port)) {
+      bf->c2 = 1;
+      Policy::credit_send(s, msg, lp, 0);
+      pb.vc_occupancy(next_port)[next_vc] += chunk_size * Policy::chunks(msg);
+      if(Policy::cut_through(s, next_port) && port_idle(s, next_port, lp)) {
+        /* nothing to arbitrate: the chunk leaves now, without a send event */
+        bf->c6 = 1;
+        transmit(s, bf, msg, lp, next_port, next_vc, cur_chunk);
+        rc_stack_push(lp, cur_chunk, Policy::free_chunk, Policy::reverse_stack(s));
+      } else {
+        Policy::append(pb.pending(next_port), pb.pending_tail(next_port),
+            next_vc, cur_chunk);
+        if(pb.in_send_loop()[next_port] == 0) {
+          bf->c3 = 1;
+          Policy::schedule_send(s, Policy::local_delay(lp), next_port, lp);
+          pb.in_send_loop()[next_port] = 1;
+        }
+      }
+    } else {
+      bf->c4 = 1;
+      Policy::stall(s, &Policy::chunk_msg(cur_chunk), msg, next_port);
+      Policy::append(pb.queued(next_port), pb.queued_tail(next_port),
+          next_vc, cur_chunk);
+      pb.queued_count()[next_port] += chunk_size;
+      /* the port is busy from the first chunk that finds it full until a
+       * credit frees it, see buf_update. If chunks are pending on the VC,
+       * a send will come and the first to arrive sets it. */
+      if(pb.pending(next_port)[next_vc] == NULL
+          && pb.last_buf_full()[next_port] == 0.0) {
+        bf->c5 = 1;
+        msg->saved_busy_time = pb.last_buf_full()[next_port];
+        pb.last_buf_full()[next_port] = tw_now(lp);
+      }
+    }
+
+    msg->saved_vc = next_port;
+    msg->saved_channel = next_vc;
+  }
+
+  static void packet_receive_rc(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    Policy::receive_begin_rc(s, bf, msg, lp);
+    if(!bf->c1)
+      return;
+
+    port_block &pb = Policy::ports(s);
+    int chunk_size = Policy::chunk_size(s);
+    int next_port = msg->saved_vc;
+    int next_vc = msg->saved_channel;
+
+    Policy::next_stop_rc(s, msg, bf);
+    if(bf->c2) {
+      if(bf->c6) {
+        chunk_type * cur_chunk = (chunk_type *)rc_stack_pop(Policy::reverse_stack(s));
+        transmit_rc(s, bf, msg, lp, next_port, cur_chunk);
+        Policy::free_chunk(cur_chunk);
+      } else {
+        Policy::free_chunk(Policy::pop_tail(pb.pending(next_port),
+              pb.pending_tail(next_port), next_vc));
+        if(bf->c3) {
+          codes_local_latency_reverse(lp);
+          pb.in_send_loop()[next_port] = 0;
+        }
+      }
+      Policy::credit_send_rc(s, lp);
+      pb.vc_occupancy(next_port)[next_vc] -= chunk_size * Policy::chunks(msg);
+    }
+    if(bf->c4) {
+      Policy::stall_rc(s, next_port);
+      Policy::free_chunk(Policy::pop_tail(pb.queued(next_port),
+            pb.queued_tail(next_port), next_vc));
+      pb.queued_count()[next_port] -= chunk_size;
+      if(bf->c5)
+        pb.last_buf_full()[next_port] = msg->saved_busy_time;
+    }
+  }
+
+  /* sends a chunk out of the port in msg->vc_index, from the VC the policy
+   * picks */
+  static void packet_send(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    port_block &pb = Policy::ports(s);
+    int output_port = msg->vc_index;
+    int use_vc = Policy::pick_vc(s, bf, msg, lp);
+    msg->output_chan = use_vc;
+
+    if(use_vc < 0) {
+      bf->c1 = 1;
+      pb.in_send_loop()[output_port] = 0;
+      Policy::send_idle(s, bf, msg, lp, output_port);
+      return;
+    }
+
+    chunk_type *cur_entry = pb.pending(output_port)[use_vc];
+    assert(cur_entry);
+
+    Policy::send_start(s, bf, msg, lp, output_port);
+    transmit(s, bf, msg, lp, output_port, use_vc, cur_entry);
+
+    cur_entry = Policy::pop_head(pb.pending(output_port),
+        pb.pending_tail(output_port), use_vc);
+    rc_stack_push(lp, cur_entry, Policy::free_chunk, Policy::reverse_stack(s));
+
+    if(!Policy::more_to_send(s, bf, msg, lp, output_port)) {
+      bf->c4 = 1;
+      pb.in_send_loop()[output_port] = 0;
+      return;
+    }
+    tw_stime ts = pb.next_output_available_time()[output_port] - tw_now(lp);
+    Policy::schedule_send(s, Policy::next_send_delay(s, ts, lp), output_port, lp);
+  }
+
+  static void packet_send_rc(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    port_block &pb = Policy::ports(s);
+    int output_port = msg->vc_index;
+    int use_vc = msg->output_chan;
+
+    if(bf->c1) {
+      Policy::send_idle_rc(s, bf, msg, lp, output_port);
+      pb.in_send_loop()[output_port] = 1;
+      Policy::pick_vc_rc(s, bf, msg, lp);
+      return;
+    }
+
+    if(bf->c4)
+      pb.in_send_loop()[output_port] = 1;
+    else
+      Policy::next_send_delay_rc(s, lp);
+
+    chunk_type * cur_entry = (chunk_type *)rc_stack_pop(Policy::reverse_stack(s));
+    assert(cur_entry);
+    transmit_rc(s, bf, msg, lp, output_port, cur_entry);
+    Policy::prepend(pb.pending(output_port), pb.pending_tail(output_port),
+        use_vc, cur_entry);
+
+    Policy::send_start_rc(s, bf, msg, lp, output_port);
+    Policy::pick_vc_rc(s, bf, msg, lp);
+  }
+
+  /* a credit came back for (msg->vc_index, msg->output_chan): free the
+   * buffer space and admit as many queued chunks as it frees room for */
+  static void buf_update(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    port_block &pb = Policy::ports(s);
+    int chunk_size = Policy::chunk_size(s);
+    int indx = msg->vc_index;
+    int output_chan = msg->output_chan;
+    uint32_t credits = Policy::chunks(msg);
+    pb.vc_occupancy(indx)[output_chan] -= chunk_size * credits;
+
+    if(pb.last_buf_full()[indx] > 0.0) {
+      bf->c3 = 1;
+      tw_stime busy = tw_now(lp) - pb.last_buf_full()[indx];
+      msg->saved_rcv_time = pb.busy_time()[indx];
+      msg->saved_busy_time = pb.last_buf_full()[indx];
+      msg->saved_sample_time = pb.busy_time_sample()[indx];
+      pb.busy_time()[indx] += busy;
+      pb.busy_time_sample()[indx] += busy;
+      Policy::busy(s, msg, indx, busy);
+      pb.last_buf_full()[indx] = 0.0;
+    }
+
+    msg->saved_train_len = 0;
+    while(msg->saved_train_len < credits && pb.queued(indx)[output_chan] != NULL) {
+      bf->c1 = 1;
+      chunk_type *head = Policy::pop_head(pb.queued(indx), pb.queued_tail(indx),
+          output_chan);
+      Policy::credit_send(s, &Policy::chunk_msg(head), lp, 1);
+      Policy::append(pb.pending(indx), pb.pending_tail(indx), output_chan, head);
+      pb.vc_occupancy(indx)[output_chan] += chunk_size;
+      pb.queued_count()[indx] -= chunk_size;
+      msg->saved_train_len++;
+    }
+
+    if(pb.in_send_loop()[indx] == 0 && pb.pending(indx)[output_chan] != NULL) {
+      bf->c2 = 1;
+      Policy::schedule_send(s, Policy::local_delay(lp), indx, lp);
+      pb.in_send_loop()[indx] = 1;
+    }
+  }
+
+  static void buf_update_rc(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp)
+  {
+    port_block &pb = Policy::ports(s);
+    int chunk_size = Policy::chunk_size(s);
+    int indx = msg->vc_index;
+    int output_chan = msg->output_chan;
+    pb.vc_occupancy(indx)[output_chan] += chunk_size * Policy::chunks(msg);
+
+    if(bf->c2) {
+      codes_local_latency_reverse(lp);
+      pb.in_send_loop()[indx] = 0;
+    }
+    for(uint32_t i = 0; i < msg->saved_train_len; i++) {
+      chunk_type* head = Policy::pop_tail(pb.pending(indx), pb.pending_tail(indx),
+          output_chan);
+      Policy::credit_send_rc(s, lp);
+      Policy::prepend(pb.queued(indx), pb.queued_tail(indx), output_chan, head);
+      pb.vc_occupancy(indx)[output_chan] -= chunk_size;
+      pb.queued_count()[indx] += chunk_size;
+    }
+    if(bf->c3) {
+      Policy::busy_rc(s, msg, indx);
+      pb.busy_time()[indx] = msg->saved_rcv_time;
+      pb.busy_time_sample()[indx] = msg->saved_sample_time;
+      pb.last_buf_full()[indx] = msg->saved_busy_time;
+    }
+  }
+
+private:
+  /* a chunk for the port can leave at once when the port is not sending,
+   * nothing waits on it, its link is free and no busy time is being counted */
+  static int port_idle(state_type * s, int port, tw_lp * lp)
+  {
+    port_block &pb = Policy::ports(s);
+    if(pb.in_send_loop()[port] || pb.last_buf_full()[port] > 0.0
+        || pb.next_output_available_time()[port] > tw_now(lp))
+      return 0;
+    for(int i = 0; i < pb.vcs(); i++)
+      if(pb.pending(port)[i] != NULL)
+        return 0;
+    return 1;
+  }
+
+  /* puts a chunk on the wire of the port */
+  static void transmit(state_type * s, tw_bf * bf, msg_type * msg, tw_lp * lp,
+      int port, int vc, chunk_type * c)
+  {
+    port_block &pb = Policy::ports(s);
+    msg->saved_available_time = pb.next_output_available_time()[port];
+    int bytes = Policy::send_chunk(s, bf, msg, lp, port, vc, c);
+    pb.link_traffic()[port] += bytes;
+    pb.link_traffic_sample()[port] += bytes;
+
+    /* the router delay and the link latency delay the arrival but do not
+     * keep the port busy */
+    pb.next_output_available_time()[port] -= Policy::pipeline_delay(s, port);
+  }
+
+  static void transmit_rc(state_type * s, tw_bf * bf, msg_type * msg,
+      tw_lp * lp, int port, chunk_type * c)
+  {
+    port_block &pb = Policy::ports(s);
+    int bytes = Policy::send_chunk_rc(s, bf, msg, lp, port, c);
+    pb.link_traffic()[port] -= bytes;
+    pb.link_traffic_sample()[port] -= bytes;
+    pb.next_output_available_time()[port] = msg->saved_available_time;
+  }
+};
+
+#endif /* end of include guard: ROUTER_ENGINE_H */
@@ -11,6 +11,9 @@
 extern "C" {
 #endif
 
+/* largest number of torus dimensions (PARAMS:n_dims) */
+#define TORUS_MAX_DIMS 8
+
 typedef struct nodes_message nodes_message;
 
 /* event type of each torus message, can be packet generate, flit arrival, flit send or credit */
@@ -22,7 +25,8 @@ typedef enum nodes_event_t
   CREDIT,
   T_COLLECTIVE_INIT,
   T_COLLECTIVE_FAN_IN,
-  T_COLLECTIVE_FAN_OUT  
+  T_COLLECTIVE_FAN_OUT,
+  FAULT
 } nodes_event_t;
 
 struct nodes_message
@@ -50,8 +54,14 @@ struct nodes_message
   /* for reverse computation */
   int saved_channel;
 
-  /* coordinates of the destination torus nodes */
-  int* dest;
+  /* coordinates of the destination torus node, computed at injection */
+  int dest_coords[TORUS_MAX_DIMS];
+  /* coordinates of the intermediate torus node (valiant routing) */
+  int intm_coords[TORUS_MAX_DIMS];
+  /* valiant routing: 0 on the way to the intermediate node, 1 after it */
+  int valiant_phase;
+  /* virtual channel of the link the message travels on */
+  int vc;
 
   /* final destination LP ID, comes from codes, can be a server or any other I/O LP type */
   tw_lpid final_dest_gid;
@@ -63,6 +73,8 @@ struct nodes_message
 
   /* LP ID of the sending node, has to be a network node in the torus */
   tw_lpid sender_node;
+  /* flat id of the torus node that injected the packet */
+  int src_node;
 
   /* number of hops traversed by the packet */
   int my_N_hop;
@@ -74,6 +86,10 @@ struct nodes_message
   int next_stop;
   /* size of the torus packet */
   uint64_t packet_size;
+  /* message the packet belongs to (model-net message id at the sending node)
+   * and its size */
+  uint64_t message_id;
+  uint64_t total_size;
 
  /* for reverse computation of a node's fan in*/
   int saved_fan_nodes;
@@ -81,6 +97,7 @@ struct nodes_message
   int source_channel;
 
   int saved_queue;
+  int saved_vc;
   /* chunk id of the flit (distinguishes flits) */
   uint64_t chunk_id;
 
@@ -88,6 +105,11 @@ struct nodes_message
   int is_pull;
   uint64_t pull_size;
 
+  /* FAULT: entry of the failure schedule, and the entries in force
+   * before it (reverse computation) */
+  int fault_id;
+  int saved_faults_applied;
+
   /* for codes local and remote events, only carried by the last packet of the message */
   int local_event_size_bytes;
   int remote_event_size_bytes;
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#ifndef PARAM_TABLE_H
+#define PARAM_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* A precomputed, size-keyed parameter table for models that pick their
+ * parameters out of measured per-size data (loggp netgauge output, LSM disk
+ * profiles, ...).
+ *
+ * Each row holds a uint64_t key (typically a message or request size) and
+ * ncols double values. Keys are bucketed by log2 at creation time so that a
+ * lookup only binary searches the (usually tiny) run of rows sharing the
+ * key's power of two, and the search itself is branch-free. Tables of a few
+ * hundred rows therefore cost about the same per lookup as tables of ten.
+ *
+ * How a key maps onto the table is fixed at creation time:
+ * - CODES_PTABLE_FLOOR:  step lookup on the last row with row key <= key
+ *                        (first row if key precedes the table)
+ * - CODES_PTABLE_ABOVE:  step lookup on the first row with row key > key
+ *                        (last row if key is past the table)
+ * - CODES_PTABLE_LINEAR: piecewise-linear interpolation between the two rows
+ *                        bracketing key, clamped to the first/last row
+ */
+
+enum codes_ptable_mode {
+    CODES_PTABLE_FLOOR,
+    CODES_PTABLE_ABOVE,
+    CODES_PTABLE_LINEAR
+};
+
+struct codes_ptable;
+
+/* create a table of nrows rows from keys (sorted, non-decreasing) and vals
+ * (row-major, nrows*ncols entries). Both arrays are copied, so the caller
+ * keeps ownership. tw_error on empty or unsorted input */
+void codes_ptable_create(
+        int nrows,
+        int ncols,
+        uint64_t const *keys,
+        double const *vals,
+        enum codes_ptable_mode mode,
+        struct codes_ptable **t);
+void codes_ptable_destroy(struct codes_ptable *t);
+
+/* parse a mode string as found in config files ("step" or "linear"). An
+ * empty/NULL string or "step" returns step_mode, letting each model keep its
+ * historical step semantics. tw_error on anything else */
+enum codes_ptable_mode codes_ptable_mode_from_str(
+        char const *str,
+        enum codes_ptable_mode step_mode);
+
+int codes_ptable_rows(struct codes_ptable const *t);
+int codes_ptable_cols(struct codes_ptable const *t);
+
+/* raw row access */
+uint64_t codes_ptable_key(struct codes_ptable const *t, int row);
+double const * codes_ptable_row(struct codes_ptable const *t, int row);
+
+/* row indices according to the FLOOR/ABOVE rules above, regardless of the
+ * table's mode */
+int codes_ptable_floor(struct codes_ptable const *t, uint64_t key);
+int codes_ptable_above(struct codes_ptable const *t, uint64_t key);
+
+/* fill out[0..ncols-1] with the parameters for key according to the table's
+ * mode */
+void codes_ptable_lookup(
+        struct codes_ptable const *t,
+        uint64_t key,
+        double *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: PARAM_TABLE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
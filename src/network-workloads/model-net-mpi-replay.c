@@ -16,6 +16,7 @@
 #include "codes/quicklist.h"
 #include "codes/quickhash.h"
 #include "codes/codes-jobmap.h"
+#include "codes/codes-collectives.h"
 
 /* turning on track lp will generate a lot of output messages */
 #define MN_LP_NM "modelnet_dragonfly_custom"
@@ -23,18 +24,24 @@
 #define TRACE -1
 #define MAX_WAIT_REQS 1024
 #define CS_LP_DBG 1
-#define RANK_HASH_TABLE_SZ 2000
 #define NW_LP_NM "nw-lp"
 #define lprintf(_fmt, ...) \
         do {if (CS_LP_DBG) printf(_fmt, __VA_ARGS__);} while (0)
-#define MAX_STATS 65536
+/* sampling windows are allocated and grown in chunks of this many samples;
+ * committed samples are flushed to the aggregate log and dropped */
+#define SAMPLE_CHUNK 256
+/* one message size bucket per bit length of a 64-bit size */
+#define MSG_SZ_BUCKETS 65
 #define COL_TAG 1235
+/* point-to-point messages of expanded collectives use CODES_COL_TAG tags
+ * and request ids with the top bit set, both derived from the per-rank
+ * collective sequence number and the schedule round */
+#define COL_ENGINE_REQ(seq, round, is_send) \
+    (0x80000000u | (((unsigned)(seq) & 0x3ff) << 21) | ((round) << 1) | (is_send))
+#define IS_COL_TAG(tag) ((tag) == COL_TAG || CODES_COL_IS_TAG(tag))
 #define BAR_TAG 1234
 #define PRINT_SYNTH_TRAFFIC 1
 
-static int msg_size_hash_compare(
-            void *key, struct qhash_head *link);
-
 static unsigned long perm_switch_thresh = 8388608;
 
 /* NOTE: Message tracking works in sequential mode only! */
@@ -114,7 +121,6 @@ FILE * msg_size_log = NULL;
 FILE * workload_agg_log = NULL;
 FILE * workload_meta_log = NULL;
 
-static uint64_t sample_bytes_written = 0;
 
 unsigned long long num_bytes_sent=0;
 unsigned long long num_bytes_recvd=0;
@@ -132,6 +138,10 @@ static int enable_sampling = 0;
 static double sampling_interval = 5000000;
 static double sampling_end_time = 3000000000;
 static int enable_debug = 0;
+/* expand collectives into point-to-point schedules instead of only counting
+ * them */
+static int enable_col_engine = 0;
+static char col_allreduce_algo[32] = "auto";
 
 /* set group context */
 struct codes_mctx mapping_context;
@@ -215,14 +225,11 @@ struct pending_waits
     struct qlist_head ql;
 };
 
+/* message latency per power-of-two message size bucket */
 struct msg_size_info
 {
-    int64_t msg_size;
     int num_msgs;
     tw_stime agg_latency;
-    tw_stime avg_latency;
-    struct qhash_head  hash_link;
-    struct qlist_head ql; 
 };
 
 struct ross_model_sample
@@ -243,6 +250,17 @@ struct ross_model_sample
     double avg_msg_time;
 };
 
+/* collective being replayed as point-to-point operations. Its schedule
+ * position pos runs over rounds*3 slots (irecv, isend, waitall of each
+ * round); pos == end when no collective is in progress */
+struct nw_col_state
+{
+    struct codes_col_desc desc;
+    int seq;
+    int pos;
+    int end;
+};
+
 typedef struct mpi_msgs_queue mpi_msgs_queue;
 typedef struct completed_requests completed_requests;
 typedef struct pending_waits pending_waits;
@@ -263,6 +281,8 @@ struct nw_state
     struct rc_stack * processed_ops;
     struct rc_stack * processed_wait_op;
     struct rc_stack * matched_reqs;
+    /* previous collective states, restored on rc of a collective */
+    struct rc_stack * processed_cols;
 //    struct rc_stack * indices;
 
     /* count of sends, receives, collectives and delays */
@@ -279,6 +299,7 @@ struct nw_state
 	double start_time;
 
     double col_time;
+    struct nw_col_state col;
 
     double reduce_time;
     int num_reduce;
@@ -309,9 +330,9 @@ struct nw_state
     /* Pending wait operation */
     struct pending_waits * wait_op;
 
-    /* Message size latency information */
-    struct qhash_table * msg_sz_table;
-    struct qlist_head msg_sz_list;
+    /* Message size latency histogram (MSG_SZ_BUCKETS entries, allocated
+     * on the first tracked message) */
+    struct msg_size_info * msg_sz_hist;
 
     /* quick hash for maintaining message latencies */
 
@@ -325,12 +346,12 @@ struct nw_state
     int saved_perm_dest;
     unsigned long rc_perm;
 
-    /* For sampling data */
+    /* For sampling data. mpi_wkld_samples holds the samples from index
+     * sample_base on; earlier ones have been committed and flushed */
     int sampling_indx;
+    int sample_base;
     int max_arr_size;
     struct mpi_workload_sample * mpi_wkld_samples;
-    char output_buf[512];
-    char col_stats[64];
     struct ross_model_sample ross_sample;
 };
 
@@ -379,6 +400,8 @@ struct nw_message
        int saved_syn_length;
        unsigned long saved_prev_switch;
        double saved_prev_max_time;
+       int saved_sampling_indx;
+       int saved_col_pos;
    } rc;
 };
 
@@ -460,38 +483,59 @@ static void update_message_size(
             (void)bf;
             (void)is_eager;
 
-            struct qhash_head * hash_link = NULL;
             tw_stime msg_init_time = qitem->req_init_time;
-        
-            if(ns->msg_sz_table == NULL)
-                ns->msg_sz_table = qhash_init(msg_size_hash_compare, quickhash_64bit_hash, RANK_HASH_TABLE_SZ); 
-            
-            hash_link = qhash_search(ns->msg_sz_table, &(qitem->num_bytes));
+            uint64_t num_bytes = qitem->num_bytes;
+            int bucket = num_bytes ? 64 - __builtin_clzll(num_bytes) : 0;
+
+            if(ns->msg_sz_hist == NULL)
+                ns->msg_sz_hist = (struct msg_size_info*)calloc(MSG_SZ_BUCKETS, sizeof(struct msg_size_info));
 
             if(is_send)
                 msg_init_time = m->fwd.sim_start_time;
-            
-            /* update hash table */
-            if(!hash_link)
-            {
-                struct msg_size_info * msg_info = (struct msg_size_info*)malloc(sizeof(struct msg_size_info));
-                msg_info->msg_size = qitem->num_bytes;
-                msg_info->num_msgs = 1;
-                msg_info->agg_latency = tw_now(lp) - msg_init_time;
-                msg_info->avg_latency = msg_info->agg_latency;
-                assert(ns->msg_sz_table);
-                qhash_add(ns->msg_sz_table, &(msg_info->msg_size), &(msg_info->hash_link));
-                qlist_add(&msg_info->ql, &ns->msg_sz_list);
-                //printf("\n Msg size %d aggregate latency %f num messages %d ", m->fwd.num_bytes, msg_info->agg_latency, msg_info->num_msgs);
-            }
-            else
-            {
-                struct msg_size_info * tmp = qhash_entry(hash_link, struct msg_size_info, hash_link);
-                tmp->num_msgs++;
-                tmp->agg_latency += tw_now(lp) - msg_init_time;  
-                tmp->avg_latency = (tmp->agg_latency / tmp->num_msgs);
-//                printf("\n Msg size %lld aggregate latency %f num messages %d ", qitem->num_bytes, tmp->agg_latency, tmp->num_msgs);
-            }
+
+            ns->msg_sz_hist[bucket].num_msgs++;
+            ns->msg_sz_hist[bucket].agg_latency += tw_now(lp) - msg_init_time;
+}
+
+/* the sample at absolute index indx, which must not have been flushed */
+static struct mpi_workload_sample * get_sample(nw_state * s, int indx)
+{
+    assert(indx >= s->sample_base);
+    return &s->mpi_wkld_samples[indx - s->sample_base];
+}
+
+/* the sample currently being filled, growing the window by a chunk if the
+ * unflushed samples have outgrown it */
+static struct mpi_workload_sample * cur_sample(nw_state * s)
+{
+    int slot = s->sampling_indx - s->sample_base;
+    if(slot >= s->max_arr_size)
+    {
+        int new_size = s->max_arr_size + SAMPLE_CHUNK;
+        s->mpi_wkld_samples = (struct mpi_workload_sample*)realloc(s->mpi_wkld_samples,
+                new_size * sizeof(struct mpi_workload_sample));
+        assert(s->mpi_wkld_samples);
+        memset(s->mpi_wkld_samples + s->max_arr_size, 0,
+                SAMPLE_CHUNK * sizeof(struct mpi_workload_sample));
+        s->max_arr_size = new_size;
+    }
+    return &s->mpi_wkld_samples[slot];
+}
+
+/* write out the samples before absolute index upto and drop them from the
+ * window */
+static void flush_samples(nw_state * s, int upto)
+{
+    int n = upto - s->sample_base;
+    if(n <= 0)
+        return;
+    assert(n <= s->max_arr_size);
+    fwrite(s->mpi_wkld_samples, sizeof(struct mpi_workload_sample), n, workload_agg_log);
+    memmove(s->mpi_wkld_samples, s->mpi_wkld_samples + n,
+            (s->max_arr_size - n) * sizeof(struct mpi_workload_sample));
+    memset(s->mpi_wkld_samples + s->max_arr_size - n, 0,
+            n * sizeof(struct mpi_workload_sample));
+    s->sample_base = upto;
 }
 static void notify_background_traffic_rc(
 	    struct nw_state * ns,
@@ -1168,8 +1212,7 @@ static void codes_exec_mpi_wait_all_rc(
 {
   if(bf->c1)
   {
-    int sampling_indx = s->sampling_indx;
-    s->mpi_wkld_samples[sampling_indx].num_waits_sample--;
+    get_sample(s, s->sampling_indx)->num_waits_sample--;
 
     if(bf->c2)
     {
@@ -1207,23 +1250,15 @@ static void codes_exec_mpi_wait_all(
     if(tw_now(lp) >= s->cur_interval_end)
     {
         bf->c2 = 1;
-        int indx = s->sampling_indx;
-        s->mpi_wkld_samples[indx].nw_id = s->nw_id;
-        s->mpi_wkld_samples[indx].app_id = s->app_id;
-        s->mpi_wkld_samples[indx].sample_end_time = s->cur_interval_end;
+        struct mpi_workload_sample * sample = cur_sample(s);
+        sample->nw_id = s->nw_id;
+        sample->app_id = s->app_id;
+        sample->sample_end_time = s->cur_interval_end;
         s->cur_interval_end += sampling_interval;
         s->sampling_indx++;
     }
-    if(s->sampling_indx >= MAX_STATS)
-    {
-        struct mpi_workload_sample * tmp = (struct mpi_workload_sample*)calloc((MAX_STATS + s->max_arr_size), sizeof(struct mpi_workload_sample));
-        memcpy(tmp, s->mpi_wkld_samples, s->sampling_indx);
-        free(s->mpi_wkld_samples);
-        s->mpi_wkld_samples = tmp;
-        s->max_arr_size += MAX_STATS;
-    }
-    int indx = s->sampling_indx;
-    s->mpi_wkld_samples[indx].num_waits_sample++;
+    cur_sample(s)->num_waits_sample++;
+    m->rc.saved_sampling_indx = s->sampling_indx;
   }
   int count = mpi_op->u.waits.count;
   /* If the count is not less than max wait reqs then stop */
@@ -1298,10 +1333,11 @@ static int rm_matching_rcv(nw_state * ns,
 
     qlist_for_each(ent, &ns->pending_recvs_queue){
         qi = qlist_entry(ent, mpi_msgs_queue, ql);
+        /* wildcard receives leave the messages of collectives alone */
         if(//(qi->num_bytes == qitem->num_bytes)
                 //&& 
-               ((qi->tag == qitem->tag) || qi->tag == -1)
-                && ((qi->source_rank == qitem->source_rank) || qi->source_rank == -1))
+               codes_col_recv_matches(qi->tag, qi->source_rank, qitem->tag,
+                   qitem->source_rank, IS_COL_TAG(qitem->tag)))
         {
             matched = 1;
             qi->num_bytes = qitem->num_bytes;
@@ -1369,8 +1405,8 @@ static int rm_matching_send(nw_state * ns,
         qi = qlist_entry(ent, mpi_msgs_queue, ql);
         if(//(qi->num_bytes == qitem->num_bytes) // it is not a requirement in MPI that the send and receive sizes match
                 // && 
-		(qi->tag == qitem->tag || qitem->tag == -1)
-                && ((qi->source_rank == qitem->source_rank) || qitem->source_rank == -1))
+		codes_col_recv_matches(qitem->tag, qitem->source_rank, qi->tag,
+                    qi->source_rank, IS_COL_TAG(qi->tag)))
         {
             qitem->num_bytes = qi->num_bytes;
             matched = 1;
@@ -1599,10 +1635,10 @@ static void codes_exec_mpi_send_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_
 {
         if(enable_sampling)
         {
-           int indx = s->sampling_indx;
+           struct mpi_workload_sample * sample = get_sample(s, s->sampling_indx);
 
-           s->mpi_wkld_samples[indx].num_sends_sample--;
-           s->mpi_wkld_samples[indx].num_bytes_sample -= m->rc.saved_num_bytes;
+           sample->num_sends_sample--;
+           sample->num_bytes_sample -= m->rc.saved_num_bytes;
 
            if(bf->c1)
            {
@@ -1655,7 +1691,7 @@ static void codes_exec_mpi_send(nw_state* s,
     }
     else if(priority_type == 1)
     {
-        if(mpi_op->u.send.tag == COL_TAG || mpi_op->u.send.tag == BAR_TAG)
+        if(IS_COL_TAG(mpi_op->u.send.tag) || mpi_op->u.send.tag == BAR_TAG)
         {
             strcpy(prio, "high");
         }
@@ -1685,24 +1721,17 @@ static void codes_exec_mpi_send(nw_state* s,
         if(tw_now(lp) >= s->cur_interval_end)
         {
             bf->c1 = 1;
-            int indx = s->sampling_indx;
-            s->mpi_wkld_samples[indx].nw_id = s->nw_id;
-            s->mpi_wkld_samples[indx].app_id = s->app_id;
-            s->mpi_wkld_samples[indx].sample_end_time = s->cur_interval_end;
+            struct mpi_workload_sample * sample = cur_sample(s);
+            sample->nw_id = s->nw_id;
+            sample->app_id = s->app_id;
+            sample->sample_end_time = s->cur_interval_end;
             s->sampling_indx++;
             s->cur_interval_end += sampling_interval;
         }
-        if(s->sampling_indx >= MAX_STATS)
-        {
-            struct mpi_workload_sample * tmp = (struct mpi_workload_sample*)calloc((MAX_STATS + s->max_arr_size), sizeof(struct mpi_workload_sample));
-            memcpy(tmp, s->mpi_wkld_samples, s->sampling_indx);
-            free(s->mpi_wkld_samples);
-            s->mpi_wkld_samples = tmp;
-            s->max_arr_size += MAX_STATS;
-        }
-        int indx = s->sampling_indx;
-        s->mpi_wkld_samples[indx].num_sends_sample++;
-        s->mpi_wkld_samples[indx].num_bytes_sample += mpi_op->u.send.num_bytes;
+        struct mpi_workload_sample * sample = cur_sample(s);
+        sample->num_sends_sample++;
+        sample->num_bytes_sample += mpi_op->u.send.num_bytes;
+        m->rc.saved_sampling_indx = s->sampling_indx;
     }
 	nw_message local_m;
 	nw_message remote_m;
@@ -1915,7 +1944,7 @@ static void send_ack_back(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp, m
     }
     else if(priority_type == 1)
     {
-        if(mpi_op->tag == COL_TAG || mpi_op->tag == BAR_TAG)
+        if(IS_COL_TAG(mpi_op->tag) || mpi_op->tag == BAR_TAG)
         {
             strcpy(prio, "high");
         }
@@ -2087,7 +2116,6 @@ void nw_test_init(nw_state* s, tw_lp* lp)
 
    memset(s, 0, sizeof(*s));
    s->nw_id = codes_mapping_get_lp_relative_id(lp->gid, 0, 0);
-   s->mpi_wkld_samples = (struct mpi_workload_sample*)calloc(MAX_STATS, sizeof(struct mpi_workload_sample));
    s->sampling_indx = 0;
    s->is_finished = 0;
    s->cur_interval_end = 0;
@@ -2185,13 +2213,13 @@ void nw_test_init(nw_state* s, tw_lp* lp)
    INIT_QLIST_HEAD(&s->arrival_queue);
    INIT_QLIST_HEAD(&s->pending_recvs_queue);
    INIT_QLIST_HEAD(&s->completed_reqs);
-   INIT_QLIST_HEAD(&s->msg_sz_list);
 
-   s->msg_sz_table = NULL;
+   s->msg_sz_hist = NULL;
    /* Initialize the RC stack */
    rc_stack_create(&s->processed_ops);
    rc_stack_create(&s->processed_wait_op);
    rc_stack_create(&s->matched_reqs);
+   rc_stack_create(&s->processed_cols);
 //   rc_stack_create(&s->indices);
     
    assert(s->processed_ops != NULL);
@@ -2239,7 +2267,8 @@ void nw_test_init(nw_state* s, tw_lp* lp)
    }
    if(enable_sampling && sampling_interval > 0)
    {
-       s->max_arr_size = MAX_STATS;
+       s->max_arr_size = SAMPLE_CHUNK;
+       s->mpi_wkld_samples = (struct mpi_workload_sample*)calloc(SAMPLE_CHUNK, sizeof(struct mpi_workload_sample));
        s->cur_interval_end = sampling_interval;
        if(!g_tw_mynode && !s->nw_id)
        {
@@ -2259,6 +2288,9 @@ void nw_test_event_handler(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 //    rc_stack_gc(lp, s->indices);
     rc_stack_gc(lp, s->processed_ops);
     rc_stack_gc(lp, s->processed_wait_op);
+    rc_stack_gc(lp, s->processed_cols);
+
+    m->rc.saved_sampling_indx = -1;
 
     switch(m->msg_type)
 	{
@@ -2379,9 +2411,131 @@ void nw_test_event_handler(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 	}
 }
 
+/* collective type replayed for a workload op type, -1 if it is only counted */
+static int col_type_of_op(int op_type)
+{
+    switch(op_type)
+    {
+        case CODES_WK_BCAST:
+            return CODES_COL_BCAST;
+        case CODES_WK_REDUCE:
+            return CODES_COL_REDUCE;
+        case CODES_WK_ALLREDUCE:
+            return CODES_COL_ALLREDUCE;
+        case CODES_WK_ALLGATHER:
+        case CODES_WK_ALLGATHERV:
+            return CODES_COL_ALLGATHER;
+        case CODES_WK_ALLTOALL:
+        case CODES_WK_ALLTOALLV:
+            return CODES_COL_ALLTOALL;
+        default:
+            return -1;
+    }
+}
+
+static void codes_exec_mpi_col_rc(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    (void)bf;
+    (void)m;
+    struct nw_col_state * saved = (struct nw_col_state*)rc_stack_pop(s->processed_cols);
+    s->col = *saved;
+    free(saved);
+    codes_issue_next_event_rc(lp);
+}
+
+/* start replaying a collective over all ranks of the job as point-to-point
+ * operations. The ops are handed out one per MPI_OP_GET_NEXT by
+ * col_next_op, ahead of the workload */
+static void codes_exec_mpi_col(nw_state * s, tw_bf * bf, nw_message * m, tw_lp * lp,
+        struct codes_workload_op * mpi_op)
+{
+    (void)bf;
+    (void)m;
+    struct nw_col_state * saved = (struct nw_col_state*)malloc(sizeof(*saved));
+    *saved = s->col;
+    rc_stack_push(lp, saved, free, s->processed_cols);
+
+    enum codes_col_type type = (enum codes_col_type)col_type_of_op(mpi_op->op_type);
+    enum codes_col_algo algo = CODES_COL_ALGO_AUTO;
+    if(type == CODES_COL_ALLREDUCE)
+        algo = codes_col_algo_from_str(col_allreduce_algo);
+    int root = (type == CODES_COL_BCAST || type == CODES_COL_REDUCE) ?
+        mpi_op->u.collective.root : 0;
+
+    codes_col_init(&s->col.desc, type, algo, num_traces_of_job[s->app_id],
+            s->local_rank, root, mpi_op->u.collective.num_bytes, NULL);
+    s->col.seq++;
+    s->col.pos = 0;
+    s->col.end = 3 * codes_col_num_rounds(&s->col.desc);
+
+    if(enable_debug)
+        fprintf(workload_log, "\n (%lf) APP %d RANK %d COLLECTIVE %d (%s) BYTES %d ROUNDS %d",
+                tw_now(lp), s->app_id, s->local_rank, mpi_op->op_type,
+                codes_col_algo_to_str(s->col.desc.algo),
+                mpi_op->u.collective.num_bytes, s->col.end / 3);
+
+    codes_issue_next_event(lp);
+}
+
+/* fill op with the next point-to-point operation of the collective in
+ * progress and advance past it; 0 when the schedule is exhausted. A round
+ * posts its irecv and isend (when it has them) and waits on both */
+static int col_next_op(nw_state * s, struct codes_workload_op * op,
+        uint32_t * wait_reqs)
+{
+    struct codes_col_step step;
+    int seq = s->col.seq;
+
+    while(s->col.pos < s->col.end)
+    {
+        int round = s->col.pos / 3;
+        int slot = s->col.pos % 3;
+        s->col.pos++;
+        codes_col_get_step(&s->col.desc, round, &step);
+
+        memset(op, 0, sizeof(*op));
+        if(slot == 0 && step.recv_peer >= 0)
+        {
+            op->op_type = CODES_WK_IRECV;
+            op->u.recv.source_rank = step.recv_peer;
+            op->u.recv.dest_rank = s->local_rank;
+            op->u.recv.num_bytes = step.recv_bytes;
+            op->u.recv.tag = CODES_COL_TAG(seq, round);
+            op->u.recv.req_id = COL_ENGINE_REQ(seq, round, 0);
+            return 1;
+        }
+        else if(slot == 1 && step.send_peer >= 0)
+        {
+            op->op_type = CODES_WK_ISEND;
+            op->u.send.source_rank = s->local_rank;
+            op->u.send.dest_rank = step.send_peer;
+            op->u.send.num_bytes = step.send_bytes;
+            op->u.send.tag = CODES_COL_TAG(seq, round);
+            op->u.send.req_id = COL_ENGINE_REQ(seq, round, 1);
+            return 1;
+        }
+        else if(slot == 2 && (step.recv_peer >= 0 || step.send_peer >= 0))
+        {
+            int count = 0;
+            if(step.recv_peer >= 0)
+                wait_reqs[count++] = COL_ENGINE_REQ(seq, round, 0);
+            if(step.send_peer >= 0)
+                wait_reqs[count++] = COL_ENGINE_REQ(seq, round, 1);
+            op->op_type = CODES_WK_WAITALL;
+            op->u.waits.count = count;
+            op->u.waits.req_ids = wait_reqs;
+            return 1;
+        }
+    }
+    return 0;
+}
+
 static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
 {
-    codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank, m->mpi_op);
+    /* ops of an expanded collective don't come from the workload */
+    if(m->mpi_op)
+        codes_workload_get_next_rc(wrkld_id, s->app_id, s->local_rank, m->mpi_op);
+    s->col.pos = m->rc.saved_col_pos;
 
 	if(m->op_type == CODES_WK_END)
     {
@@ -2431,6 +2585,12 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
 		break;
 		case CODES_WK_ALLREDUCE:
         {
+            if(enable_col_engine)
+            {
+                s->num_cols--;
+                codes_exec_mpi_col_rc(s, bf, m, lp);
+                break;
+            }
             if(bf->c27)
             {
                 s->num_all_reduce--;
@@ -2453,7 +2613,10 @@ static void get_next_mpi_operation_rc(nw_state* s, tw_bf * bf, nw_message * m, t
 		case CODES_WK_COL:
 		{
 			s->num_cols--;
-		    codes_issue_next_event_rc(lp);
+            if(enable_col_engine && col_type_of_op(m->op_type) >= 0)
+                codes_exec_mpi_col_rc(s, bf, m, lp);
+            else
+		        codes_issue_next_event_rc(lp);
         }
 		break;
 
@@ -2489,9 +2652,22 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
     //    struct codes_workload_op mpi_op;
     //    codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, &mpi_op);
 
-	    struct codes_workload_op * mpi_op = (struct codes_workload_op*)malloc(sizeof(struct codes_workload_op));
-        codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, mpi_op);
-        m->mpi_op = mpi_op; 
+        struct codes_workload_op col_op;
+        uint32_t col_wait_reqs[2];
+        struct codes_workload_op * mpi_op;
+
+        m->rc.saved_col_pos = s->col.pos;
+        if(col_next_op(s, &col_op, col_wait_reqs))
+        {
+            mpi_op = &col_op;
+            m->mpi_op = NULL;
+        }
+        else
+        {
+	        mpi_op = (struct codes_workload_op*)malloc(sizeof(struct codes_workload_op));
+            codes_workload_get_next(wrkld_id, s->app_id, s->local_rank, mpi_op);
+            m->mpi_op = mpi_op;
+        }
         m->op_type = mpi_op->op_type;
 
         if(mpi_op->op_type == CODES_WK_END)
@@ -2581,6 +2757,11 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
 			case CODES_WK_ALLREDUCE:
             {
 				s->num_cols++;
+                if(enable_col_engine)
+                {
+                    codes_exec_mpi_col(s, bf, m, lp, mpi_op);
+                    break;
+                }
                 if(s->col_time > 0)
                 {
                     bf->c27 = 1;
@@ -2607,7 +2788,10 @@ static void get_next_mpi_operation(nw_state* s, tw_bf * bf, nw_message * m, tw_l
 			case CODES_WK_COL:
 			{
 				s->num_cols++;
-			    codes_issue_next_event(lp);
+                if(enable_col_engine && col_type_of_op(mpi_op->op_type) >= 0)
+                    codes_exec_mpi_col(s, bf, m, lp, mpi_op);
+                else
+			        codes_issue_next_event(lp);
             }
 			break;
 			default:
@@ -2620,7 +2804,6 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
 {
     total_syn_data += s->syn_data;
 
-    int written = 0;
     double avg_msg_time = 0;
     /*if(s->wait_op)
     {
@@ -2649,25 +2832,26 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
             codes_workload_finalize("online_comm_workload", params, s->app_id, s->local_rank);
     }
 
-        struct msg_size_info * tmp_msg = NULL; 
-        struct qlist_head * ent = NULL;
-
         if(s->local_rank == 0 && enable_msg_tracking)
-            fprintf(msg_size_log, "\n rank_id message_size num_messages avg_latency");
-        
-        if(enable_msg_tracking)
+            fprintf(msg_size_log, "\n rank_id message_size_min message_size_max num_messages avg_latency");
+
+        if(enable_msg_tracking && s->msg_sz_hist)
         {
-            qlist_for_each(ent, &s->msg_sz_list)
+            for(int b = 0; b < MSG_SZ_BUCKETS; b++)
             {
-                tmp_msg = qlist_entry(ent, struct msg_size_info, ql);
-                printf("\n Rank %d Msg size %"PRId64" num_msgs %d agg_latency %f avg_latency %f",
-                        s->local_rank, tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->agg_latency, tmp_msg->avg_latency);
-                //fprintf(msg_size_log, "\n Rank %d Msg size %d num_msgs %d agg_latency %f avg_latency %f",
-                //        s->local_rank, tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->agg_latency, tmp_msg->avg_latency);
+                struct msg_size_info * tmp_msg = &s->msg_sz_hist[b];
+                if(tmp_msg->num_msgs == 0)
+                    continue;
+                /* bucket b holds sizes in [2^(b-1), 2^b - 1] */
+                uint64_t sz_min = b ? (uint64_t)1 << (b - 1) : 0;
+                uint64_t sz_max = b ? sz_min + (sz_min - 1) : 0;
+                double avg_latency = tmp_msg->agg_latency / tmp_msg->num_msgs;
+                printf("\n Rank %d Msg size %"PRIu64"-%"PRIu64" num_msgs %d agg_latency %f avg_latency %f",
+                        s->local_rank, sz_min, sz_max, tmp_msg->num_msgs, tmp_msg->agg_latency, avg_latency);
                 if(s->local_rank == 0)
                 {
-                    fprintf(msg_size_log, "\n %llu %"PRId64" %d %f",
-                        LLU(s->nw_id), tmp_msg->msg_size, tmp_msg->num_msgs, tmp_msg->avg_latency);
+                    fprintf(msg_size_log, "\n %llu %"PRIu64" %"PRIu64" %d %f",
+                        LLU(s->nw_id), sz_min, sz_max, tmp_msg->num_msgs, avg_latency);
                 }
             }
         }
@@ -2680,14 +2864,13 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
             printf("\n nw-id %llu unmatched irecvs %d unmatched sends %d Total sends %ld receives %ld collectives %ld delays %ld wait alls %ld waits %ld send time %lf wait %lf",
 			    LLU(s->nw_id) , count_irecv, count_isend, s->num_sends, s->num_recvs, s->num_cols, s->num_delays, s->num_waitall, s->num_wait, s->send_time, s->wait_time);
         }
-        written = 0;
     
         if(!s->nw_id)
-            written = sprintf(s->output_buf, "# Format <LP ID> <Terminal ID> <Job ID> <Local Rank> <Total sends> <Total Recvs> <Bytes sent> <Bytes recvd> <Send time> <Comm. time> <Compute time> <Avg msg time> <Max Msg Time>");
+            lp_io_fmt("# Format <LP ID> <Terminal ID> <Job ID> <Local Rank> <Total sends> <Total Recvs> <Bytes sent> <Bytes recvd> <Send time> <Comm. time> <Compute time> <Avg msg time> <Max Msg Time>");
 
-        written += sprintf(s->output_buf + written, "\n %llu %llu %d %d %ld %ld %llu %llu %lf %lf %lf %lf %lf", LLU(lp->gid), LLU(s->nw_id), s->app_id, s->local_rank, s->num_sends, s->num_recvs, s->num_bytes_sent,
+        lp_io_fmt("\n %llu %llu %d %d %ld %ld %llu %llu %lf %lf %lf %lf %lf", LLU(lp->gid), LLU(s->nw_id), s->app_id, s->local_rank, s->num_sends, s->num_recvs, s->num_bytes_sent,
                 s->num_bytes_recvd, s->send_time, s->elapsed_time - s->compute_time, s->compute_time, avg_msg_time, s->max_time);
-        lp_io_write(lp->gid, (char*)"mpi-replay-stats", written, s->output_buf);
+        lp_io_fmt_write(lp->gid, (char*)"mpi-replay-stats");
 
 		if(s->elapsed_time - s->compute_time > max_comm_time)
 			max_comm_time = s->elapsed_time - s->compute_time;
@@ -2702,10 +2885,9 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
         }
         if(enable_sampling)
         {
-            fseek(workload_agg_log, sample_bytes_written, SEEK_SET);
-            fwrite(s->mpi_wkld_samples, sizeof(struct mpi_workload_sample), s->sampling_indx + 1, workload_agg_log);
+            cur_sample(s);
+            flush_samples(s, s->sampling_indx + 1);
         }
-        sample_bytes_written += (s->sampling_indx * sizeof(struct mpi_workload_sample));
 		if(s->wait_time > max_wait_time)
 			max_wait_time = s->wait_time;
         
@@ -2715,12 +2897,11 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
 		if(s->recv_time > max_recv_time)
 			max_recv_time = s->recv_time;
 
-        written = 0;
 
         if(debug_cols)
-            written += sprintf(s->col_stats + written, "%llu \t %lf \n", LLU(s->nw_id), ns_to_s(s->all_reduce_time / s->num_all_reduce));
+            lp_io_fmt("%llu \t %lf \n", LLU(s->nw_id), ns_to_s(s->all_reduce_time / s->num_all_reduce));
 		
-        lp_io_write(lp->gid, (char*)"avg-all-reduce-time", written, s->col_stats);
+        lp_io_fmt_write(lp->gid, (char*)"avg-all-reduce-time");
 
         avg_time += s->elapsed_time;
 		avg_comm_time += (s->elapsed_time - s->compute_time);
@@ -2733,6 +2914,18 @@ void nw_test_finalize(nw_state* s, tw_lp* lp)
 //	    rc_stack_destroy(s->indices);
 	    rc_stack_destroy(s->processed_ops);
 	    rc_stack_destroy(s->processed_wait_op);
+	    rc_stack_destroy(s->processed_cols);
+}
+
+/* once an event is committed, the samples before the one it counted into
+ * can no longer change: write them out and drop them from the window */
+void nw_test_event_commit(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
+{
+    (void)bf;
+    (void)lp;
+
+    if(enable_sampling && m->rc.saved_sampling_indx > s->sample_base)
+        flush_samples(s, m->rc.saved_sampling_indx);
 }
 
 void nw_test_event_handler_rc(nw_state* s, tw_bf * bf, nw_message * m, tw_lp * lp)
@@ -2817,6 +3010,8 @@ const tw_optdef app_opt [] =
     TWOPT_UINT("syn_type", syn_type, "type of synthetic traffic"),
     TWOPT_UINT("preserve_wait_ordering", preserve_wait_ordering, "only enable when getting unmatched send/recv errors in optimistic mode (turning on slows down simulation)"),
     TWOPT_UINT("debug_cols", debug_cols, "completion time of collective operations (currently MPI_AllReduce)"),
+    TWOPT_UINT("enable_collectives", enable_col_engine, "replay collectives as point-to-point messages over MPI_COMM_WORLD (default 0: only count them)"),
+    TWOPT_CHAR("col_allreduce_algo", col_allreduce_algo, "allreduce algorithm with enable_collectives: auto, recursive-doubling, rabenseifner or ring (default auto)"),
     TWOPT_UINT("enable_mpi_debug", enable_debug, "enable debugging of MPI sim layer (works with sync=1 only)"),
     TWOPT_UINT("sampling_interval", sampling_interval, "sampling interval for MPI operations"),
     TWOPT_UINT("perm-thresh", perm_switch_thresh, "threshold for random permutation operations"),
@@ -2839,7 +3034,7 @@ tw_lptype nw_lp = {
     (pre_run_f) NULL,
     (event_f) nw_test_event_handler,
     (revent_f) nw_test_event_handler_rc,
-    (commit_f) NULL,
+    (commit_f) nw_test_event_commit,
     (final_f) nw_test_finalize,
     (map_f) codes_mapping,
     sizeof(nw_state)
@@ -2928,19 +3123,6 @@ void nw_lp_register_model()
 }
 /* end of ROSS event tracing setup */
 
-static int msg_size_hash_compare(
-            void *key, struct qhash_head *link)
-{
-   int64_t *in_size = (int64_t *)key;
-   struct msg_size_info *tmp;
-
-    tmp = qhash_entry(link, struct msg_size_info, hash_link);
-    if (tmp->msg_size == *in_size)
-      return 1;
-
-    return 0;
-}
-
 /* Method to organize all mpi_replay specific configuration parameters
 to be specified in the loaded .conf file*/
 void modelnet_mpi_replay_read_config()
@@ -3098,11 +3280,13 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
             MPI_Finalize();
             return -1;
         }
+   }
+   if(enable_sampling)
+   {
         char agg_log_name[512];
         sprintf(agg_log_name, "%s/mpi-aggregate-logs-%d.bin", sampling_dir, rank);
         workload_agg_log = fopen(agg_log_name, "w+");
         workload_meta_log = fopen("mpi-workload-meta-log", "w+");
-   
 
         if(!workload_agg_log || !workload_meta_log)
         {
@@ -3153,8 +3337,10 @@ int modelnet_mpi_replay(MPI_Comm comm, int* argc, char*** argv )
     if(enable_debug)
         fclose(workload_log);
 
-    if(enable_msg_tracking) {
+    if(enable_msg_tracking)
         fclose(msg_size_log);
+
+    if(enable_sampling) {
         fclose(workload_agg_log);
         fclose(workload_meta_log);
     }
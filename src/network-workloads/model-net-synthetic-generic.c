@@ -0,0 +1,941 @@
+/*
+ * Copyright (C) 2015 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/*
+ * Topology-agnostic synthetic traffic generator. Every "nw-lp" in the
+ * configuration is a traffic source and sink, whatever model-net method it is
+ * attached to. Destinations come from the patterns in pattern_table, the
+ * injection times from one of the arrival processes in arrival_table, and the
+ * offered load can be swept over several phases of a single run, reporting
+ * latency and accepted throughput against offered load for each phase.
+ *
+ * See README_synthetic.txt for the "synthetic" configuration group.
+ */
+
+#include <math.h>
+#include "codes/model-net.h"
+#include "codes/lp-io.h"
+#include "codes/codes.h"
+#include "codes/codes_mapping.h"
+#include "codes/configuration.h"
+#include "codes/lp-type-lookup.h"
+
+#define SYNTH_NAME "synthetic"
+#define SYNTH_MAX_PATTERNS 8
+
+static int net_id = 0;
+static uint64_t num_nodes = 0;
+
+static char lp_io_dir[256] = {'\0'};
+static lp_io_handle io_handle;
+static unsigned int lp_io_use_suffix = 0;
+static int do_lp_io = 0;
+static tw_stime sampling_interval = 800000;
+static tw_stime sampling_end_time = 1600000;
+
+/* configuration (see synth_configure) */
+static int payload_sz = 2048;
+static double injection_bw;     /* GiB/s */
+static tw_stime msg_time;       /* ns to inject one message at injection_bw */
+static int num_phases;
+static double *phase_loads;     /* offered load per phase, fraction of bw */
+static tw_stime phase_length;   /* ns */
+static tw_stime warmup;         /* ns at the start of each phase not measured */
+static int hotspot_nodes = 1;
+static double hotspot_frac = 0.1;
+static int shift = 1;
+static double burst_len = 8.0;
+static uint64_t *perm;          /* permutation pattern, one entry per node */
+static uint64_t transpose_side;
+
+typedef struct svr_msg svr_msg;
+typedef struct svr_state svr_state;
+
+/* type of events */
+enum svr_event
+{
+    KICKOFF,       /* next injection */
+    REMOTE,        /* message arrived at the destination */
+    LOCAL          /* message left the source */
+};
+
+/* measurements of one load phase */
+struct phase_stats
+{
+    long long sent;             /* messages injected */
+    long long recvd;            /* measured messages received */
+    long long accepted_bytes;   /* bytes received during the measured window */
+    tw_stime sum_latency;
+    tw_stime max_latency;
+};
+
+struct svr_state
+{
+    uint64_t svr_id;        /* node id, 0..num_nodes-1 */
+    uint64_t seq;           /* messages generated so far */
+    int burst_left;         /* on-off arrival: messages left in the burst */
+    int local_recvd_count;  /* number of local completions */
+    struct phase_stats *ph;
+};
+
+struct svr_msg
+{
+    enum svr_event svr_event_type;
+    tw_lpid src;          /* source of this message */
+    int phase;            /* phase the message (or injection) belongs to */
+    tw_stime msg_start_time;
+    int num_rngs;         /* helper for reverse computation */
+    int saved_burst;      /* helper for reverse computation */
+    tw_stime saved_time;  /* helper for reverse computation */
+    model_net_event_return event_rc;
+};
+
+/*
+ * traffic patterns
+ *   - dest returns the destination node of the seq'th message of node src,
+ *     or src itself if the node does not inject under the pattern. Every
+ *     random number drawn from lp->rng is counted in *num_rngs
+ *   - setup (optional) is called once, after the configuration is read
+ */
+typedef struct synth_pattern
+{
+    char const *name;
+    void (*setup)(void);
+    uint64_t (*dest)(uint64_t src, uint64_t seq, tw_lp *lp, int *num_rngs);
+} synth_pattern;
+
+static uint64_t uniform_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq;
+    if (num_nodes < 2)
+        return src;
+    (*num_rngs)++;
+    uint64_t d = tw_rand_integer(lp->rng, 0, num_nodes - 2);
+    return d >= src ? d + 1 : d;
+}
+
+/* single random cycle through all nodes (Sattolo's algorithm), identical on
+ * every PE as it's drawn from a fixed-seed generator rather than an LP's
+ * stream */
+static void perm_setup(void)
+{
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    perm = malloc(num_nodes * sizeof(*perm));
+    assert(perm);
+    for (uint64_t i = 0; i < num_nodes; i++)
+        perm[i] = i;
+    for (uint64_t i = num_nodes - 1; i > 0; i--) {
+        /* splitmix64 */
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        uint64_t j = z % i;
+        uint64_t t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+}
+
+static uint64_t perm_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq; (void)lp; (void)num_rngs;
+    return perm[src];
+}
+
+static uint64_t bitcomp_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq; (void)lp; (void)num_rngs;
+    return num_nodes - 1 - src;
+}
+
+static void transpose_setup(void)
+{
+    transpose_side = (uint64_t)sqrt((double)num_nodes);
+    while (transpose_side * transpose_side > num_nodes)
+        transpose_side--;
+    while ((transpose_side + 1) * (transpose_side + 1) <= num_nodes)
+        transpose_side++;
+    if (transpose_side * transpose_side != num_nodes)
+        tw_error(TW_LOC, "transpose pattern needs a square number of nodes "
+                "(got %llu)\n", LLU(num_nodes));
+}
+
+static uint64_t transpose_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq; (void)lp; (void)num_rngs;
+    return (src % transpose_side) * transpose_side + src / transpose_side;
+}
+
+static uint64_t tornado_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq; (void)lp; (void)num_rngs;
+    return (src + (num_nodes + 1) / 2 - 1) % num_nodes;
+}
+
+static uint64_t hotspot_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (*num_rngs)++;
+    if (tw_rand_unif(lp->rng) < hotspot_frac) {
+        (*num_rngs)++;
+        return tw_rand_integer(lp->rng, 0, hotspot_nodes - 1);
+    }
+    return uniform_dest(src, seq, lp, num_rngs);
+}
+
+/* the lower half of the nodes sends to the upper half and vice versa */
+static uint64_t bisection_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq;
+    uint64_t half = num_nodes / 2;
+    if (half == 0)
+        return src;
+    (*num_rngs)++;
+    if (src < half)
+        return half + tw_rand_integer(lp->rng, 0, num_nodes - half - 1);
+    else
+        return tw_rand_integer(lp->rng, 0, half - 1);
+}
+
+static uint64_t alltoall_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)lp; (void)num_rngs;
+    if (num_nodes < 2)
+        return src;
+    return (src + 1 + seq % (num_nodes - 1)) % num_nodes;
+}
+
+static uint64_t shift_dest(uint64_t src, uint64_t seq, tw_lp *lp,
+        int *num_rngs)
+{
+    (void)seq; (void)lp; (void)num_rngs;
+    return (src + shift) % num_nodes;
+}
+
+static synth_pattern const pattern_table[] =
+{
+    { "uniform",     NULL,            uniform_dest },
+    { "permutation", perm_setup,      perm_dest },
+    { "bitcomp",     NULL,            bitcomp_dest },
+    { "transpose",   transpose_setup, transpose_dest },
+    { "tornado",     NULL,            tornado_dest },
+    { "hotspot",     NULL,            hotspot_dest },
+    { "bisection",   NULL,            bisection_dest },
+    { "alltoall",    NULL,            alltoall_dest },
+    { "shift",       NULL,            shift_dest },
+    { NULL, NULL, NULL }
+};
+
+/* traffic mix: each message picks a pattern with probability proportional to
+ * the pattern's load */
+static int num_patterns;
+static synth_pattern const *patterns[SYNTH_MAX_PATTERNS];
+static double pattern_cdf[SYNTH_MAX_PATTERNS];
+
+/*
+ * arrival processes
+ *   - gap returns the time from this injection to the next one at the given
+ *     offered load (0 < load). Random numbers drawn are counted in
+ *     m->num_rngs, ns->burst_left is restored by the caller on rollback
+ */
+typedef struct synth_arrival
+{
+    char const *name;
+    tw_stime (*gap)(svr_state *ns, svr_msg *m, double load, tw_lp *lp);
+} synth_arrival;
+
+/* Poisson injection */
+static tw_stime exponential_gap(svr_state *ns, svr_msg *m, double load,
+        tw_lp *lp)
+{
+    (void)ns;
+    m->num_rngs++;
+    return tw_rand_exponential(lp->rng, msg_time / load);
+}
+
+/* injection slots of one message time, each used with probability load */
+static tw_stime bernoulli_gap(svr_state *ns, svr_msg *m, double load,
+        tw_lp *lp)
+{
+    (void)ns;
+    if (load >= 1.0)
+        return msg_time;
+    m->num_rngs++;
+    double u = tw_rand_unif(lp->rng);
+    if (u <= 0.0)
+        u = 1e-300;
+    return msg_time * (1.0 + floor(log(u) / log(1.0 - load)));
+}
+
+/* bursts of (geometrically distributed, mean burst_len) back-to-back
+ * messages separated by exponential silences sized to the offered load */
+static tw_stime onoff_gap(svr_state *ns, svr_msg *m, double load, tw_lp *lp)
+{
+    if (ns->burst_left > 0) {
+        ns->burst_left--;
+        return msg_time;
+    }
+    int len = 1;
+    if (burst_len > 1.0) {
+        m->num_rngs++;
+        double u = tw_rand_unif(lp->rng);
+        if (u <= 0.0)
+            u = 1e-300;
+        len = 1 + (int)floor(log(u) / log(1.0 - 1.0 / burst_len));
+    }
+    ns->burst_left = len - 1;
+    if (load >= 1.0)
+        return msg_time;
+    m->num_rngs++;
+    return msg_time + tw_rand_exponential(lp->rng,
+            burst_len * msg_time * (1.0 / load - 1.0));
+}
+
+static synth_arrival const arrival_table[] =
+{
+    { "exponential", exponential_gap },
+    { "bernoulli",   bernoulli_gap },
+    { "onoff",       onoff_gap },
+    { NULL, NULL }
+};
+
+static synth_arrival const *arrival;
+
+/* per-PE totals, reduced in svr_report_stats */
+static struct phase_stats *pe_stats;
+
+static void svr_init(
+    svr_state * ns,
+    tw_lp * lp);
+static void svr_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp);
+static void svr_rev_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp);
+static void svr_finalize(
+    svr_state * ns,
+    tw_lp * lp);
+
+tw_lptype svr_lp = {
+    (init_f) svr_init,
+    (pre_run_f) NULL,
+    (event_f) svr_event,
+    (revent_f) svr_rev_event,
+    (commit_f) NULL,
+    (final_f)  svr_finalize,
+    (map_f) codes_mapping,
+    sizeof(svr_state),
+};
+
+void synth_svr_event_collect(svr_msg *m, tw_lp *lp, char *buffer, int *collect_flag)
+{
+    (void)lp;
+    (void)collect_flag;
+    int type = (int) m->svr_event_type;
+    memcpy(buffer, &type, sizeof(type));
+}
+
+void synth_svr_model_stat_collect(svr_state *s, tw_lp *lp, char *buffer)
+{
+    (void)s;
+    (void)lp;
+    (void)buffer;
+    return;
+}
+
+st_model_types synth_svr_model_types[] = {
+    {(ev_trace_f) synth_svr_event_collect,
+     sizeof(int),
+     (model_stat_f) synth_svr_model_stat_collect,
+     0,
+     NULL,
+     NULL,
+     0},
+    {NULL, 0, NULL, 0, NULL, NULL, 0}
+};
+
+static const st_model_types  *synth_svr_get_model_stat_types(void)
+{
+    return(&synth_svr_model_types[0]);
+}
+
+void synth_svr_register_model_types()
+{
+    st_model_type_register("nw-lp", synth_svr_get_model_stat_types());
+}
+
+const tw_optdef app_opt [] =
+{
+        TWOPT_GROUP("Model net generic synthetic traffic " ),
+        TWOPT_STIME("sampling-interval", sampling_interval, "the sampling interval "),
+        TWOPT_STIME("sampling-end-time", sampling_end_time, "sampling end time "),
+        TWOPT_CHAR("lp-io-dir", lp_io_dir, "Where to place io output (unspecified -> no output"),
+        TWOPT_UINT("lp-io-use-suffix", lp_io_use_suffix, "Whether to append uniq suffix to lp-io directory (default 0)"),
+        TWOPT_END()
+};
+
+const tw_lptype* svr_get_lp_type()
+{
+            return(&svr_lp);
+}
+
+static void svr_add_lp_type()
+{
+  lp_type_register("nw-lp", svr_get_lp_type());
+}
+
+/* phase a time falls into, num_phases once the sweep is over */
+static int phase_of(tw_stime t)
+{
+    if (t >= num_phases * phase_length)
+        return num_phases;
+    int p = (int)(t / phase_length);
+    return p < num_phases ? p : num_phases - 1;
+}
+
+/* whether t falls into the measured part of its phase */
+static int measured(tw_stime t, int phase)
+{
+    return phase < num_phases && t - phase * phase_length >= warmup;
+}
+
+static void issue_event(
+    tw_stime offset,
+    tw_lp * lp)
+{
+    tw_event *e;
+    svr_msg *m;
+
+    if (offset < g_tw_lookahead)
+        offset = g_tw_lookahead;
+    if (phase_of(tw_now(lp) + offset) >= num_phases)
+        return;
+
+    e = tw_event_new(lp->gid, offset, lp);
+    m = tw_event_data(e);
+    m->svr_event_type = KICKOFF;
+    tw_event_send(e);
+}
+
+static void svr_init(
+    svr_state * ns,
+    tw_lp * lp)
+{
+    ns->svr_id = codes_mapping_get_lp_relative_id(lp->gid, 0, 0);
+    ns->seq = 0;
+    ns->burst_left = 0;
+    ns->local_recvd_count = 0;
+    ns->ph = calloc(num_phases, sizeof(*ns->ph));
+    assert(ns->ph);
+
+    /* skew each kickoff event slightly to help avoid event ties later on */
+    issue_event(1.1 * g_tw_lookahead + tw_rand_exponential(lp->rng, msg_time),
+            lp);
+    return;
+}
+
+static void handle_kickoff_rev_event(
+            svr_state * ns,
+            tw_bf * b,
+            svr_msg * m,
+            tw_lp * lp)
+{
+    if (b->c1) {
+        model_net_event_rc2(lp, &m->event_rc);
+        ns->ph[m->phase].sent--;
+    }
+    if (b->c2)
+        ns->seq--;
+    ns->burst_left = m->saved_burst;
+    for (int i = 0; i < m->num_rngs; i++)
+        tw_rand_reverse_unif(lp->rng);
+}
+
+static void handle_kickoff_event(
+	    svr_state * ns,
+	    tw_bf * b,
+	    svr_msg * m,
+	    tw_lp * lp)
+{
+    int phase = phase_of(tw_now(lp));
+    double load;
+    tw_stime gap;
+
+    m->phase = phase;
+    m->num_rngs = 0;
+    m->saved_burst = ns->burst_left;
+    if (phase >= num_phases)
+        return;
+
+    load = phase_loads[phase];
+    if (load <= 0.0) {
+        /* idle phase - wait for the next one */
+        issue_event((phase + 1) * phase_length - tw_now(lp), lp);
+        return;
+    }
+
+    synth_pattern const *pat = patterns[0];
+    if (num_patterns > 1) {
+        double u = tw_rand_unif(lp->rng);
+        m->num_rngs++;
+        for (int i = 0; i < num_patterns; i++) {
+            if (u < pattern_cdf[i] || i == num_patterns - 1) {
+                pat = patterns[i];
+                break;
+            }
+        }
+    }
+
+    uint64_t local_dest = pat->dest(ns->svr_id, ns->seq, lp, &m->num_rngs);
+    assert(local_dest < num_nodes);
+    b->c2 = 1;
+    ns->seq++;
+
+    if (local_dest != ns->svr_id) {
+        svr_msg m_local, m_remote;
+        tw_lpid global_dest = codes_mapping_get_lpid_from_relative(
+                (int)local_dest, NULL, "nw-lp", NULL, 0);
+
+        memset(&m_local, 0, sizeof(m_local));
+        m_local.svr_event_type = LOCAL;
+        m_local.src = lp->gid;
+        m_local.phase = phase;
+        m_local.msg_start_time = tw_now(lp);
+        m_remote = m_local;
+        m_remote.svr_event_type = REMOTE;
+
+        b->c1 = 1;
+        ns->ph[phase].sent++;
+        m->event_rc = model_net_event(net_id, "synthetic", global_dest,
+                payload_sz, 0.0, sizeof(svr_msg), &m_remote,
+                sizeof(svr_msg), &m_local, lp);
+    }
+
+    gap = arrival->gap(ns, m, load, lp);
+    issue_event(gap, lp);
+}
+
+static void handle_remote_rev_event(
+            svr_state * ns,
+            tw_bf * b,
+            svr_msg * m,
+            tw_lp * lp)
+{
+    if (b->c3)
+        ns->ph[phase_of(tw_now(lp))].accepted_bytes -= payload_sz;
+    if (b->c4) {
+        struct phase_stats *ph = &ns->ph[m->phase];
+        ph->recvd--;
+        ph->sum_latency -= tw_now(lp) - m->msg_start_time;
+        if (b->c5)
+            ph->max_latency = m->saved_time;
+    }
+}
+
+static void handle_remote_event(
+	    svr_state * ns,
+	    tw_bf * b,
+	    svr_msg * m,
+	    tw_lp * lp)
+{
+    int now_phase = phase_of(tw_now(lp));
+
+    /* accepted throughput of the phase we're in */
+    if (measured(tw_now(lp), now_phase)) {
+        b->c3 = 1;
+        ns->ph[now_phase].accepted_bytes += payload_sz;
+    }
+
+    /* latency of the phase the message was injected in */
+    if (measured(m->msg_start_time, m->phase)) {
+        struct phase_stats *ph = &ns->ph[m->phase];
+        tw_stime latency = tw_now(lp) - m->msg_start_time;
+        b->c4 = 1;
+        ph->recvd++;
+        ph->sum_latency += latency;
+        if (latency > ph->max_latency) {
+            b->c5 = 1;
+            m->saved_time = ph->max_latency;
+            ph->max_latency = latency;
+        }
+    }
+}
+
+static void handle_local_rev_event(
+                svr_state * ns,
+                tw_bf * b,
+                svr_msg * m,
+                tw_lp * lp)
+{
+    (void)b;
+    (void)m;
+    (void)lp;
+    ns->local_recvd_count--;
+}
+
+static void handle_local_event(
+                svr_state * ns,
+                tw_bf * b,
+                svr_msg * m,
+                tw_lp * lp)
+{
+    (void)b;
+    (void)m;
+    (void)lp;
+    ns->local_recvd_count++;
+}
+
+/* convert seconds to ns */
+static tw_stime s_to_ns(tw_stime ns)
+{
+    return(ns * (1000.0 * 1000.0 * 1000.0));
+}
+
+static void svr_finalize(
+    svr_state * ns,
+    tw_lp * lp)
+{
+    (void)lp;
+    for (int i = 0; i < num_phases; i++) {
+        pe_stats[i].sent += ns->ph[i].sent;
+        pe_stats[i].recvd += ns->ph[i].recvd;
+        pe_stats[i].accepted_bytes += ns->ph[i].accepted_bytes;
+        pe_stats[i].sum_latency += ns->ph[i].sum_latency;
+        if (ns->ph[i].max_latency > pe_stats[i].max_latency)
+            pe_stats[i].max_latency = ns->ph[i].max_latency;
+    }
+    free(ns->ph);
+    return;
+}
+
+static void svr_rev_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp)
+{
+    switch (m->svr_event_type)
+    {
+	case REMOTE:
+		handle_remote_rev_event(ns, b, m, lp);
+		break;
+	case LOCAL:
+		handle_local_rev_event(ns, b, m, lp);
+		break;
+	case KICKOFF:
+		handle_kickoff_rev_event(ns, b, m, lp);
+		break;
+	default:
+		assert(0);
+		break;
+    }
+}
+
+static void svr_event(
+    svr_state * ns,
+    tw_bf * b,
+    svr_msg * m,
+    tw_lp * lp)
+{
+   switch (m->svr_event_type)
+    {
+        case REMOTE:
+            handle_remote_event(ns, b, m, lp);
+            break;
+        case LOCAL:
+            handle_local_event(ns, b, m, lp);
+            break;
+	case KICKOFF:
+	    handle_kickoff_event(ns, b, m, lp);
+	    break;
+        default:
+            printf("\n Invalid message type %d ", m->svr_event_type);
+            assert(0);
+        break;
+    }
+}
+
+/* read the "synthetic" group of the configuration */
+static void synth_configure(void)
+{
+    char val[MAX_NAME_LENGTH];
+    char **values;
+    size_t length;
+    int rc;
+
+    configuration_get_value_int(&config, SYNTH_NAME, "payload_size", NULL,
+            &payload_sz);
+    assert(payload_sz > 0);
+
+    /* injection bandwidth: explicit, or the compute node link of the
+     * network model */
+    injection_bw = 0.0;
+    if (configuration_get_value_double(&config, SYNTH_NAME, "injection_bw",
+                NULL, &injection_bw) &&
+            configuration_get_value_double(&config, "PARAMS", "cn_bandwidth",
+                NULL, &injection_bw) &&
+            configuration_get_value_double(&config, "PARAMS",
+                "link_bandwidth", NULL, &injection_bw)) {
+        double mbps;
+        if (configuration_get_value_double(&config, "PARAMS", "net_bw_mbps",
+                    NULL, &mbps) == 0)
+            injection_bw = mbps / 1024.0;
+    }
+    if (injection_bw <= 0.0)
+        tw_error(TW_LOC, "synthetic: set injection_bw (GiB/s) in the \""
+                SYNTH_NAME "\" group\n");
+    msg_time = payload_sz / (injection_bw * 1.073741824);
+
+    /* patterns and their share of the load */
+    rc = configuration_get_multivalue(&config, SYNTH_NAME, "patterns", NULL,
+            &values, &length);
+    if (rc != 1 || length == 0) {
+        num_patterns = 1;
+        patterns[0] = &pattern_table[0];
+        pattern_cdf[0] = 1.0;
+    }
+    else {
+        if (length > SYNTH_MAX_PATTERNS)
+            tw_error(TW_LOC, "synthetic: at most %d patterns\n",
+                    SYNTH_MAX_PATTERNS);
+        num_patterns = length;
+        for (size_t i = 0; i < length; i++) {
+            int j;
+            for (j = 0; pattern_table[j].name != NULL; j++)
+                if (strcmp(pattern_table[j].name, values[i]) == 0)
+                    break;
+            if (pattern_table[j].name == NULL)
+                tw_error(TW_LOC, "synthetic: unknown pattern \"%s\"\n",
+                        values[i]);
+            patterns[i] = &pattern_table[j];
+            free(values[i]);
+        }
+        free(values);
+
+        double sum = 0.0;
+        rc = configuration_get_multivalue(&config, SYNTH_NAME,
+                "pattern_loads", NULL, &values, &length);
+        for (int i = 0; i < num_patterns; i++) {
+            double w = 1.0;
+            if (rc == 1 && (size_t)i < length)
+                w = strtod(values[i], NULL);
+            assert(w >= 0.0);
+            sum += w;
+            pattern_cdf[i] = sum;
+        }
+        if (rc == 1) {
+            if (length != (size_t)num_patterns)
+                tw_error(TW_LOC, "synthetic: pattern_loads needs one entry "
+                        "per pattern\n");
+            for (size_t i = 0; i < length; i++)
+                free(values[i]);
+            free(values);
+        }
+        assert(sum > 0.0);
+        for (int i = 0; i < num_patterns; i++)
+            pattern_cdf[i] /= sum;
+    }
+
+    /* arrival process */
+    val[0] = '\0';
+    configuration_get_value(&config, SYNTH_NAME, "arrival", NULL, val,
+            MAX_NAME_LENGTH);
+    arrival = &arrival_table[0];
+    if (val[0] != '\0') {
+        for (arrival = arrival_table; arrival->name != NULL; arrival++)
+            if (strcmp(arrival->name, val) == 0)
+                break;
+        if (arrival->name == NULL)
+            tw_error(TW_LOC, "synthetic: unknown arrival process \"%s\"\n",
+                    val);
+    }
+
+    /* load sweep */
+    rc = configuration_get_multivalue(&config, SYNTH_NAME, "loads", NULL,
+            &values, &length);
+    if (rc != 1 || length == 0)
+        tw_error(TW_LOC, "synthetic: \"loads\" must list at least one "
+                "offered load\n");
+    num_phases = length;
+    phase_loads = malloc(num_phases * sizeof(*phase_loads));
+    for (size_t i = 0; i < length; i++) {
+        phase_loads[i] = strtod(values[i], NULL);
+        free(values[i]);
+    }
+    free(values);
+
+    phase_length = 100000.0;
+    warmup = 0.0;
+    configuration_get_value_double(&config, SYNTH_NAME, "phase_length", NULL,
+            &phase_length);
+    configuration_get_value_double(&config, SYNTH_NAME, "warmup", NULL,
+            &warmup);
+    if (phase_length <= 0.0 || warmup < 0.0 || warmup >= phase_length)
+        tw_error(TW_LOC, "synthetic: need 0 <= warmup < phase_length\n");
+
+    /* pattern parameters */
+    configuration_get_value_int(&config, SYNTH_NAME, "hotspot_nodes", NULL,
+            &hotspot_nodes);
+    configuration_get_value_double(&config, SYNTH_NAME, "hotspot_frac", NULL,
+            &hotspot_frac);
+    configuration_get_value_int(&config, SYNTH_NAME, "shift", NULL, &shift);
+    configuration_get_value_double(&config, SYNTH_NAME, "burst_len", NULL,
+            &burst_len);
+    if (hotspot_nodes < 1 || (uint64_t)hotspot_nodes > num_nodes)
+        tw_error(TW_LOC, "synthetic: hotspot_nodes must be in [1, %llu]\n",
+                LLU(num_nodes));
+    assert(burst_len >= 1.0);
+    shift %= (int)num_nodes;
+    if (shift < 0)
+        shift += (int)num_nodes;
+
+    for (int i = 0; i < num_patterns; i++)
+        if (patterns[i]->setup) {
+            int j;
+            for (j = 0; j < i; j++)
+                if (patterns[j] == patterns[i])
+                    break;
+            if (j == i)
+                patterns[i]->setup();
+        }
+
+    pe_stats = calloc(num_phases, sizeof(*pe_stats));
+    assert(pe_stats);
+}
+
+// does MPI reduces across PEs to report the load sweep
+static void svr_report_stats()
+{
+    long long sent, recvd, accepted;
+    tw_stime sum_latency, max_latency;
+    double window_bytes = (double)num_nodes * (phase_length - warmup) *
+        injection_bw * 1.073741824;
+
+    if(!g_tw_mynode)
+    {
+        printf("\nSynthetic traffic: %llu nodes, %d-byte messages at %.3lf "
+                "GiB/s, %s arrivals, patterns:", LLU(num_nodes), payload_sz,
+                injection_bw, arrival->name);
+        for (int i = 0; i < num_patterns; i++)
+            printf(" %s (%.2lf)", patterns[i]->name,
+                    pattern_cdf[i] - (i ? pattern_cdf[i-1] : 0.0));
+        printf("\n%6s %13s %14s %14s %17s %16s\n", "phase", "offered_load",
+                "accepted_load", "msgs_measured", "mean_latency_us",
+                "max_latency_us");
+    }
+
+    for (int i = 0; i < num_phases; i++) {
+        MPI_Reduce(&pe_stats[i].sent, &sent, 1, MPI_LONG_LONG, MPI_SUM, 0,
+                MPI_COMM_CODES);
+        MPI_Reduce(&pe_stats[i].recvd, &recvd, 1, MPI_LONG_LONG, MPI_SUM, 0,
+                MPI_COMM_CODES);
+        MPI_Reduce(&pe_stats[i].accepted_bytes, &accepted, 1, MPI_LONG_LONG,
+                MPI_SUM, 0, MPI_COMM_CODES);
+        MPI_Reduce(&pe_stats[i].sum_latency, &sum_latency, 1, MPI_DOUBLE,
+                MPI_SUM, 0, MPI_COMM_CODES);
+        MPI_Reduce(&pe_stats[i].max_latency, &max_latency, 1, MPI_DOUBLE,
+                MPI_MAX, 0, MPI_COMM_CODES);
+        if(!g_tw_mynode)
+            printf("%6d %13.3lf %14.3lf %14lld %17.3lf %16.3lf\n", i,
+                    phase_loads[i], accepted / window_bytes, recvd,
+                    recvd ? sum_latency / recvd / 1000.0 : 0.0,
+                    max_latency / 1000.0);
+    }
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    int nprocs;
+    int rank;
+    int num_nets;
+    int *net_ids;
+
+    tw_opt_add(app_opt);
+    tw_init(&argc, &argv);
+
+#ifdef USE_RDAMARIS
+    if(g_st_ross_rank)
+    { // keep damaris ranks from running code between here up until tw_end()
+#endif
+    codes_comm_update();
+
+    if(argc < 2)
+    {
+            printf("\n Usage: mpirun <args> --sync=1/2/3 -- <config_file.conf> ");
+            MPI_Finalize();
+            return 0;
+    }
+
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    MPI_Comm_size(MPI_COMM_CODES, &nprocs);
+
+    configuration_load(argv[2], MPI_COMM_CODES, &config);
+
+    model_net_register();
+    svr_add_lp_type();
+
+    if (g_st_ev_trace || g_st_model_stats || g_st_use_analysis_lps)
+        synth_svr_register_model_types();
+
+    codes_mapping_setup();
+
+    net_ids = model_net_configure(&num_nets);
+    net_id = *net_ids;
+    free(net_ids);
+
+    num_nodes = codes_mapping_get_lp_count(NULL, 0, "nw-lp", NULL, 1);
+    assert(num_nodes);
+
+    synth_configure();
+
+    /* run through the sweep, plus time for the last messages to drain */
+    g_tw_ts_end = num_phases * phase_length + s_to_ns(1);
+    model_net_enable_sampling(sampling_interval, sampling_end_time);
+
+    if(lp_io_dir[0])
+    {
+        do_lp_io = 1;
+        int flags = lp_io_use_suffix ? LP_IO_UNIQ_SUFFIX : 0;
+        int ret = lp_io_prepare(lp_io_dir, flags, &io_handle, MPI_COMM_CODES);
+        assert(ret == 0 || !"lp_io_prepare failure");
+    }
+    tw_run();
+    if (do_lp_io){
+        int ret = lp_io_flush(io_handle, MPI_COMM_CODES);
+        assert(ret == 0 || !"lp_io_flush failure");
+    }
+    model_net_report_stats(net_id);
+    svr_report_stats();
+#ifdef USE_RDAMARIS
+    } // end if(g_st_ross_rank)
+#endif
+    tw_end();
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
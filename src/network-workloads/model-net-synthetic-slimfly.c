@@ -101,8 +101,6 @@ struct svr_state
     int local_recvd_count; /* number of local messages received */
     tw_stime start_ts;    /* time that we started sending requests */
     tw_stime end_ts;      /* time that we ended sending requests */
-    char output_buf[512]; /* buffer space for lp-io output data */
-    char output_buf2[65536]; /* buffer space for lp-io output data */
 };
 
 struct svr_msg
@@ -110,6 +108,7 @@ struct svr_msg
     enum svr_event svr_event_type;
     tw_lpid src;          /* source of this request or ack */
     int incremented_flag; /* helper for reverse computation */
+    int num_transfers;    /* helper for reverse computation */
     model_net_event_return event_rc;
 };
 
@@ -304,7 +303,7 @@ static void handle_kickoff_rev_event(
     (void)m;
     (void)lp;
 
-    ns->msg_sent_count--;
+    ns->msg_sent_count -= m->num_transfers;
     if(b->c2)
         m->incremented_flag = 0;
 
@@ -327,9 +326,13 @@ static void handle_kickoff_event(
     {
         b->c2 = 1;
         m->incremented_flag = 1;
+        m->num_transfers = 0;
+        m->event_rc = 0;
         return;
     }
     m->incremented_flag = 0;
+    m->num_transfers = 0;
+    m->event_rc = 0;
 
     char anno[MAX_NAME_LENGTH];
 
@@ -353,7 +356,6 @@ static void handle_kickoff_event(
 
     int num_transfers = 0;
     int *local_dest;
-    tw_lpid global_dest = -1;
 
     // Compute current server's local/relative ID
     int server_id = rep_id * num_server_lps + offset;
@@ -457,18 +459,29 @@ static void handle_kickoff_event(
         local_dest[0] = (server_id + (int)(num_nodes/3)) % num_nodes;
     }
 
-    for(int i=0; i<num_transfers; i++){
-        // Verify local/relative ID of the destination is a valid option
-        assert(local_dest[i] < num_nodes);
-        // Get global/lp ID of the destination
-        codes_mapping_get_lp_id(group_name, lp_type_name, anno, 1, local_dest[i] / num_servers_per_rep, local_dest[i] % num_servers_per_rep, &global_dest);
-        // Increment send count in communication heat map
-        // comm_map[server_id][local_dest[i]]++; //TODO: NM: This is broken in cons/opt
+    if(num_transfers > 0){
+        tw_lpid *global_dests = malloc(num_transfers*sizeof(tw_lpid));
+        uint64_t *sizes = malloc(num_transfers*sizeof(uint64_t));
+        for(int i=0; i<num_transfers; i++){
+            // Verify local/relative ID of the destination is a valid option
+            assert(local_dest[i] < num_nodes);
+            // Get global/lp ID of the destination
+            codes_mapping_get_lp_id(group_name, lp_type_name, anno, 1, local_dest[i] / num_servers_per_rep, local_dest[i] % num_servers_per_rep, &global_dests[i]);
+            sizes[i] = payload_size;
+            // Increment send count in communication heat map
+            // comm_map[server_id][local_dest[i]]++; //TODO: NM: This is broken in cons/opt
+        }
         // Increment send count
-        ns->msg_sent_count++;
-        // Issue event //TODO: NM: This is broken in optimistic when num_transfers > 1
-        m->event_rc = model_net_event(net_id, "test", global_dest, payload_size, i*0.2, sizeof(svr_msg), (const void*)m_remote, sizeof(svr_msg), (const void*)m_local, lp);
-        
+        ns->msg_sent_count += num_transfers;
+        m->num_transfers = num_transfers;
+        // Issue all transfers as one batch so they reverse together. The
+        // batch enters the NIC queue at once and in destination order, where
+        // the former per-transfer offsets of i*0.2 ns only spread the
+        // enqueue times; the order of the sends is the same
+        m->event_rc = model_net_event_multi(net_id, "test", num_transfers, global_dests, sizes, 0.0, sizeof(svr_msg), (const void*)m_remote, sizeof(svr_msg), (const void*)m_local, lp);
+
+        free(global_dests);
+        free(sizes);
         free(local_dest);
     }
     issue_event(ns, lp);
@@ -545,18 +558,15 @@ static void svr_finalize(
     double observed_load = ((double)payload_size*(double)ns->msg_recvd_count)/observed_load_time;
     observed_load = observed_load * (double)(1000*1000*1000);
     observed_load = observed_load / (double)(1024*1024*1024);
-    int written = 0;
-    int written2 = 0;
 
     if(lp->gid == 0){
-        written = sprintf(ns->output_buf, "# Format <LP id> <Msgs Sent> <Msgs Recvd> <Bytes Sent> <Bytes Recvd> <Offered Load [GBps]> <Observed Load [GBps]> <End Time [ns]>\n");
-        written2 = sprintf(ns->output_buf2, "# Format <server ID> <sends to svr 0> <sends to svr 1> ... <sends to svr N>\n");
+        lp_io_fmt("# Format <LP id> <Msgs Sent> <Msgs Recvd> <Bytes Sent> <Bytes Recvd> <Offered Load [GBps]> <Observed Load [GBps]> <End Time [ns]>\n");
     }
 
-    written += sprintf(ns->output_buf + written, "%llu %d %d %d %d %f %f %f %f\n",LLU(lp->gid), ns->msg_sent_count, ns->msg_recvd_count,
+    lp_io_fmt("%llu %d %d %d %d %f %f %f %f\n",LLU(lp->gid), ns->msg_sent_count, ns->msg_recvd_count,
             payload_size*ns->msg_sent_count, payload_size*ns->msg_recvd_count, load*link_bandwidth, observed_load, ns->end_ts, observed_load_time);
 
-    lp_io_write(lp->gid, "synthetic-stats", written, ns->output_buf);
+    lp_io_fmt_write(lp->gid, "synthetic-stats");
 
 
     //TODO: NM: This is broken for cons/opt
@@ -42,6 +42,8 @@ static model_net_base_params     all_params[CONFIGURATION_MAX_ANNOS];
 
 static tw_stime mn_sample_interval = 0.0;
 static tw_stime mn_sample_end = 0.0;
+static int num_servers = -1;
+static int servers_per_node = -1;
 static int servers_per_node_queue = -1;
 extern tw_stime codes_cn_delay;
 
@@ -99,6 +101,11 @@ static void handle_sched_next(
         tw_bf *b,
         model_net_wrap_msg * m,
         tw_lp * lp);
+static void handle_new_multi(
+        model_net_base_state * ns,
+        tw_bf *b,
+        model_net_wrap_msg * m,
+        tw_lp * lp);
 static void handle_new_msg_rc(
         model_net_base_state * ns,
         tw_bf *b,
@@ -109,6 +116,11 @@ static void handle_sched_next_rc(
         tw_bf *b,
         model_net_wrap_msg * m,
         tw_lp * lp);
+static void handle_new_multi_rc(
+        model_net_base_state * ns,
+        tw_bf *b,
+        model_net_wrap_msg * m,
+        tw_lp * lp);
 static void model_net_commit_event(
         model_net_base_state * ns,
         tw_bf *b,
@@ -159,6 +171,10 @@ void mn_event_collect(model_net_wrap_msg *m, tw_lp *lp, char *buffer, int *colle
             type = 9002;
             memcpy(buffer, &type, sizeof(type));
             break;
+        case MN_BASE_NEW_MULTI:
+            type = 9003;
+            memcpy(buffer, &type, sizeof(type));
+            break;
         case MN_BASE_PASS:
             sub_msg = ((char*)m)+msg_offsets[((model_net_base_state*)lp->cur_state)->net_id];
             if (((model_net_base_state*)lp->cur_state)->sub_model_type)
@@ -423,6 +439,12 @@ void model_net_base_configure(){
         offsetof(model_net_wrap_msg, msg.m_em);
     msg_offsets[EXPRESS_MESH_ROUTER] =
         offsetof(model_net_wrap_msg, msg.m_em);
+    msg_offsets[FLOWNET] =
+        offsetof(model_net_wrap_msg, msg.m_flow);
+    msg_offsets[GRAPHNET] =
+        offsetof(model_net_wrap_msg, msg.m_graph);
+    msg_offsets[GRAPHNET_ROUTER] =
+        offsetof(model_net_wrap_msg, msg.m_graph);
 
 
     // perform the configuration(s)
@@ -583,6 +605,9 @@ void model_net_base_event(
         case MN_BASE_SCHED_NEXT:
             handle_sched_next(ns, b, m, lp);
             break;
+        case MN_BASE_NEW_MULTI:
+            handle_new_multi(ns, b, m, lp);
+            break;
         case MN_BASE_SAMPLE: ;
             event_f sample = method_array[ns->net_id]->mn_sample_fn;
             assert(model_net_sampling_enabled() && sample != NULL);
@@ -616,6 +641,9 @@ void model_net_base_event_rc(
         case MN_BASE_SCHED_NEXT:
             handle_sched_next_rc(ns, b, m, lp);
             break;
+        case MN_BASE_NEW_MULTI:
+            handle_new_multi_rc(ns, b, m, lp);
+            break;
         case MN_BASE_SAMPLE: ;
             revent_f sample_rc = method_array[ns->net_id]->mn_sample_rc_fn;
             assert(model_net_sampling_enabled() && sample_rc != NULL);
@@ -643,24 +671,13 @@ void model_net_base_finalize(
     free(ns->sub_state);
 }
 
-/// bitfields used:
-/// c31 - we initiated a sched_next event
-void handle_new_msg(
-        model_net_base_state * ns,
-        tw_bf *b,
-        model_net_wrap_msg * m,
-        tw_lp * lp){
-#if DEBUG
-    printf("%llu Entered handle_new_msg()\n",LLU(tw_now(lp)));
-#endif
-    static int num_servers = -1;
-    static int servers_per_node = -1;
+// the server counts are derived from the first sender seen by any base LP
+static void init_server_counts(model_net_base_state * ns, tw_lpid src_lp){
     if(num_servers == -1) {
         char const *sender_group;
         char const *sender_lpname;
         int rep_id, offset;
-        model_net_request *r = &m->msg.m_base.req;
-        codes_mapping_get_lp_info2(r->src_lp, &sender_group, &sender_lpname,
+        codes_mapping_get_lp_info2(src_lp, &sender_group, &sender_lpname,
                 NULL, &rep_id, &offset);
         num_servers = codes_mapping_get_lp_count(sender_group, 1,
                 sender_lpname, NULL, 1);
@@ -675,6 +692,31 @@ void handle_new_msg(
                 servers_per_node_queue, ns->nics_per_router);
         }
     }
+}
+
+// injection queue used for messages sent by src_lp
+static int send_queue_offset(model_net_base_state * ns, tw_lpid src_lp){
+    if(ns->params->num_queues == 1)
+        return 0;
+    int rep_id, offset;
+    codes_mapping_get_lp_info2(src_lp, NULL, NULL, NULL, &rep_id, &offset);
+#if DEBUG
+    printf("src_lp:%llu, num_servers:%d num_queues:%d, offset:%d servers_per_node:%d\n",LLU(src_lp), num_servers, ns->params->num_queues, offset, servers_per_node);
+#endif
+    return (offset/servers_per_node) % ns->params->num_queues;
+}
+
+/// bitfields used:
+/// c31 - we initiated a sched_next event
+void handle_new_msg(
+        model_net_base_state * ns,
+        tw_bf *b,
+        model_net_wrap_msg * m,
+        tw_lp * lp){
+#if DEBUG
+    printf("%llu Entered handle_new_msg()\n",LLU(tw_now(lp)));
+#endif
+    init_server_counts(ns, m->msg.m_base.req.src_lp);
 
     if(lp->gid == m->msg.m_base.req.dest_mn_lp) {
         model_net_request *r = &m->msg.m_base.req;
@@ -752,25 +794,8 @@ void handle_new_msg(
     }
 
     int queue_offset = 0;
-    if(!m->msg.m_base.is_from_remote && ns->params->num_queues != 1) {
-        int rep_id, offset;
-        if(num_servers == -1) {
-            char const *sender_group;
-            char const *sender_lpname;
-            codes_mapping_get_lp_info2(r->src_lp, &sender_group, &sender_lpname,
-                    NULL, &rep_id, &offset);
-            num_servers = codes_mapping_get_lp_count(sender_group, 1,
-                    sender_lpname, NULL, 1);
-            servers_per_node = num_servers/ns->params->num_queues;
-            if(servers_per_node == 0) servers_per_node = 1;
-        } else {
-            codes_mapping_get_lp_info2(r->src_lp, NULL, NULL, NULL, &rep_id, &offset);
-        }
-#if DEBUG
-        printf("r->src_lp:%llu, num_servers:%d num_queues:%d, offset:%d servers_per_node:%d\n",LLU(r->src_lp), num_servers, ns->params->num_queues, offset, servers_per_node);
-#endif
-        queue_offset = (offset/servers_per_node) % ns->params->num_queues;
-    }
+    if(!m->msg.m_base.is_from_remote)
+        queue_offset = send_queue_offset(ns, r->src_lp);
     r->queue_offset = queue_offset;
 #if DEBUG
     printf("queue_offset:%d\n",queue_offset);
@@ -835,6 +860,93 @@ void handle_new_msg_rc(
     model_net_sched_add_rc(ss, &m->msg.m_base.rc, lp);
 }
 
+/// bitfields used:
+/// c31 - we initiated a sched_next event
+void handle_new_multi(
+        model_net_base_state * ns,
+        tw_bf *b,
+        model_net_wrap_msg * m,
+        tw_lp * lp){
+    model_net_base_msg *mb = &m->msg.m_base;
+    model_net_request *r = &mb->req;
+    int tmpl_size = r->remote_event_size + r->self_event_size;
+
+    if(mb->isQueueReq) {
+        // the batch goes through the NIC sequencer as a whole: it reaches the
+        // scheduler when its first message would have, and holds the
+        // sequencer for one nic_seq_delay per message
+        mb->save_ts = ns->next_available_time;
+        tw_stime exp_time = ((ns->next_available_time > tw_now(lp)) ? ns->next_available_time : tw_now(lp));
+        exp_time += ns->params->nic_seq_delay + codes_local_latency(lp);
+        ns->next_available_time = exp_time +
+            (mb->num_dests - 1) * ns->params->nic_seq_delay;
+        tw_event *e = tw_event_new(lp->gid, exp_time - tw_now(lp), lp);
+        model_net_wrap_msg *m_new = tw_event_data(e);
+        memcpy(m_new, m, sizeof(model_net_wrap_msg) + tmpl_size +
+                mb->num_dests * sizeof(model_net_multi_dest));
+        m_new->msg.m_base.isQueueReq = 0;
+        tw_event_send(e);
+        return;
+    }
+
+    init_server_counts(ns, r->src_lp);
+    int queue_offset = send_queue_offset(ns, r->src_lp);
+    r->queue_offset = queue_offset;
+
+    void *remote = NULL, *local = NULL;
+    if (r->remote_event_size > 0)
+        remote = m+1;
+    if (r->self_event_size > 0)
+        local = (char*)(m+1) + r->remote_event_size;
+    model_net_multi_dest const *d =
+        (model_net_multi_dest const *)((char*)(m+1) + tmpl_size);
+
+    model_net_sched *ss = ns->sched_send[queue_offset];
+    model_net_request req = *r;
+    req.packet_size = ns->params->packet_size;
+    // every request of the batch shares the sched params, so the single rc
+    // struct serves all of the add_rc calls
+    for (int i = 0; i < mb->num_dests; i++) {
+        req.final_dest_lp = d[i].final_dest_lp;
+        req.dest_mn_lp = d[i].dest_mn_lp;
+        req.msg_size = d[i].msg_size;
+        req.msg_id = ns->msg_id++;
+        model_net_sched_add(&req, &mb->sched_params, r->remote_event_size,
+                remote, r->self_event_size, local, ss, &mb->rc, lp);
+    }
+
+    if (ns->in_sched_send_loop[queue_offset] == 0){
+        b->c31 = 1;
+        ns->in_sched_send_loop[queue_offset] = 1;
+        /* the scheduler was idle, so a request finished by this sched_next
+         * is the batch's first one and the event save area it overwrites
+         * (right after m) already holds the identical templates */
+        handle_sched_next(ns, b, m, lp);
+        assert(ns->in_sched_send_loop[queue_offset]);
+    }
+}
+
+void handle_new_multi_rc(
+        model_net_base_state * ns,
+        tw_bf *b,
+        model_net_wrap_msg * m,
+        tw_lp * lp){
+    model_net_base_msg *mb = &m->msg.m_base;
+    if(mb->isQueueReq) {
+        codes_local_latency_reverse(lp);
+        ns->next_available_time = mb->save_ts;
+        return;
+    }
+    int queue_offset = mb->req.queue_offset;
+    model_net_sched *ss = ns->sched_send[queue_offset];
+    if (b->c31) {
+        handle_sched_next_rc(ns, b, m, lp);
+        ns->in_sched_send_loop[queue_offset] = 0;
+    }
+    for (int i = 0; i < mb->num_dests; i++)
+        model_net_sched_add_rc(ss, &mb->rc, lp);
+}
+
 /// bitfields used
 /// c0 - scheduler loop is finished
 void handle_sched_next(
@@ -865,7 +977,8 @@ void handle_sched_next(
     // callback-based scheduling loop (model_net_method_idle_event).
     // For all others, we need to schedule the next packet
     // immediately
-    else if (ns->net_id == SIMPLEP2P || ns->net_id == TORUS){
+    else if (ns->net_id == SIMPLEP2P || ns->net_id == TORUS ||
+            ns->net_id == FLOWNET){
         tw_event *e = tw_event_new(lp->gid,
                 poffset+codes_local_latency(lp), lp);
         model_net_wrap_msg *m_wrap = tw_event_data(e);
@@ -894,7 +1007,8 @@ void handle_sched_next_rc(
     if (b->c0){
         *in_sched_loop = 1;
     }
-    else if (ns->net_id == SIMPLEP2P || ns->net_id == TORUS){
+    else if (ns->net_id == SIMPLEP2P || ns->net_id == TORUS ||
+            ns->net_id == FLOWNET){
         codes_local_latency_reverse(lp);
     }
 }
@@ -35,6 +35,9 @@ extern struct model_net_method dragonfly_custom_router_method;
 extern struct model_net_method loggp_method;
 extern struct model_net_method express_mesh_method;
 extern struct model_net_method express_mesh_router_method;
+extern struct model_net_method flownet_method;
+extern struct model_net_method graphnet_method;
+extern struct model_net_method graphnet_router_method;
 
 #define X(a,b,c,d) b,
 char * model_net_lp_config_names[] = {
@@ -55,6 +58,8 @@ struct model_net_method* method_array[] = {
 };
 #undef X
 
+int mn_topology_lookahead = 0;
+
 // counter and offset for the MN_START_SEQ / MN_END_SEQ macros
 int mn_in_sequence = 0;
 tw_stime mn_msg_offset = 0.0;
@@ -88,9 +93,41 @@ void model_net_register(){
             }
         }
     }
+    for (int n = 0; n < MAX_NETS; n++){
+        if (do_config_nets[n] && method_array[n]->mn_partition_hint != NULL)
+            method_array[n]->mn_partition_hint();
+    }
     model_net_base_register(do_config_nets);
 }
 
+/* set g_tw_lookahead to the smallest lookahead the configured networks can
+ * guarantee, so that conservative runs get the widest safe windows */
+static void model_net_set_topology_lookahead(){
+    tw_stime lookahead = 0;
+    for (int n = 0; n < MAX_NETS; n++){
+        if (!do_config_nets[n])
+            continue;
+        tw_stime l = method_array[n]->mn_lookahead != NULL ?
+            method_array[n]->mn_lookahead() : 0;
+        if (l <= 0){
+            if (!g_tw_mynode)
+                fprintf(stderr, "PARAMS:topology_lookahead: network %s has "
+                        "no guaranteed lookahead, keeping %lf ns\n",
+                        model_net_method_names[n], g_tw_lookahead);
+            return;
+        }
+        if (lookahead == 0 || l < lookahead)
+            lookahead = l;
+    }
+    if (lookahead == 0)
+        return;
+    g_tw_lookahead = lookahead;
+    mn_topology_lookahead = 1;
+    if (!g_tw_mynode)
+        fprintf(stderr, "lookahead set to %lf ns from the network "
+                "latencies\n", g_tw_lookahead);
+}
+
 int* model_net_configure(int *id_count){
     // first call the base LP configure, which sets up the general parameters
     model_net_base_configure();
@@ -107,6 +144,12 @@ int* model_net_configure(int *id_count){
         }
     }
 
+    int topology_lookahead = 0;
+    configuration_get_value_int(&config, "PARAMS", "topology_lookahead", NULL,
+            &topology_lookahead);
+    if (topology_lookahead)
+        model_net_set_topology_lookahead();
+
     // allocate the output
     int *ids = malloc(*id_count * sizeof(int));
     // read the ordering provided by modelnet_order
@@ -460,6 +503,148 @@ model_net_event_return model_net_event_mctx(
             sender);
 }
 
+/* start a new MN_BASE_NEW_MULTI event to src_mn_lp, with the templates in
+ * place and no destinations yet */
+static tw_event * model_net_multi_event_new(
+        int net_id,
+        tw_lpid src_mn_lp,
+        char const * category,
+        tw_stime offset,
+        int remote_event_size,
+        void const * remote_event,
+        int self_event_size,
+        void const * self_event,
+        int const * params_set,
+        tw_lp *sender)
+{
+    tw_stime poffset = codes_local_latency(sender);
+    if (mn_in_sequence){
+        tw_stime tmp = mn_msg_offset;
+        mn_msg_offset += poffset;
+        poffset += tmp;
+    }
+
+    tw_event *e = tw_event_new(src_mn_lp, poffset+offset, sender);
+
+    model_net_wrap_msg *m = tw_event_data(e);
+    msg_set_header(model_net_base_magic, MN_BASE_NEW_MULTI, sender->gid, &m->h);
+
+    // final_dest_lp, dest_mn_lp and msg_size come from the destination list
+    model_net_request *r = &m->msg.m_base.req;
+    r->src_lp = sender->gid;
+    r->is_pull = 0;
+    r->pull_size = 0;
+    r->net_id = net_id;
+    r->remote_event_size = remote_event_size;
+    r->self_event_size = self_event_size;
+    strncpy(r->category, category, CATEGORY_NAME_MAX-1);
+    r->category[CATEGORY_NAME_MAX-1]='\0';
+
+    if (params_set[MN_MSG_PARAM_START_TIME])
+        r->msg_start_time = start_time_param;
+    else
+        r->msg_start_time = tw_now(sender);
+
+    m->msg.m_base.is_from_remote = 0;
+    m->msg.m_base.isQueueReq = 1;
+    m->msg.m_base.num_dests = 0;
+
+    if (params_set[MN_MSG_PARAM_SCHED])
+        m->msg.m_base.sched_params = sched_params;
+    else
+        model_net_sched_set_default_params(&m->msg.m_base.sched_params);
+
+    void *e_msg = (m+1);
+    if (remote_event_size > 0){
+        memcpy(e_msg, remote_event, remote_event_size);
+        e_msg = (char*)e_msg + remote_event_size;
+    }
+    if (self_event_size > 0){
+        memcpy(e_msg, self_event, self_event_size);
+    }
+
+    return e;
+}
+
+model_net_event_return model_net_event_multi(
+        int net_id,
+        char const * category,
+        int num_dests,
+        tw_lpid const * final_dest_lps,
+        uint64_t const * message_sizes,
+        tw_stime offset,
+        int remote_event_size,
+        void const * remote_event,
+        int self_event_size,
+        void const * self_event,
+        tw_lp *sender)
+{
+    model_net_event_return num_rng_calls = 0;
+    size_t tmpl_size = remote_event_size + self_event_size;
+
+    if (sizeof(model_net_wrap_msg) + tmpl_size + sizeof(model_net_multi_dest)
+            > g_tw_msg_sz){
+        tw_error(TW_LOC, "Error: model_net trying to transmit a batched event "
+                         "of size %zd but ROSS is configured for events of "
+                         "size %zd\n",
+                         sizeof(model_net_wrap_msg) + tmpl_size +
+                         sizeof(model_net_multi_dest), g_tw_msg_sz);
+        return -1;
+    }
+    int dests_per_event = (g_tw_msg_sz - sizeof(model_net_wrap_msg) -
+            tmpl_size) / sizeof(model_net_multi_dest);
+
+    // the message params hold for the whole batch, but model_net_event_impl_base
+    // clears them on every call
+    int params_set[MAX_MN_MSG_PARAM_TYPES];
+    memcpy(params_set, is_msg_params_set, sizeof(params_set));
+
+    tw_lpid src_mn_lp = model_net_find_local_device_mctx(net_id,
+            CODES_MCTX_DEFAULT, sender->gid);
+
+    tw_event *e = NULL;
+    model_net_wrap_msg *m = NULL;
+    model_net_multi_dest *d = NULL;
+    for (int i = 0; i < num_dests; i++){
+        tw_lpid dest_mn_lp = model_net_find_local_device_mctx(net_id,
+                CODES_MCTX_DEFAULT, final_dest_lps[i]);
+
+        // node-local destinations keep the noop / node-copy shortcuts
+        if (dest_mn_lp == src_mn_lp){
+            memcpy(is_msg_params_set, params_set, sizeof(params_set));
+            num_rng_calls += model_net_event_impl_base(net_id,
+                    CODES_MCTX_DEFAULT, CODES_MCTX_DEFAULT, category,
+                    final_dest_lps[i], message_sizes[i], 0, offset,
+                    remote_event_size, remote_event, self_event_size,
+                    self_event, sender);
+            continue;
+        }
+
+        if (m == NULL || m->msg.m_base.num_dests == dests_per_event){
+            if (e != NULL)
+                tw_event_send(e);
+            e = model_net_multi_event_new(net_id, src_mn_lp, category, offset,
+                    remote_event_size, remote_event, self_event_size,
+                    self_event, params_set, sender);
+            num_rng_calls++;
+            m = tw_event_data(e);
+            d = (model_net_multi_dest*)((char*)(m+1) + tmpl_size);
+        }
+
+        model_net_multi_dest *dd = &d[m->msg.m_base.num_dests++];
+        dd->final_dest_lp = final_dest_lps[i];
+        dd->dest_mn_lp = dest_mn_lp;
+        dd->msg_size = message_sizes[i];
+    }
+    if (e != NULL)
+        tw_event_send(e);
+
+    memset(is_msg_params_set, 0,
+            MAX_MN_MSG_PARAM_TYPES*sizeof(*is_msg_params_set));
+
+    return num_rng_calls;
+}
+
 model_net_event_return model_net_pull_event(
         int net_id,
         char const *category,
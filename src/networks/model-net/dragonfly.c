@@ -254,7 +254,6 @@ struct terminal_state
 
    tw_stime * last_buf_full;
    tw_stime busy_time;
-   char output_buf[4096];
    /* For LP suspend functionality */
    int error_ct;
 
@@ -265,7 +264,6 @@ struct terminal_state
    tw_stime fin_chunks_time;
    tw_stime busy_time_sample;
 
-   char sample_buf[4096];
    struct dfly_cn_sample * sample_stat;
    int op_arr_size;
    int max_arr_size;
@@ -359,8 +357,6 @@ struct router_state
    int* prev_hist_num;
    int* cur_hist_num;
    
-   char output_buf[4096];
-   char output_buf2[4096];
 
    struct dfly_router_sample * rsamples;
    
@@ -720,6 +716,18 @@ static void dragonfly_read_config(const char * anno, dragonfly_param *params){
 
 }
 
+/* a dragonfly group is num_routers routers, kept on one PE with their compute
+ * nodes by PARAMS:pe_partition="group" */
+static void dragonfly_partition_hint(){
+    const config_anno_map_t *amap = codes_mapping_get_lp_anno_map(LP_CONFIG_NM_TERM);
+    const char *anno = (amap && !amap->has_unanno_lp && amap->num_annos) ?
+        amap->annotations[0].ptr : NULL;
+    int num_routers = 4;
+    configuration_get_value_int(&config, "PARAMS", "num_routers", anno,
+            &num_routers);
+    codes_mapping_add_partition_hint(LP_CONFIG_NM_ROUT, num_routers);
+}
+
 static void dragonfly_configure(){
     anno_map = codes_mapping_get_lp_anno_map(LP_CONFIG_NM_TERM);
     assert(anno_map);
@@ -2640,16 +2648,15 @@ dragonfly_terminal_final( terminal_state * s,
         fclose(fp);
     }
     
-    int written = 0;
     if(!s->terminal_id)
-        written = sprintf(s->output_buf, "# Format <LP id> <Terminal ID> <Total Data Size> <Aggregate packet latency> <# Flits/Packets finished> <Avg hops> <Busy Time>");
+        lp_io_fmt("# Format <LP id> <Terminal ID> <Total Data Size> <Aggregate packet latency> <# Flits/Packets finished> <Avg hops> <Busy Time>");
 
-    written += sprintf(s->output_buf + written, "\n %llu %u %"PRId64" %lf %ld %lf %lf",
+    lp_io_fmt("\n %llu %u %"PRId64" %lf %ld %lf %lf",
             LLU(lp->gid), s->terminal_id, s->total_msg_size, (double)s->total_time/s->finished_packets, 
             s->finished_packets, (double)s->total_hops/s->finished_chunks,
             s->busy_time);
 
-    lp_io_write(lp->gid, "dragonfly-msg-stats", written, s->output_buf); 
+    lp_io_fmt_write(lp->gid, "dragonfly-msg-stats"); 
     
     if(s->terminal_msgs[0] != NULL) 
       printf("[%llu] leftover terminal messages \n", LLU(lp->gid));
@@ -2689,7 +2696,6 @@ static void dragonfly_router_final(router_state * s,
     rc_stack_destroy(s->st);
     
     const dragonfly_param *p = s->params;
-    int written = 0;
     if(s->router_id == 0)
     {
         /* write metadata file */
@@ -2702,32 +2708,30 @@ static void dragonfly_router_final(router_state * s,
                 p->num_routers, p->num_global_channels);
         fclose(fp);
     }
-    written += sprintf(s->output_buf + written, "\n %llu %d %d", 
+    lp_io_fmt("\n %llu %d %d", 
             LLU(lp->gid),
             s->router_id / p->num_routers,
             s->router_id % p->num_routers);
     for(int d = 0; d < p->num_routers + p->num_global_channels; d++) 
-        written += sprintf(s->output_buf + written, " %lf", s->busy_time[d]);
+        lp_io_fmt(" %lf", s->busy_time[d]);
 
-    lp_io_write(lp->gid, "dragonfly-router-stats", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "dragonfly-router-stats");
 
-    written = 0;
     if(!s->router_id)
     {
-        written = sprintf(s->output_buf2, "# Format <LP ID> <Group ID> <Router ID> <Link traffic per router port(s)>");
-        written += sprintf(s->output_buf2 + written, "# Router ports in the order: %d local channels, %d global channels",
+        lp_io_fmt("# Format <LP ID> <Group ID> <Router ID> <Link traffic per router port(s)>");
+        lp_io_fmt("# Router ports in the order: %d local channels, %d global channels",
             p->num_routers, p->num_global_channels);
     }
-    written += sprintf(s->output_buf2 + written, "\n %llu %d %d",
+    lp_io_fmt("\n %llu %d %d",
         LLU(lp->gid),
         s->router_id / p->num_routers,
         s->router_id % p->num_routers);
 
     for(int d = 0; d < p->num_routers + p->num_global_channels; d++) 
-        written += sprintf(s->output_buf2 + written, " %lld", LLD(s->link_traffic[d]));
+        lp_io_fmt(" %lld", LLD(s->link_traffic[d]));
 
-    assert(written < 4096);
-    lp_io_write(lp->gid, "dragonfly-router-traffic", written, s->output_buf2);
+    lp_io_fmt_write(lp->gid, "dragonfly-router-traffic");
 }
 
 /* Get the number of hops for this particular path source and destination groups */
@@ -3717,6 +3721,7 @@ struct model_net_method dragonfly_method =
     .mn_sample_fini_fn = (void*)dragonfly_sample_fin,
     .mn_model_stat_register = dragonfly_register_model_types,
     .mn_get_model_stat_types = dragonfly_get_model_types,
+    .mn_partition_hint = dragonfly_partition_hint,
 };
 
 struct model_net_method dragonfly_router_method =
@@ -7,6 +7,8 @@
 #include "codes/model-net-method.h"
 #include "codes/model-net-lp.h"
 #include "codes/net/fattree.h"
+#include "codes/net/net-faults.h"
+#include "codes/net/net-jobs.h"
 #include "sys/file.h"
 #include "codes/quickhash.h"
 #include "codes/rc-stack.h"
@@ -90,6 +92,8 @@ enum ROUTING_ALGO
 {
     STATIC=1,
     ADAPTIVE,
+    DMODK,
+    ECMP,
 };
 
 enum RAIL_SELECTION_ALGO
@@ -158,6 +162,9 @@ struct fattree_param
   double router_delay;
   double soft_delay;
   int routing;
+  /* D-mod-K routing: up port index per destination terminal for each level
+   * below the top one, shared by all switches of the process */
+  uint16_t **dmodk_up;
   int rail_select;
   int rail_size_limit;
   int num_rails;
@@ -168,6 +175,10 @@ struct fattree_param
   size_t num_vcs; /* number of virtual channels */
   int * qos_table;
 
+  /* failure schedule */
+  int num_faults;
+  struct net_fault *faults;
+
 };
 
 struct ftree_hash_key
@@ -231,8 +242,6 @@ struct ft_terminal_state
 
   tw_stime *last_buf_full;
   tw_stime *busy_time;
-  char output_buf[4096];
-  char output_buf3[4096];
 
   /* For sampling */
   long fin_chunks_sample;
@@ -253,6 +262,7 @@ enum event_t
   S_SEND,
   S_ARRIVE,
   S_BUFFER,
+  S_FAULT,
 };
 
 enum last_hop
@@ -291,9 +301,10 @@ struct switch_state
   int** vc_occupancy;
   int64_t* link_traffic;
   tw_lpid *port_connections;
+  int *port_switch; /* switch ID behind each port, -1 for terminals */
+  char *port_up;
+  int faults_applied; /* entries of the failure schedule in force */
 
-  char output_buf[4096];
-  char output_buf2[4096];
 
   struct rc_stack * st;
 
@@ -356,6 +367,8 @@ static tw_stime         fattree_max_latency = 0;
 
 static long long       total_hops = 0;
 static long long       N_finished_packets = 0;
+/* per-job packet latencies, for the slowdown report */
+static struct net_jobs jobs;
 static long long       total_msg_sz = 0;
 static long long       N_finished_msgs = 0;
 static long long       N_finished_chunks = 0;
@@ -743,6 +756,36 @@ void post_switch_init(switch_state *s, tw_lp *lp)
 }
 
 
+/* Builds the D-mod-K forwarding tables. A switch at level l sends a packet
+ * for terminal d up through port (d / (u_0 * ... * u_{l-1})) mod u_l of its
+ * u_l up ports, so that the destinations sharing a port at one level are
+ * spread over the ports of the next one. Packets only climb until they reach
+ * a switch above the destination and then go down, i.e. the tables are an
+ * up*\/down* routing. The up port count is the same for all switches of a
+ * level, so one table per level serves every switch. */
+static void fattree_build_dmodk(fattree_param *p)
+{
+  int num_up[2];
+  int stride = 1;
+
+  if(p->num_levels < 2)
+    return;
+
+  /* up ports of a switch, as connected by switch_init */
+  num_up[0] = (p->num_levels == 2) ? 2 * p->num_switches[1] : p->l1_set_size;
+  num_up[1] = p->Ns;
+
+  p->dmodk_up = malloc((p->num_levels - 1) * sizeof(*p->dmodk_up));
+  for(int l = 0; l < p->num_levels - 1; l++) {
+    if(num_up[l] > UINT16_MAX)
+      tw_error(TW_LOC, "Too many up ports (%d) for D-mod-K routing", num_up[l]);
+    p->dmodk_up[l] = malloc(p->num_terminals * sizeof(**p->dmodk_up));
+    for(int d = 0; d < p->num_terminals; d++)
+      p->dmodk_up[l][d] = (d / stride) % num_up[l];
+    stride *= num_up[l];
+  }
+}
+
 static void fattree_read_config(const char * anno, fattree_param *p){
   uint32_t h1 = 0, h2 = 0;
   bj_hashlittle2(LP_METHOD_NM, strlen(LP_METHOD_NM), &h1, &h2);
@@ -949,6 +992,10 @@ static void fattree_read_config(const char * anno, fattree_param *p){
     p->routing = STATIC;
   else if(strcmp(routing_str, "adaptive")==0)
     p->routing = ADAPTIVE;
+  else if(strcmp(routing_str, "dmodk")==0)
+    p->routing = DMODK;
+  else if(strcmp(routing_str, "ecmp")==0)
+    p->routing = ECMP;
   else
   {
     p->routing = ADAPTIVE;
@@ -1017,6 +1064,54 @@ static void fattree_read_config(const char * anno, fattree_param *p){
   p->cn_delay = (1.0 / p->cn_bandwidth);
   p->head_delay = (1.0 / p->link_bandwidth);
   p->credit_delay = (1.0 / p->link_bandwidth) * 8; //assume 8 bytes packet
+
+  /* links or switches that go down and up during the run, by the switch IDs
+   * of a rail: level 0 switches first, then levels 1 and 2 */
+  char failure_file[MAX_NAME_LENGTH];
+  failure_file[0] = '\0';
+  configuration_get_value_relpath(&config, "PARAMS", "failure_file", anno,
+      failure_file, MAX_NAME_LENGTH);
+  p->num_faults = 0;
+  p->faults = NULL;
+  if(failure_file[0] != '\0') {
+    int total_switches = 0;
+    for(i = 0; i < p->num_levels; i++)
+      total_switches += p->num_switches[i];
+    p->num_faults = net_read_faults(failure_file, total_switches, &p->faults);
+    for(i = 0; i < p->num_faults; i++) {
+      if(p->faults[i].action == FAULT_BANDWIDTH)
+        tw_error(TW_LOC, "%s: fattree links only go down or up, not to "
+            "another bandwidth\n", failure_file);
+    }
+    if(!g_tw_mynode) printf("FT failure schedule %s: %d entries\n",
+        failure_file, p->num_faults);
+  }
+
+  p->dmodk_up = NULL;
+  if(p->routing == DMODK)
+    fattree_build_dmodk(p);
+}
+
+/* with three levels, the switch_radix/2 repetitions holding the L0 and L1
+ * switches of a pod are kept on one PE by PARAMS:pe_partition="group" */
+static void fattree_partition_hint(){
+  const config_anno_map_t *amap = codes_mapping_get_lp_anno_map(LP_CONFIG_NM);
+  const char *anno = (amap && !amap->has_unanno_lp && amap->num_annos) ?
+    amap->annotations[0].ptr : NULL;
+  int num_levels = 0, radix = 0;
+  char switch_radix_str[MAX_NAME_LENGTH];
+
+  configuration_get_value_int(&config, "PARAMS", "num_levels", anno,
+      &num_levels);
+  if(num_levels != 3)
+    return;
+  if(configuration_get_value(&config, "PARAMS", "switch_radix", anno,
+        switch_radix_str, MAX_NAME_LENGTH) <= 0)
+    return;
+  sscanf(switch_radix_str, "%d", &radix);
+  /* one switch per level in every repetition */
+  if(radix >= 2)
+    codes_mapping_add_partition_hint("fattree_switch", (radix/2) * num_levels);
 }
 
 static void fattree_configure(){
@@ -1032,6 +1127,7 @@ static void fattree_configure(){
   if (anno_map->has_unanno_lp > 0){
     fattree_read_config(NULL, &all_params[anno_map->num_annos]);
   }
+  net_jobs_init(&jobs, all_params[0].num_faults > 0);
 #ifdef ENABLE_CORTEX
   model_net_topology = fattree_cortex_topology;
 #endif
@@ -1200,6 +1296,9 @@ void switch_init(switch_state * r, tw_lp * lp)
   r->in_send_loop = (int*) malloc (r->radix * sizeof(int));
   r->link_traffic = (int64_t*) malloc (r->radix * sizeof(int64_t));
   r->port_connections = (tw_lpid*) malloc (r->radix * sizeof(tw_lpid));
+  r->port_switch = (int*) malloc (r->radix * sizeof(int));
+  r->port_up = (char*) malloc (r->radix * sizeof(char));
+  r->faults_applied = 0;
 
   r->pending_msgs =
     (fattree_message_list***)malloc(r->radix * sizeof(fattree_message_list**));
@@ -1250,6 +1349,8 @@ void switch_init(switch_state * r, tw_lp * lp)
     r->queued_length[i] = 0;
     r->qos_table_index[i] = 0;
     r->qos_table_counter[i] = 0;
+    r->port_switch[i] = -1;
+    r->port_up[i] = 1;
   }
 
   /* dump partial topology info into DOT format (switch radix, guid, ...) */
@@ -1259,8 +1360,6 @@ void switch_init(switch_state * r, tw_lp * lp)
 
 #if FATTREE_CONNECTIONS || FATTREE_DEBUG
     tw_lpid next_switch_lid;
-	int written = 0;
-    int written_2 = 0;
 #endif
 
   //set lps connected to each port
@@ -1290,7 +1389,7 @@ void switch_init(switch_state * r, tw_lp * lp)
           rep, off, &nextTerm);
       r->port_connections[r->num_cons++] = nextTerm;
 #if FATTREE_CONNECTIONS
-	    written += sprintf(r->output_buf + written, "%u, %llu, ", r->switch_id+p->num_terminals,LLU(codes_mapping_get_lp_relative_id(nextTerm,0,0)/term_rails));
+	    lp_io_fmt("%u, %llu, ", r->switch_id+p->num_terminals,LLU(codes_mapping_get_lp_relative_id(nextTerm,0,0)/term_rails));
 #endif
       r->num_lcons++;
 #if FATTREE_DEBUG
@@ -1322,12 +1421,13 @@ void switch_init(switch_state * r, tw_lp * lp)
       codes_mapping_get_lp_id(lp_group_name, "fattree_switch", NULL, 1,
           l1_base, 1 + r->rail_id * p->num_levels, &nextTerm);
       for(int con = 0; con < r->con_per_uneigh; con++) {
+        r->port_switch[r->num_cons] = p->num_switches[0] + l1_base;
         r->port_connections[r->num_cons++] = nextTerm;
 #if FATTREE_CONNECTIONS
         codes_mapping_get_lp_info(nextTerm, lp_group_name, &mapping_grp_id, NULL,
             &mapping_type_id, anno, &mapping_rep_id, &mapping_offset);
         next_switch_lid = mapping_rep_id +  p->num_switches[0];
-	      written += sprintf(r->output_buf + written, "%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
+	      lp_io_fmt("%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
 #endif
 #if FATTREE_DEBUG
     printf("L0->L1 I am switch %d, connect to upper switch %d L1 (%llu) rel_id:%llu at port %d, rail id %d yes collecting\n",
@@ -1360,12 +1460,13 @@ void switch_init(switch_state * r, tw_lp * lp)
       codes_mapping_get_lp_id(def_group_name, "fattree_switch", NULL, 1,
           l0_base, 0 + r->rail_id * p->num_levels, &nextTerm);
       for(int con = 0; con < r->con_per_lneigh; con++) {
+        r->port_switch[r->num_cons] = l0_base;
         r->port_connections[r->num_cons++] = nextTerm;
 #if FATTREE_CONNECTIONS
         codes_mapping_get_lp_info(nextTerm, lp_group_name, &mapping_grp_id, NULL,
             &mapping_type_id, anno, &mapping_rep_id, &mapping_offset);
         next_switch_lid = mapping_rep_id;
-        written_2 += sprintf(r->output_buf2 + written_2, "%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
+        lp_io_fmt("%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
 #endif
         r->num_lcons++;
 #if FATTREE_DEBUG
@@ -1380,6 +1481,10 @@ void switch_init(switch_state * r, tw_lp * lp)
       }
       l0_base++;
     }
+#if FATTREE_CONNECTIONS
+    /* down links are complete, the up links follow */
+    lp_io_fmt_write(lp->gid, "fattree-config-down-connections");
+#endif
     if(p->num_levels == 3) {
       int rep = p->link_repetitions;
       int l2 = ((r->switch_id - p->num_switches[0]) % p->l1_set_size)/rep * p->Ns;
@@ -1390,12 +1495,14 @@ void switch_init(switch_state * r, tw_lp * lp)
         codes_mapping_get_lp_id(lp_group_name, "fattree_switch", NULL, 1,
             l2 + off, 2 + r->rail_id * p->num_levels, &nextTerm);
         for(int con = 0; con < r->con_per_uneigh; con++) {
+          r->port_switch[r->num_cons] = p->num_switches[0] + p->num_switches[1]
+            + l2 + off;
           r->port_connections[r->num_cons++] = nextTerm;
 #if FATTREE_CONNECTIONS
           codes_mapping_get_lp_info(nextTerm, lp_group_name, &mapping_grp_id, NULL,
               &mapping_type_id, anno, &mapping_rep_id, &mapping_offset);
           next_switch_lid = mapping_rep_id +  p->num_switches[0] + p->num_switches[1];
-          written += sprintf(r->output_buf + written, "%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
+          lp_io_fmt("%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
 #endif
 #if FATTREE_DEBUG
           printf("L1->L2:t=0 I am switch %d, connect to upper switch %d L2 (%llu) rel_id:%llu at port %d, rail id %d yes collecting\n",
@@ -1420,12 +1527,13 @@ void switch_init(switch_state * r, tw_lp * lp)
         codes_mapping_get_lp_id(lp_group_name, "fattree_switch", NULL, 1,
             l1 + off, 1 + r->rail_id * p->num_levels, &nextTerm);
         for(int con = 0; con < r->con_per_lneigh; con++) {
+          r->port_switch[r->num_cons] = p->num_switches[0] + l1 + off;
           r->port_connections[r->num_cons++] = nextTerm;
 #if FATTREE_CONNECTIONS
           codes_mapping_get_lp_info(nextTerm, lp_group_name, &mapping_grp_id, NULL,
               &mapping_type_id, anno, &mapping_rep_id, &mapping_offset);
           next_switch_lid = mapping_rep_id + p->num_switches[0];
-          written_2 += sprintf(r->output_buf2 + written_2, "%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
+          lp_io_fmt("%u, %llu, ", r->switch_id+p->num_terminals,LLU(next_switch_lid)+p->num_terminals);
 #endif
           r->num_lcons++;
 #if FATTREE_DEBUG
@@ -1447,9 +1555,36 @@ void switch_init(switch_state * r, tw_lp * lp)
     fflush(dot_file);
 
 #if FATTREE_CONNECTIONS
-  lp_io_write(lp->gid, "fattree-config-up-connections", written, r->output_buf);
-  lp_io_write(lp->gid, "fattree-config-down-connections", written_2, r->output_buf2);
+  /* level 0 switches only have up links and the top level only down links;
+   * level 1 wrote its down links above */
+  if(r->switch_level == 0) {
+    lp_io_fmt_write(lp->gid, "fattree-config-up-connections");
+    lp_io_fmt_write(lp->gid, "fattree-config-down-connections");
+  } else if(r->switch_level == 1) {
+    lp_io_fmt_write(lp->gid, "fattree-config-up-connections");
+  } else {
+    lp_io_fmt_write(lp->gid, "fattree-config-down-connections");
+    lp_io_fmt_write(lp->gid, "fattree-config-up-connections");
+  }
 #endif
+
+  /* the failure schedule is applied by events to self. Every switch follows
+   * all of it, as it routes around failures further down the tree. */
+  for(int k = 0; k < p->num_faults; k++) {
+    const struct net_fault *f = &p->faults[k];
+    int linked = 0;
+    for(int port = 0; port < r->num_cons; port++)
+      linked |= r->port_switch[port] >= 0 && r->port_switch[port] == f->b;
+    if(f->target == FAULT_LINK && f->a == (int)r->switch_id && !linked)
+      tw_error(TW_LOC, "failure schedule: no link between switches %d and %d\n",
+          f->a, f->b);
+    tw_event *e = tw_event_new(lp->gid, g_tw_lookahead + f->time, lp);
+    fattree_message *m = tw_event_data(e);
+    m->type = S_FAULT;
+    m->magic = switch_magic_num;
+    m->fault_id = k;
+    tw_event_send(e);
+  }
   return;
 }
 
@@ -1571,6 +1706,9 @@ static void fattree_report_stats()
 	fclose(fattree_results_log);
 #endif
   }
+
+  /* per-job slowdown: summed packet latency over summed zero-load latency */
+  net_jobs_report(&jobs);
 }
 
 /* fattree packet event */
@@ -1972,7 +2110,7 @@ void switch_packet_receive_rc(switch_state * s,
   printf("%d: %f switch recv reverse packet %llu switch %d port %d SL %d src %d dest %d\n", getRank(), tw_now(lp), msg->packet_ID, s->switch_id, output_port, use_vc, codes_mapping_get_lp_relative_id(msg->src_terminal_id, 0, 0), codes_mapping_get_lp_relative_id(msg->dest_terminal_id, 0, 0));
   fflush(stdout);
 #endif
-    if(s->params->routing != STATIC) {
+    if(s->params->routing == ADAPTIVE) {
       tw_rand_reverse_unif(lp->rng);
     }
     if(bf->c1)
@@ -2096,6 +2234,10 @@ void switch_packet_send_rc(switch_state * s,
 #endif
     int output_port = msg->saved_vc;
     int use_vc = msg->service_level;
+    if (s->params->use_qos) {
+      s->qos_table_index[output_port] = msg->qos_table_index;
+      s->qos_table_counter[output_port] = msg->qos_table_counter;
+    }
     if(bf->c1) 
     {
         s->in_send_loop[output_port] = 1;
@@ -2132,12 +2274,6 @@ void switch_packet_send_rc(switch_state * s,
     {
       s->in_send_loop[output_port] = 1;
     }
-
-    if (s->params->use_qos) {
-      s->qos_table_index[output_port] = msg->qos_table_index;
-      s->qos_table_counter[output_port] = msg->qos_table_counter;
-    }
-
 }
 
 static int switch_queue_has_packets_all_sls(fattree_message_list ** pending_msgs, size_t num_sls) {
@@ -2183,7 +2319,8 @@ void switch_packet_send( switch_state * s, tw_bf * bf, fattree_message * msg,
   msg->saved_vc = output_port;
   msg->service_level = use_vc;
 
-  if(cur_entry == NULL) {
+  /* a port that is down holds its chunks until it comes back up */
+  if(cur_entry == NULL || !s->port_up[output_port]) {
     bf->c1 = 1;
     s->in_send_loop[output_port] = 0;
     return;
@@ -2542,6 +2679,35 @@ void ft_send_remote_event(ft_terminal_state * s, fattree_message * msg, tw_lp *
     return;
 }
 
+/* node of the terminal that sent msg */
+static int ft_src_terminal(ft_terminal_state *s, fattree_message *msg)
+{
+  int src = codes_mapping_get_lp_relative_id(msg->src_terminal_id, 0, 0);
+  if(s->params->ft_type == 2)
+    src /= s->params->num_rails;
+  return src;
+}
+
+/* zero-load latency of a packet from terminal src to terminal dest: its
+ * serialization at injection, the delay of every switch on a minimal path,
+ * and the serialization of one chunk on each link after the first */
+static double ft_packet_ideal_time(const fattree_param *p, int src, int dest,
+    uint64_t packet_size)
+{
+  int src_switch = src / p->l0_term_size;
+  int dest_switch = dest / p->l0_term_size;
+  int switches = 1;
+  if(src_switch != dest_switch) {
+    switches = 3;
+    if(p->num_levels == 3 &&
+        src_switch / p->l0_set_size != dest_switch / p->l0_set_size)
+      switches = 5;
+  }
+  return packet_size * p->cn_delay + switches * p->router_delay +
+    (switches - 1) * p->chunk_size * p->head_delay +
+    p->chunk_size * p->cn_delay;
+}
+
 void ft_packet_arrive_rc(ft_terminal_state * s, tw_bf * bf, fattree_message * msg, tw_lp * lp)
 {
 #if DEBUG_RC
@@ -2593,6 +2759,11 @@ void ft_packet_arrive_rc(ft_terminal_state * s, tw_bf * bf, fattree_message * ms
       s->finished_packets--;
       stat->recv_count--;
       stat->recv_bytes -= msg->packet_size;
+      if(jobs.enabled)
+        net_jobs_packet_rc(&jobs, ft_src_terminal(s, msg),
+            tw_now(lp) - msg->travel_start_time,
+            ft_packet_ideal_time(s->params, ft_src_terminal(s, msg),
+              s->terminal_id, msg->packet_size));
     }
 
     if(bf->c3)
@@ -2783,6 +2954,11 @@ void ft_packet_arrive(ft_terminal_state * s, tw_bf * bf, fattree_message * msg,
 
         N_finished_packets++;
         s->finished_packets++;
+        if(jobs.enabled)
+          net_jobs_packet(&jobs, ft_src_terminal(s, msg),
+              tw_now(lp) - msg->travel_start_time,
+              ft_packet_ideal_time(s->params, ft_src_terminal(s, msg),
+                s->terminal_id, msg->packet_size));
     }
     // If it's the main chunk of the packet then handle the remote event data
     if(msg->remote_event_size_bytes > 0 && !tmp->remote_event_data)
@@ -2834,6 +3010,94 @@ void ft_packet_arrive(ft_terminal_state * s, tw_bf * bf, fattree_message * msg,
   return;
 }
 
+/* ECMP: all packets of a flow (source and destination terminal) take the same
+ * port. The hash is salted with the switch ID, as real switches seed their
+ * hash functions differently to avoid polarization. */
+static uint32_t ft_flow_hash(switch_state *s, fattree_message *msg,
+    int dest_term_local_id)
+{
+  uint32_t key[3];
+  uint32_t h1 = 0, h2 = 0;
+
+  key[0] = msg->src_terminal_id;
+  key[1] = dest_term_local_id;
+  key[2] = s->switch_id;
+  bj_hashlittle2(key, sizeof(key), &h1, &h2);
+  return h1;
+}
+
+/* whether the links between switches u and v are up */
+static int ft_link_up(switch_state *s, int u, int v)
+{
+  return !net_link_down(s->params->faults, s->faults_applied, u, v);
+}
+
+/* whether level 1 switch u reaches level 0 switch d going down */
+static int ft_l1_reaches(switch_state *s, int u, int d)
+{
+  fattree_param *p = s->params;
+  if(p->num_levels == 3 &&
+      (u - p->num_switches[0]) / p->l1_set_size != d / p->l0_set_size)
+    return 0;
+  return ft_link_up(s, u, d);
+}
+
+/* whether level 2 switch w reaches level 0 switch d going down, through one
+ * of its level 1 switches in the pod of d */
+static int ft_l2_reaches(switch_state *s, int w, int d)
+{
+  fattree_param *p = s->params;
+  int rep = p->link_repetitions;
+  int l1 = p->num_switches[0] + (d / p->l0_set_size) * p->l1_set_size +
+    (w - p->num_switches[0] - p->num_switches[1]) / p->Ns * rep;
+  for(int off = 0; off < rep; off++) {
+    if(ft_link_up(s, w, l1 + off) && ft_l1_reaches(s, l1 + off, d))
+      return 1;
+  }
+  return 0;
+}
+
+/* whether the switch behind port still reaches level 0 switch d. From level
+ * 0, the level 1 switch may also go up to the top level to get there. */
+static int ft_port_reaches(switch_state *s, int port, int d)
+{
+  fattree_param *p = s->params;
+  if(!p->num_faults)
+    return 1;
+  if(!s->port_up[port])
+    return 0;
+  int v = s->port_switch[port];
+  if(v < p->num_switches[0])
+    return v == d;
+  if(v >= p->num_switches[0] + p->num_switches[1])
+    return ft_l2_reaches(s, v, d);
+  if(ft_l1_reaches(s, v, d))
+    return 1;
+  if(s->switch_level == 0 && p->num_levels == 3) {
+    int l2 = p->num_switches[0] + p->num_switches[1] +
+      (v - p->num_switches[0]) % p->l1_set_size / p->link_repetitions * p->Ns;
+    for(int off = 0; off < p->Ns; off++) {
+      if(ft_link_up(s, v, l2 + off) && ft_l2_reaches(s, l2 + off, d))
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/* the first port among start_port..end_port-1 that still reaches level 0
+ * switch d, looking from port on and wrapping around; -1 if there is none */
+static int ft_reaching_port(switch_state *s, int port, int start_port,
+    int end_port, int d)
+{
+  int num_ports = end_port - start_port;
+  for(int i = 0; i < num_ports; i++) {
+    int cand = start_port + (port - start_port + i) % num_ports;
+    if(ft_port_reaches(s, cand, d))
+      return cand;
+  }
+  return -1;
+}
+
 /* gets the output port corresponding to the next stop of the message */
 /* expects dest_terminal_id to be a local ID not global ID */
 int ft_get_output_port( switch_state * s, tw_bf * bf, fattree_message * msg,
@@ -2859,7 +3123,9 @@ int ft_get_output_port( switch_state * s, tw_bf * bf, fattree_message * msg,
     assert(outport >= 0);
     return outport;
   }
-  /* or we just do some adaptive routing instead */
+  /* or we pick one of the minimal ports, adaptively or by D-mod-K / ECMP */
+  int going_up = 0;
+  int dest_switch_id = dest_term_local_id / p->l0_term_size;
 
   if(s->switch_level == 0) {
     //message for a terminal node
@@ -2870,9 +3136,9 @@ int ft_get_output_port( switch_state * s, tw_bf * bf, fattree_message * msg,
     } else { //go up the least congested path
       start_port = s->num_lcons;
       end_port = s->num_cons;
+      going_up = 1;
     }
   } else if(s->switch_level == 1) {
-    int dest_switch_id = dest_term_local_id / p->l0_term_size;
     //if only two level or packet going down, send to the right switch
     if(p->num_levels == 2 || (dest_switch_id >= s->start_lneigh &&
       dest_switch_id < s->end_lneigh)) {
@@ -2881,6 +3147,7 @@ int ft_get_output_port( switch_state * s, tw_bf * bf, fattree_message * msg,
     } else {
       start_port = s->num_lcons;
       end_port = s->num_cons;
+      going_up = 1;
     }
   } else { //switch level 2
     int dest_l1_group = dest_term_local_id / p->l1_term_size;
@@ -2890,20 +3157,57 @@ int ft_get_output_port( switch_state * s, tw_bf * bf, fattree_message * msg,
 
   assert(end_port > start_port);
 
+  /* the link down to the destination's switch failed: detour over a top
+   * level switch that still reaches it */
+  if(s->switch_level == 1 && !going_up && s->num_cons > s->num_lcons &&
+      ft_reaching_port(s, start_port, start_port, end_port, dest_switch_id) < 0) {
+    start_port = s->num_lcons;
+    end_port = s->num_cons;
+    going_up = 1;
+  }
+
+  /* ports whose switch no longer reaches the destination pass their packets
+   * on to the next port that does; with none left, the packets wait at the
+   * minimal port */
+  int reaching;
+  if(s->params->routing == DMODK) {
+    /* up ports come from the level's table, parallel links down to the
+     * same switch are picked by destination modulo their count */
+    if(going_up) {
+      outport = start_port + p->dmodk_up[s->switch_level][dest_term_local_id];
+      assert(outport < end_port);
+    } else {
+      outport = start_port + dest_term_local_id % (end_port - start_port);
+    }
+    reaching = ft_reaching_port(s, outport, start_port, end_port, dest_switch_id);
+    if(reaching >= 0)
+      outport = reaching;
+  } else if(s->params->routing == ECMP) {
+    outport = start_port + ft_flow_hash(s, msg, dest_term_local_id) %
+      (end_port - start_port);
+    reaching = ft_reaching_port(s, outport, start_port, end_port, dest_switch_id);
+    if(reaching >= 0)
+      outport = reaching;
+  } else {
   //outport = start_port;
-  // when occupancy is same, just choose random port
+  // when occupancy is same, just choose random port among the reaching ones
   outport = tw_rand_integer(lp->rng, start_port, end_port-1);  
+  reaching = ft_reaching_port(s, outport, start_port, end_port, dest_switch_id);
+  if(reaching >= 0)
+    outport = reaching;
   int load = s->vc_occupancy[outport][use_vc] + s->queued_length[outport];
   if(load != 0) {
     //for(int port = start_port + 1; port < end_port; port++) {
     for(int port = start_port; port < end_port; port++) {
-      if(s->vc_occupancy[port][use_vc] + s->queued_length[port] < load) {
+      if(s->vc_occupancy[port][use_vc] + s->queued_length[port] < load &&
+          ft_port_reaches(s, port, dest_switch_id)) {
         load = s->vc_occupancy[port][use_vc] +  s->queued_length[port];
         outport = port;
         if(load <= 0) break;
       }
     }
   }
+  }
   assert(outport != -1);
   if(outport < s->num_lcons) {
     *out_off = outport % s->con_per_lneigh;
@@ -2961,16 +3265,15 @@ void fattree_terminal_final( ft_terminal_state * s, tw_lp * lp )
     if(dump_topo) return;
     model_net_print_stats(lp->gid, s->fattree_stats_array);
 
-    int written = 0;
     if(!s->terminal_id && !s->rail_id)
-        written = sprintf(s->output_buf, "# Format <LP id> <Terminal ID> <Rail ID> <Total Data Size> <Avg packet latency> <# Flits/Packets finished> <Avg hops> <Busy Time>\n");
+        lp_io_fmt("# Format <LP id> <Terminal ID> <Rail ID> <Total Data Size> <Avg packet latency> <# Flits/Packets finished> <Avg hops> <Busy Time>\n");
 
-    written += sprintf(s->output_buf + written, "%llu %u %u %llu %lf %ld %lf %lf\n",
+    lp_io_fmt("%llu %u %u %llu %lf %ld %lf %lf\n",
             LLU(lp->gid), s->terminal_id, s->rail_id, LLU(s->total_msg_size), s->total_time,
             s->finished_packets, (double)s->total_hops/s->finished_chunks,
             s->busy_time[0]);
 
-    lp_io_write(lp->gid, "fattree-msg-stats", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "fattree-msg-stats");
 
     if(s->terminal_msgs[0] != NULL)
       printf("[%llu] leftover terminal messages \n", LLU(lp->gid));
@@ -3047,37 +3350,89 @@ void fattree_switch_final(switch_state * s, tw_lp * lp)
       }
 
     rc_stack_destroy(s->st);
+    free(s->port_switch);
+    free(s->port_up);
 
 //    const fattree_param *p = s->params;
-    int written = 0;
     if(!s->switch_id && !s->rail_id)
     {
-        written = sprintf(s->output_buf, "# Format <LP ID> <Rail ID> <Level ID> <Switch ID> <Busy time per switch port(s)>");
-        written += sprintf(s->output_buf + written, "# Switch ports: %d\n",
+        lp_io_fmt("# Format <LP ID> <Rail ID> <Level ID> <Switch ID> <Busy time per switch port(s)>");
+        lp_io_fmt("# Switch ports: %d\n",
                 s->radix);
     }
-    written += sprintf(s->output_buf + written, "\n %llu %d %d %d",
+    lp_io_fmt("\n %llu %d %d %d",
             LLU(lp->gid),s->rail_id,s->switch_level,s->switch_id);
     for(int d = 0; d < s->radix; d++)
-        written += sprintf(s->output_buf + written, " %lf", s->busy_time[d]);
+        lp_io_fmt(" %lf", s->busy_time[d]);
 
-    lp_io_write(lp->gid, "fattree-switch-stats", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "fattree-switch-stats");
 
-    written = 0;
     if(!s->switch_id && !s->rail_id)
     {
-        written = sprintf(s->output_buf2, "# Format <LP ID> <Rail ID> <Level ID> <Switch ID> <Link traffic per switch port(s)>");
-        written += sprintf(s->output_buf2 + written, "# Switch ports: %d",
+        lp_io_fmt("# Format <LP ID> <Rail ID> <Level ID> <Switch ID> <Link traffic per switch port(s)>");
+        lp_io_fmt("# Switch ports: %d",
             s->radix);
     }
-    written += sprintf(s->output_buf2 + written, "\n %llu %d %d %d",
+    lp_io_fmt("\n %llu %d %d %d",
         LLU(lp->gid),s->rail_id,s->switch_level,s->switch_id);
 
     for(int d = 0; d < s->radix; d++)
-        written += sprintf(s->output_buf2 + written, " %lld", LLD(s->link_traffic[d]));
+        lp_io_fmt(" %lld", LLD(s->link_traffic[d]));
 
-    assert(written < 4096);
-    lp_io_write(lp->gid, "fattree-switch-traffic", written, s->output_buf2);
+    lp_io_fmt_write(lp->gid, "fattree-switch-traffic");
+}
+
+static void switch_apply_faults(switch_state * s, int n)
+{
+  for(int port = 0; port < s->num_cons; port++) {
+    if(s->port_switch[port] >= 0)
+      s->port_up[port] = !net_link_down(s->params->faults, n, s->switch_id,
+          s->port_switch[port]);
+  }
+}
+
+/* applies an entry of the failure schedule. Entries with the same time come
+ * in any order, so the switch only ever moves forward in the schedule. */
+static void switch_fault(switch_state * s, tw_bf * bf, fattree_message * msg,
+    tw_lp * lp)
+{
+  (void)bf;
+  msg->saved_faults_applied = s->faults_applied;
+  if(msg->fault_id + 1 > s->faults_applied)
+    s->faults_applied = msg->fault_id + 1;
+  switch_apply_faults(s, s->faults_applied);
+
+  /* ports that came back up resume sending the chunks held on them */
+  int *restarted = malloc((s->radix + 1) * sizeof(int));
+  restarted[0] = 0;
+  for(int port = 0; port < s->num_cons; port++) {
+    if(!s->port_up[port] || s->in_send_loop[port] ||
+        !switch_queue_has_packets_all_sls(s->pending_msgs[port], s->params->num_vcs))
+      continue;
+    tw_event *e = tw_event_new(lp->gid, codes_local_latency(lp), lp);
+    fattree_message *m = tw_event_data(e);
+    m->type = S_SEND;
+    m->vc_index = port;
+    m->magic = switch_magic_num;
+    tw_event_send(e);
+    s->in_send_loop[port] = 1;
+    restarted[++restarted[0]] = port;
+  }
+  rc_stack_push(lp, restarted, free, s->st);
+}
+
+static void switch_fault_rc(switch_state * s, tw_bf * bf, fattree_message * msg,
+    tw_lp * lp)
+{
+  (void)bf;
+  int *restarted = rc_stack_pop(s->st);
+  for(int i = 1; i <= restarted[0]; i++) {
+    codes_local_latency_reverse(lp);
+    s->in_send_loop[restarted[i]] = 0;
+  }
+  free(restarted);
+  s->faults_applied = msg->saved_faults_applied;
+  switch_apply_faults(s, s->faults_applied);
 }
 
 /* Update the buffer space associated with this switch LP */
@@ -3110,6 +3465,10 @@ void switch_event(switch_state * s, tw_bf * bf, fattree_message * msg,
       switch_buf_update(s, bf, msg, lp);
       break;
 
+    case S_FAULT:
+      switch_fault(s, bf, msg, lp);
+      break;
+
     default:
       printf("\n (%lf) [Switch %d] Switch Message type not supported %d "
         "dest terminal id %d packet ID %d ", tw_now(lp), (int)lp->gid,
@@ -3160,6 +3519,10 @@ void switch_rc_event_handler(switch_state * s, tw_bf * bf,
         switch_buf_update_rc(s, bf, msg, lp);
         break;
 
+    case S_FAULT:
+        switch_fault_rc(s, bf, msg, lp);
+        break;
+
   }
 }
 /* fattree compute node and switch LP types */
@@ -3297,7 +3660,8 @@ struct model_net_method fattree_method =
   .mn_collective_call = NULL,
   .mn_collective_call_rc = NULL,
   .mn_model_stat_register = fattree_register_model_stats,
-  .mn_get_model_stat_types = fattree_get_cn_model_stat_types
+  .mn_get_model_stat_types = fattree_get_cn_model_stat_types,
+  .mn_partition_hint = fattree_partition_hint
 };
 
 #ifdef ENABLE_CORTEX
@@ -0,0 +1,1323 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+/* Flow-level network approximation: each model-net message is a single flow
+ * that shares the links of its path with the other active flows under max-min
+ * fairness. Rates are only recomputed when a flow enters or leaves the
+ * network. See doc/README.flownet.txt */
+
+#include <string.h>
+#include <assert.h>
+#include <ross.h>
+
+#include "codes/lp-io.h"
+#include "codes/jenkins-hash.h"
+#include "codes/model-net-method.h"
+#include "codes/model-net.h"
+#include "codes/model-net-lp.h"
+#include "codes/codes_mapping.h"
+#include "codes/codes.h"
+#include "codes/rc-stack.h"
+#include "codes/net/flownet.h"
+
+#define FLOWNET_DEBUG 0
+
+#define LP_CONFIG_NM (model_net_lp_config_names[FLOWNET])
+#define LP_METHOD_NM (model_net_method_names[FLOWNET])
+
+/* longest path of the supported topologies is terminal, local, global,
+ * local, terminal */
+#define FN_MAX_PATH 8
+
+/* a flow whose remaining transfer takes less than this is done (ns) */
+#define FN_DONE_EPS 1e-6
+
+enum fn_topo
+{
+    FN_TOPO_DRAGONFLY_DALLY,
+    FN_TOPO_FATTREE
+};
+
+/* one direction of the routers' global links between two groups */
+struct fn_global_link
+{
+    int src_router;
+    int dest_router;
+    int link;
+};
+
+/* parameters for flownet configuration */
+struct flownet_param
+{
+    enum fn_topo topo;
+    int num_terminals;
+    int num_lps;
+    tw_lpid controller; /* flownet LP holding the flows of this annotation */
+
+    /* links 0..num_terminals-1 are the terminal->router injection links,
+     * num_terminals..2*num_terminals-1 the router->terminal ones, the
+     * topology-specific links follow */
+    int num_links;
+    double *link_bw; /* bytes per ns */
+    double hop_delay; /* ns added per link of the path */
+
+    /* dragonfly-dally */
+    int num_groups;
+    int num_routers;
+    int num_cn;
+    int *local_link; /* [router * num_routers + dest local router id] */
+    int *global_start; /* [src group * num_groups + dest group], +1 entry */
+    struct fn_global_link *global_links;
+
+    /* two-level fattree */
+    int num_l0;
+    int num_l1;
+    int l0_term_size;
+};
+typedef struct flownet_param flownet_param;
+
+/* an active flow (controller only). remaining and rate hold as of updated;
+ * flows whose rate is not changed by an event are not touched by it */
+struct fn_flow
+{
+    tw_lpid src_gid;
+    tw_lpid src_mn_lp;
+    tw_lpid final_dest_gid;
+    tw_lpid dest_mn_lp;
+    uint64_t size;
+    double remaining; /* bytes */
+    double rate; /* bytes per ns */
+    tw_stime updated;
+    tw_stime start;
+    int active;
+    uint64_t mark; /* rate allocation scratch */
+    int path_len;
+    int path[FN_MAX_PATH];
+    int is_pull;
+    uint64_t pull_size;
+    int event_size;
+    int local_event_size;
+    char *payload; /* remote event followed by the local event */
+    char category[CATEGORY_NAME_MAX];
+};
+
+/* rate of a flow before an event changed it */
+struct fn_rate_undo
+{
+    int slot;
+    double rate;
+    double remaining;
+    tw_stime updated;
+};
+
+/* a flow completed by an event, with its positions in the link lists */
+struct fn_done_undo
+{
+    int slot;
+    int pos[FN_MAX_PATH];
+    struct fn_flow flow;
+};
+
+/* what a controller event changed, undone on rollback. The payloads of the
+ * flows the event completed are freed once the event commits */
+struct fn_undo
+{
+    uint64_t timer_gen;
+    int new_slot; /* FN_FLOW_START: slot of the new flow */
+    int new_grew; /* the new flow took a slot past the end of the table */
+    int num_changed;
+    struct fn_rate_undo *changed;
+    int num_done;
+    struct fn_done_undo *done;
+};
+
+typedef struct fn_state fn_state;
+
+struct fn_state
+{
+    const char * anno;
+    const flownet_param * params;
+
+    int id; /* terminal id w.r.t. annotation */
+
+    /* controller only: the flow table (slots with active unset are on the
+     * free list) and, for every link, the slots of the flows crossing it */
+    struct fn_flow *flows;
+    int num_flows;
+    int num_slots;
+    int max_slots;
+    int *free_slots;
+    int num_free;
+    int **link_flows;
+    int *link_num_flows;
+    int *link_max_flows;
+    /* bumped on every rate change, so timers of older allocations are
+     * recognized as stale */
+    uint64_t timer_gen;
+    struct rc_stack *undo;
+
+    struct mn_stats fn_stats_array[CATEGORY_MAX];
+};
+
+/* annotation-specific parameters (unannotated entry occurs at the
+ * last index) */
+static uint64_t                  num_params = 0;
+static flownet_param           * all_params = NULL;
+static const config_anno_map_t * anno_map   = NULL;
+
+static int fn_magic = 0;
+
+/* scratch space for the rate allocation, sized for the largest topology (and
+ * grown with the number of flows) */
+struct fn_heap_ent
+{
+    double share;
+    int link;
+};
+static double   *link_rem   = NULL;
+static int      *link_cnt   = NULL;
+static uint64_t *link_stamp = NULL;
+static uint64_t  stamp      = 0;
+static int      *touched    = NULL;
+static int      *comp       = NULL;
+static int       max_comp   = 0;
+static struct fn_heap_ent *heap = NULL;
+static int       heap_len   = 0;
+static int       max_heap   = 0;
+
+static const tw_lptype* fn_get_lp_type(void);
+static void fn_configure();
+static int fn_get_msg_sz(void);
+static void fn_report_stats();
+static void fn_collective();
+static void fn_collective_rc();
+
+static tw_stime flownet_packet_event(
+        model_net_request const * req,
+        uint64_t message_offset,
+        uint64_t packet_size,
+        tw_stime offset,
+        mn_sched_params const * sched_params,
+        void const * remote_event,
+        void const * self_event,
+        tw_lp *sender,
+        int is_last_pckt);
+static void flownet_packet_event_rc(tw_lp *sender);
+
+struct model_net_method flownet_method =
+{
+    .mn_configure = fn_configure,
+    .mn_register = NULL,
+    .model_net_method_packet_event = flownet_packet_event,
+    .model_net_method_packet_event_rc = flownet_packet_event_rc,
+    .model_net_method_recv_msg_event = NULL,
+    .model_net_method_recv_msg_event_rc = NULL,
+    .mn_get_lp_type = fn_get_lp_type,
+    .mn_get_msg_sz = fn_get_msg_sz,
+    .mn_report_stats = fn_report_stats,
+    .mn_collective_call = fn_collective,
+    .mn_collective_call_rc = fn_collective_rc,
+    .mn_sample_fn = NULL,
+    .mn_sample_rc_fn = NULL,
+    .mn_sample_init_fn = NULL,
+    .mn_sample_fini_fn = NULL,
+    .mn_model_stat_register = NULL, // for ROSS instrumentation
+    .mn_get_model_stat_types = NULL // for ROSS instrumentation
+};
+
+static void fn_init(
+    fn_state * ns,
+    tw_lp * lp);
+static void fn_event(
+    fn_state * ns,
+    tw_bf * b,
+    fn_message * m,
+    tw_lp * lp);
+static void fn_rev_event(
+    fn_state * ns,
+    tw_bf * b,
+    fn_message * m,
+    tw_lp * lp);
+static void fn_finalize(
+    fn_state * ns,
+    tw_lp * lp);
+
+tw_lptype fn_lp = {
+    (init_f) fn_init,
+    (pre_run_f) NULL,
+    (event_f) fn_event,
+    (revent_f) fn_rev_event,
+    (commit_f) NULL,
+    (final_f) fn_finalize,
+    (map_f) codes_mapping,
+    sizeof(fn_state),
+};
+
+/* collective network calls */
+static void fn_collective()
+{
+/* collectives not supported */
+    return;
+}
+
+static void fn_collective_rc()
+{
+/* collectives not supported */
+   return;
+}
+
+static const tw_lptype* fn_get_lp_type()
+{
+    return(&fn_lp);
+}
+
+static int fn_get_msg_sz(void)
+{
+    return(sizeof(fn_message));
+}
+
+static void fn_report_stats()
+{
+   return;
+}
+
+/* GiB/s to bytes per ns */
+static double gib_to_bytes_per_ns(double GB_p_s)
+{
+    return GB_p_s * 1024.0 * 1024.0 * 1024.0 / (1000.0 * 1000.0 * 1000.0);
+}
+
+static const flownet_param * fn_get_params(tw_lpid gid)
+{
+    const char * anno = codes_mapping_get_annotation_by_lpid(gid);
+    if (anno == NULL)
+        return &all_params[num_params-1];
+    return &all_params[configuration_get_annotation_index(anno, anno_map)];
+}
+
+/**** topologies ****/
+
+static void fn_read_dragonfly_dally(const char * anno, flownet_param *p)
+{
+    double cn_bw, local_bw, global_bw;
+    char fname[MAX_NAME_LENGTH];
+    int rc;
+
+    rc = configuration_get_value_int(&config, "PARAMS", "num_groups", anno,
+            &p->num_groups);
+    if (rc)
+        tw_error(TW_LOC, "flownet: num_groups not specified");
+    rc = configuration_get_value_int(&config, "PARAMS", "num_routers", anno,
+            &p->num_routers);
+    if (rc)
+        tw_error(TW_LOC, "flownet: num_routers not specified");
+    rc = configuration_get_value_int(&config, "PARAMS", "num_cns_per_router",
+            anno, &p->num_cn);
+    if (rc)
+        p->num_cn = p->num_routers/2;
+
+    cn_bw = local_bw = global_bw = 5.25;
+    configuration_get_value_double(&config, "PARAMS", "cn_bandwidth", anno,
+            &cn_bw);
+    configuration_get_value_double(&config, "PARAMS", "local_bandwidth", anno,
+            &local_bw);
+    configuration_get_value_double(&config, "PARAMS", "global_bandwidth", anno,
+            &global_bw);
+
+    int total_routers = p->num_groups * p->num_routers;
+    int nr = p->num_routers, ng = p->num_groups;
+    p->num_terminals = total_routers * p->num_cn;
+
+    /* parallel connections between the same pair of routers are folded into
+     * one link of the combined bandwidth */
+    int *local_mult = calloc(total_routers * nr, sizeof(int));
+    int *global_mult = calloc(total_routers * total_routers, sizeof(int));
+
+    configuration_get_value(&config, "PARAMS", "intra-group-connections",
+            anno, fname, MAX_NAME_LENGTH);
+    FILE *f = fopen(fname, "rb");
+    if (!f)
+        tw_error(TW_LOC, "flownet: unable to open intra-group connections "
+                "file \"%s\"", fname);
+    struct { int src, dest, type; } intra;
+    while (fread(&intra, sizeof(intra), 1, f) != 0) {
+        if (intra.src < 0 || intra.src >= nr || intra.dest < 0 ||
+                intra.dest >= nr)
+            tw_error(TW_LOC, "flownet: bad intra-group link %d->%d",
+                    intra.src, intra.dest);
+        for (int g = 0; g < ng; g++)
+            local_mult[(g*nr + intra.src) * nr + intra.dest]++;
+    }
+    fclose(f);
+
+    configuration_get_value(&config, "PARAMS", "inter-group-connections",
+            anno, fname, MAX_NAME_LENGTH);
+    f = fopen(fname, "rb");
+    if (!f)
+        tw_error(TW_LOC, "flownet: unable to open inter-group connections "
+                "file \"%s\"", fname);
+    struct { int src, dest; } inter;
+    int num_global = 0;
+    while (fread(&inter, sizeof(inter), 1, f) != 0) {
+        if (inter.src < 0 || inter.src >= total_routers || inter.dest < 0 ||
+                inter.dest >= total_routers)
+            tw_error(TW_LOC, "flownet: bad inter-group link %d->%d",
+                    inter.src, inter.dest);
+        if (global_mult[inter.src * total_routers + inter.dest]++ == 0)
+            num_global++;
+    }
+    fclose(f);
+
+    /* number the links */
+    int num_local = 0;
+    for (int i = 0; i < total_routers * nr; i++)
+        num_local += local_mult[i] > 0;
+    p->num_links = 2*p->num_terminals + num_local + num_global;
+    p->link_bw = malloc(p->num_links * sizeof(*p->link_bw));
+    for (int t = 0; t < 2*p->num_terminals; t++)
+        p->link_bw[t] = gib_to_bytes_per_ns(cn_bw);
+
+    int l = 2*p->num_terminals;
+    p->local_link = malloc(total_routers * nr * sizeof(*p->local_link));
+    for (int i = 0; i < total_routers * nr; i++) {
+        p->local_link[i] = local_mult[i] ? l : -1;
+        if (local_mult[i])
+            p->link_bw[l++] = local_mult[i] * gib_to_bytes_per_ns(local_bw);
+    }
+
+    /* global links bucketed by (source group, destination group) */
+    p->global_start = calloc(ng*ng + 1, sizeof(*p->global_start));
+    p->global_links = malloc(num_global * sizeof(*p->global_links));
+    for (int s = 0; s < total_routers; s++)
+        for (int d = 0; d < total_routers; d++)
+            if (global_mult[s * total_routers + d])
+                p->global_start[(s/nr) * ng + d/nr + 1]++;
+    for (int i = 0; i < ng*ng; i++)
+        p->global_start[i+1] += p->global_start[i];
+    int *fill = calloc(ng*ng, sizeof(int));
+    for (int s = 0; s < total_routers; s++) {
+        for (int d = 0; d < total_routers; d++) {
+            int mult = global_mult[s * total_routers + d];
+            if (!mult)
+                continue;
+            int b = (s/nr) * ng + d/nr;
+            struct fn_global_link *gl =
+                &p->global_links[p->global_start[b] + fill[b]++];
+            gl->src_router = s;
+            gl->dest_router = d;
+            gl->link = l;
+            p->link_bw[l++] = mult * gib_to_bytes_per_ns(global_bw);
+        }
+    }
+    assert(l == p->num_links);
+
+    free(fill);
+    free(local_mult);
+    free(global_mult);
+}
+
+static void fn_read_fattree(const char * anno, flownet_param *p)
+{
+    char str[MAX_NAME_LENGTH];
+    int num_levels = 0, radix, rc;
+    double tapering = 1, link_bw = 5, cn_bw = 5;
+
+    configuration_get_value_int(&config, "PARAMS", "num_levels", anno,
+            &num_levels);
+    if (num_levels != 2)
+        tw_error(TW_LOC, "flownet: only two-level fattrees are supported "
+                "(num_levels is %d)", num_levels);
+
+    rc = configuration_get_value(&config, "PARAMS", "switch_count", anno,
+            str, MAX_NAME_LENGTH);
+    if (rc <= 0 || sscanf(str, "%d", &p->num_l0) != 1 || p->num_l0 <= 0)
+        tw_error(TW_LOC, "flownet: couldn't read PARAMS:switch_count");
+    rc = configuration_get_value(&config, "PARAMS", "switch_radix", anno,
+            str, MAX_NAME_LENGTH);
+    if (rc <= 0 || sscanf(str, "%d", &radix) != 1 || radix <= 0)
+        tw_error(TW_LOC, "flownet: couldn't read PARAMS:switch_radix");
+    configuration_get_value_double(&config, "PARAMS", "tapering", anno,
+            &tapering);
+    configuration_get_value_double(&config, "PARAMS", "link_bandwidth", anno,
+            &link_bw);
+    configuration_get_value_double(&config, "PARAMS", "cn_bandwidth", anno,
+            &cn_bw);
+
+    /* same layout as fattree.c: every L0 switch has two links to every L1
+     * switch */
+    tapering += 1;
+    p->l0_term_size = (tapering - 1) * (radix / tapering);
+    p->num_l1 = p->num_l0 / tapering;
+    if (p->l0_term_size <= 0 || p->num_l1 <= 0)
+        tw_error(TW_LOC, "flownet: fattree with %d switches of radix %d has "
+                "no terminals or no L1 switches", p->num_l0, radix);
+    p->num_terminals = p->num_l0 * p->l0_term_size;
+
+    int num_pairs = p->num_l0 * p->num_l1;
+    p->num_links = 2*p->num_terminals + 2*num_pairs;
+    p->link_bw = malloc(p->num_links * sizeof(*p->link_bw));
+    for (int t = 0; t < 2*p->num_terminals; t++)
+        p->link_bw[t] = gib_to_bytes_per_ns(cn_bw);
+    for (int l = 2*p->num_terminals; l < p->num_links; l++)
+        p->link_bw[l] = 2 * gib_to_bytes_per_ns(link_bw);
+}
+
+/* ECMP-style choice among equivalent paths, fixed per (src, dest) pair */
+static int fn_path_hash(int src, int dest, int n)
+{
+    uint32_t h1 = 0, h2 = 0;
+    int key[2] = { src, dest };
+    bj_hashlittle2(key, sizeof(key), &h1, &h2);
+    return h1 % n;
+}
+
+/* minimal path between two terminals as a list of link ids */
+static int fn_route(const flownet_param *p, int src, int dest, int *path)
+{
+    int len = 0;
+    path[len++] = src;
+
+    if (p->topo == FN_TOPO_DRAGONFLY_DALLY) {
+        int nr = p->num_routers;
+        int src_r = src / p->num_cn, dest_r = dest / p->num_cn;
+        int src_g = src_r / nr, dest_g = dest_r / nr;
+        int cur = src_r;
+
+        if (src_g != dest_g) {
+            int b = src_g * p->num_groups + dest_g;
+            int n = p->global_start[b+1] - p->global_start[b];
+            if (n == 0)
+                tw_error(TW_LOC, "flownet: no global link from group %d to "
+                        "group %d", src_g, dest_g);
+            const struct fn_global_link *gl = &p->global_links[
+                p->global_start[b] + fn_path_hash(src, dest, n)];
+            if (cur != gl->src_router)
+                path[len++] = p->local_link[cur * nr + gl->src_router % nr];
+            path[len++] = gl->link;
+            cur = gl->dest_router;
+        }
+        if (cur != dest_r)
+            path[len++] = p->local_link[cur * nr + dest_r % nr];
+        for (int i = 0; i < len; i++)
+            if (path[i] < 0)
+                tw_error(TW_LOC, "flownet: no local link on the minimal "
+                        "path from terminal %d to %d", src, dest);
+    }
+    else {
+        int src_s = src / p->l0_term_size, dest_s = dest / p->l0_term_size;
+        if (src_s != dest_s) {
+            int l1 = fn_path_hash(src, dest, p->num_l1);
+            int up = 2*p->num_terminals;
+            int down = up + p->num_l0 * p->num_l1;
+            path[len++] = up + src_s * p->num_l1 + l1;
+            path[len++] = down + dest_s * p->num_l1 + l1;
+        }
+    }
+
+    path[len++] = p->num_terminals + dest;
+    assert(len <= FN_MAX_PATH);
+    return len;
+}
+
+/**** flow table ****/
+
+static int fn_slot_alloc(fn_state * ns, int *grew)
+{
+    if (ns->num_free > 0) {
+        *grew = 0;
+        return ns->free_slots[--ns->num_free];
+    }
+    if (ns->num_slots == ns->max_slots) {
+        ns->max_slots *= 2;
+        ns->flows = realloc(ns->flows, ns->max_slots * sizeof(*ns->flows));
+        ns->free_slots = realloc(ns->free_slots,
+                ns->max_slots * sizeof(*ns->free_slots));
+    }
+    *grew = 1;
+    return ns->num_slots++;
+}
+
+/* add a flow to the lists of the links of its path */
+static void fn_link_insert(fn_state * ns, int slot)
+{
+    struct fn_flow const *f = &ns->flows[slot];
+    for (int k = 0; k < f->path_len; k++) {
+        int l = f->path[k];
+        if (ns->link_num_flows[l] == ns->link_max_flows[l]) {
+            ns->link_max_flows[l] = ns->link_max_flows[l] ?
+                2*ns->link_max_flows[l] : 4;
+            ns->link_flows[l] = realloc(ns->link_flows[l],
+                    ns->link_max_flows[l] * sizeof(**ns->link_flows));
+        }
+        ns->link_flows[l][ns->link_num_flows[l]++] = slot;
+    }
+}
+
+/* undo fn_link_insert of the last flow inserted */
+static void fn_link_insert_rc(fn_state * ns, int slot)
+{
+    struct fn_flow const *f = &ns->flows[slot];
+    for (int k = 0; k < f->path_len; k++)
+        ns->link_num_flows[f->path[k]]--;
+}
+
+/* take a flow off the lists of its links, saving its position in each */
+static void fn_link_remove(fn_state * ns, int slot, int *pos)
+{
+    struct fn_flow const *f = &ns->flows[slot];
+    for (int k = 0; k < f->path_len; k++) {
+        int l = f->path[k];
+        int *list = ns->link_flows[l];
+        int i = 0;
+        while (list[i] != slot)
+            i++;
+        pos[k] = i;
+        list[i] = list[--ns->link_num_flows[l]];
+    }
+}
+
+static void fn_link_remove_rc(fn_state * ns, int slot, int const *pos)
+{
+    struct fn_flow const *f = &ns->flows[slot];
+    for (int k = f->path_len-1; k >= 0; k--) {
+        int l = f->path[k];
+        int *list = ns->link_flows[l];
+        list[ns->link_num_flows[l]++] = list[pos[k]];
+        list[pos[k]] = slot;
+    }
+}
+
+/**** max-min fair rates ****/
+
+/* links by fair share, ties broken by link id so that the allocation does
+ * not depend on the event history */
+static int fn_heap_less(
+        struct fn_heap_ent const *a,
+        struct fn_heap_ent const *b)
+{
+    return a->share < b->share || (a->share == b->share && a->link < b->link);
+}
+
+static void fn_heap_push(int l)
+{
+    if (heap_len == max_heap) {
+        max_heap = max_heap ? 2*max_heap : 64;
+        heap = realloc(heap, max_heap * sizeof(*heap));
+    }
+    struct fn_heap_ent e = { link_rem[l] / link_cnt[l], l };
+    int i = heap_len++;
+    while (i > 0 && fn_heap_less(&e, &heap[(i-1)/2])) {
+        heap[i] = heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    heap[i] = e;
+}
+
+static struct fn_heap_ent fn_heap_pop(void)
+{
+    struct fn_heap_ent top = heap[0], last = heap[--heap_len];
+    int i = 0;
+    for (;;) {
+        int c = 2*i + 1;
+        if (c >= heap_len)
+            break;
+        if (c+1 < heap_len && fn_heap_less(&heap[c+1], &heap[c]))
+            c++;
+        if (!fn_heap_less(&heap[c], &last))
+            break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+/* Max-min fair rates of flows that share no link, directly or through other
+ * flows, are independent, so only the component of the flows reachable from
+ * the seed links is reallocated. Its flows are drained up to now, with their
+ * previous state saved in u. Progressive filling then repeatedly takes the
+ * link with the smallest fair share and fixes the unfixed flows crossing it
+ * at that share. */
+static void fn_allocate(
+        fn_state * ns,
+        int num_seeds,
+        int const * seeds,
+        tw_stime now,
+        struct fn_undo * u)
+{
+    const flownet_param *p = ns->params;
+    int num_touched = 0, num_comp = 0;
+
+    stamp++;
+    for (int i = 0; i < num_seeds; i++) {
+        if (link_stamp[seeds[i]] != stamp) {
+            link_stamp[seeds[i]] = stamp;
+            touched[num_touched++] = seeds[i];
+        }
+    }
+    for (int t = 0; t < num_touched; t++) {
+        int l = touched[t];
+        for (int j = 0; j < ns->link_num_flows[l]; j++) {
+            int slot = ns->link_flows[l][j];
+            struct fn_flow *f = &ns->flows[slot];
+            if (f->mark == stamp)
+                continue;
+            f->mark = stamp;
+            if (num_comp == max_comp) {
+                max_comp = max_comp ? 2*max_comp : 64;
+                comp = realloc(comp, max_comp * sizeof(*comp));
+            }
+            comp[num_comp++] = slot;
+            for (int k = 0; k < f->path_len; k++) {
+                int l2 = f->path[k];
+                if (link_stamp[l2] != stamp) {
+                    link_stamp[l2] = stamp;
+                    touched[num_touched++] = l2;
+                }
+            }
+        }
+    }
+
+    u->num_changed = num_comp;
+    u->changed = num_comp ? malloc(num_comp * sizeof(*u->changed)) : NULL;
+    for (int i = 0; i < num_comp; i++) {
+        struct fn_flow *f = &ns->flows[comp[i]];
+        struct fn_rate_undo *r = &u->changed[i];
+        r->slot = comp[i];
+        r->rate = f->rate;
+        r->remaining = f->remaining;
+        r->updated = f->updated;
+        f->remaining -= f->rate * (now - f->updated);
+        if (f->remaining < 0)
+            f->remaining = 0;
+        f->updated = now;
+        f->rate = -1;
+    }
+
+    heap_len = 0;
+    for (int t = 0; t < num_touched; t++) {
+        int l = touched[t];
+        link_rem[l] = p->link_bw[l];
+        link_cnt[l] = ns->link_num_flows[l];
+        if (link_cnt[l] > 0)
+            fn_heap_push(l);
+    }
+    while (heap_len > 0) {
+        struct fn_heap_ent e = fn_heap_pop();
+        int l = e.link;
+        /* a link is pushed again whenever its share changes; older entries
+         * are skipped */
+        if (link_cnt[l] == 0 || e.share != link_rem[l] / link_cnt[l])
+            continue;
+        double share = e.share > 0 ? e.share : 0;
+        for (int j = 0; j < ns->link_num_flows[l]; j++) {
+            struct fn_flow *f = &ns->flows[ns->link_flows[l][j]];
+            if (f->rate >= 0)
+                continue;
+            f->rate = share;
+            for (int k = 0; k < f->path_len; k++) {
+                int l2 = f->path[k];
+                link_rem[l2] -= share;
+                if (--link_cnt[l2] > 0 && l2 != l)
+                    fn_heap_push(l2);
+            }
+        }
+    }
+}
+
+/* schedule a timer for the earliest completion */
+static void fn_reschedule(fn_state * ns, tw_lp * lp)
+{
+    ns->timer_gen++;
+    if (ns->num_flows == 0)
+        return;
+
+    tw_stime now = tw_now(lp), next = -1;
+    for (int i = 0; i < ns->num_slots; i++) {
+        struct fn_flow *f = &ns->flows[i];
+        if (!f->active || f->rate <= 0)
+            continue;
+        tw_stime t = f->updated + f->remaining / f->rate - now;
+        if (next < 0 || t < next)
+            next = t;
+    }
+    if (next < g_tw_lookahead)
+        next = g_tw_lookahead;
+
+    fn_message *m;
+    void *m_data;
+    tw_event *e = model_net_method_event_new(lp->gid, next, lp, FLOWNET,
+            (void**)&m, &m_data);
+    memset(m, 0, sizeof(*m));
+    m->magic = fn_magic;
+    m->event_type = FN_FLOW_TIMER;
+    m->timer_gen = ns->timer_gen;
+    tw_event_send(e);
+}
+
+/**** controller state saving ****/
+
+static struct fn_undo * fn_undo_new(fn_state const * ns)
+{
+    struct fn_undo *u = calloc(1, sizeof(*u));
+    u->timer_gen = ns->timer_gen;
+    u->new_slot = -1;
+    return u;
+}
+
+/* release an undo record whose completed flows have been put back, leaving
+ * their payloads to them */
+static void fn_undo_release(struct fn_undo *u)
+{
+    free(u->changed);
+    free(u->done);
+    free(u);
+}
+
+/* commit: the completed flows are gone for good */
+static void fn_undo_free(void *ptr)
+{
+    struct fn_undo *u = ptr;
+    for (int i = 0; i < u->num_done; i++)
+        free(u->done[i].flow.payload);
+    fn_undo_release(u);
+}
+
+/* put back the rates the event changed */
+static void fn_undo_rates(fn_state * ns, struct fn_undo const *u)
+{
+    for (int i = 0; i < u->num_changed; i++) {
+        struct fn_rate_undo const *r = &u->changed[i];
+        struct fn_flow *f = &ns->flows[r->slot];
+        f->rate = r->rate;
+        f->remaining = r->remaining;
+        f->updated = r->updated;
+    }
+}
+
+/**** event handlers ****/
+
+static void fn_init(
+    fn_state * ns,
+    tw_lp * lp)
+{
+    uint32_t h1 = 0, h2 = 0;
+    memset(ns, 0, sizeof(*ns));
+
+    bj_hashlittle2(LP_METHOD_NM, strlen(LP_METHOD_NM), &h1, &h2);
+    fn_magic = h1+h2;
+
+    ns->anno = codes_mapping_get_annotation_by_lpid(lp->gid);
+    ns->params = fn_get_params(lp->gid);
+    ns->id = codes_mapping_get_lp_relative_id(lp->gid, 0, 1);
+
+    if (lp->gid == ns->params->controller) {
+        int num_links = ns->params->num_links;
+        ns->max_slots = 64;
+        ns->flows = malloc(ns->max_slots * sizeof(*ns->flows));
+        ns->free_slots = malloc(ns->max_slots * sizeof(*ns->free_slots));
+        ns->link_flows = calloc(num_links, sizeof(*ns->link_flows));
+        ns->link_num_flows = calloc(num_links, sizeof(*ns->link_num_flows));
+        ns->link_max_flows = calloc(num_links, sizeof(*ns->link_max_flows));
+        rc_stack_create(&ns->undo);
+    }
+}
+
+static void handle_flow_start_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    struct fn_undo *u = fn_undo_new(ns);
+    int slot = fn_slot_alloc(ns, &u->new_grew);
+    u->new_slot = slot;
+
+    struct fn_flow *f = &ns->flows[slot];
+    f->src_gid = m->src_gid;
+    f->src_mn_lp = m->src_mn_lp;
+    f->final_dest_gid = m->final_dest_gid;
+    f->dest_mn_lp = m->dest_mn_lp;
+    f->size = m->net_msg_size_bytes;
+    f->remaining = m->net_msg_size_bytes;
+    f->rate = 0;
+    f->updated = tw_now(lp);
+    f->start = tw_now(lp);
+    f->active = 1;
+    f->mark = 0;
+    f->path_len = fn_route(ns->params,
+            codes_mapping_get_lp_relative_id(m->src_mn_lp, 0, 1),
+            codes_mapping_get_lp_relative_id(m->dest_mn_lp, 0, 1), f->path);
+    f->is_pull = m->is_pull;
+    f->pull_size = m->pull_size;
+    f->event_size = m->event_size_bytes;
+    f->local_event_size = m->local_event_size_bytes;
+    f->payload = NULL;
+    int payload_size = m->event_size_bytes + m->local_event_size_bytes;
+    if (payload_size) {
+        f->payload = malloc(payload_size);
+        memcpy(f->payload, model_net_method_get_edata(FLOWNET, m),
+                payload_size);
+    }
+    strcpy(f->category, m->category);
+    ns->num_flows++;
+    fn_link_insert(ns, slot);
+
+#if FLOWNET_DEBUG
+    printf("%lf: flow %llu -> %llu, %llu bytes, %d links, %d flows\n",
+            tw_now(lp), LLU(f->src_mn_lp), LLU(f->dest_mn_lp), LLU(f->size),
+            f->path_len, ns->num_flows);
+#endif
+
+    fn_allocate(ns, f->path_len, f->path, tw_now(lp), u);
+    fn_reschedule(ns, lp);
+    rc_stack_push(lp, u, fn_undo_free, ns->undo);
+}
+
+static void handle_flow_start_rev_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    (void)m;
+    (void)lp;
+    struct fn_undo *u = rc_stack_pop(ns->undo);
+    int slot = u->new_slot;
+
+    fn_undo_rates(ns, u);
+    fn_link_insert_rc(ns, slot);
+    free(ns->flows[slot].payload);
+    ns->flows[slot].active = 0;
+    ns->num_flows--;
+    if (u->new_grew)
+        ns->num_slots--;
+    else
+        ns->free_slots[ns->num_free++] = slot;
+    ns->timer_gen = u->timer_gen;
+    fn_undo_release(u);
+}
+
+/* hand a finished flow to its source and destination */
+static void fn_flow_done(
+    fn_state const * ns,
+    struct fn_flow const * f,
+    tw_lp * lp)
+{
+    fn_message *m_new;
+    void *m_data;
+    tw_event *e;
+    tw_stime latency = f->path_len * ns->params->hop_delay;
+
+    e = model_net_method_event_new(f->dest_mn_lp, latency, lp, FLOWNET,
+            (void**)&m_new, &m_data);
+    memset(m_new, 0, sizeof(*m_new));
+    m_new->magic = fn_magic;
+    m_new->event_type = FN_FLOW_ARRIVE;
+    m_new->src_gid = f->src_gid;
+    m_new->src_mn_lp = f->src_mn_lp;
+    m_new->final_dest_gid = f->final_dest_gid;
+    m_new->dest_mn_lp = f->dest_mn_lp;
+    m_new->net_msg_size_bytes = f->size;
+    m_new->event_size_bytes = f->event_size;
+    m_new->is_pull = f->is_pull;
+    m_new->pull_size = f->pull_size;
+    m_new->flow_time = tw_now(lp) + latency - f->start;
+    strcpy(m_new->category, f->category);
+    if (f->event_size)
+        memcpy(m_data, f->payload, f->event_size);
+    tw_event_send(e);
+
+    e = model_net_method_event_new(f->src_mn_lp, codes_local_latency(lp), lp,
+            FLOWNET, (void**)&m_new, &m_data);
+    memset(m_new, 0, sizeof(*m_new));
+    m_new->magic = fn_magic;
+    m_new->event_type = FN_FLOW_SENT;
+    m_new->src_gid = f->src_gid;
+    m_new->net_msg_size_bytes = f->size;
+    m_new->event_size_bytes = f->event_size;
+    m_new->local_event_size_bytes = f->local_event_size;
+    m_new->flow_time = tw_now(lp) - f->start;
+    strcpy(m_new->category, f->category);
+    if (f->local_event_size)
+        memcpy(m_data, f->payload + f->event_size, f->local_event_size);
+    tw_event_send(e);
+}
+
+static void handle_flow_timer_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    if (m->timer_gen != ns->timer_gen) {
+        m->is_stale = 1;
+        return;
+    }
+    m->is_stale = 0;
+
+    struct fn_undo *u = fn_undo_new(ns);
+    tw_stime now = tw_now(lp);
+    int max_done = 0;
+
+    m->num_done = 0;
+    for (int i = 0; i < ns->num_slots; i++) {
+        struct fn_flow *f = &ns->flows[i];
+        if (!f->active)
+            continue;
+        double left = f->remaining - f->rate * (now - f->updated);
+        if (left > 0 && left / f->rate > FN_DONE_EPS)
+            continue;
+        fn_flow_done(ns, f, lp);
+        if (u->num_done == max_done) {
+            max_done = max_done ? 2*max_done : 4;
+            u->done = realloc(u->done, max_done * sizeof(*u->done));
+        }
+        struct fn_done_undo *d = &u->done[u->num_done++];
+        d->slot = i;
+        d->flow = *f;
+        fn_link_remove(ns, i, d->pos);
+        f->active = 0;
+        ns->free_slots[ns->num_free++] = i;
+        ns->num_flows--;
+        m->num_done++;
+    }
+
+    /* the links the completed flows freed up */
+    int num_seeds = 0;
+    int *seeds = malloc(u->num_done * FN_MAX_PATH * sizeof(*seeds));
+    for (int i = 0; i < u->num_done; i++)
+        for (int k = 0; k < u->done[i].flow.path_len; k++)
+            seeds[num_seeds++] = u->done[i].flow.path[k];
+    fn_allocate(ns, num_seeds, seeds, now, u);
+    free(seeds);
+
+    fn_reschedule(ns, lp);
+    rc_stack_push(lp, u, fn_undo_free, ns->undo);
+}
+
+static void handle_flow_timer_rev_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    if (m->is_stale)
+        return;
+    for (int i = 0; i < m->num_done; i++)
+        codes_local_latency_reverse(lp);
+
+    struct fn_undo *u = rc_stack_pop(ns->undo);
+    fn_undo_rates(ns, u);
+    for (int i = u->num_done-1; i >= 0; i--) {
+        struct fn_done_undo *d = &u->done[i];
+        ns->num_free--;
+        assert(ns->free_slots[ns->num_free] == d->slot);
+        ns->flows[d->slot] = d->flow;
+        fn_link_remove_rc(ns, d->slot, d->pos);
+        ns->num_flows++;
+    }
+    ns->timer_gen = u->timer_gen;
+    fn_undo_release(u);
+}
+
+static void handle_flow_arrive_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    mn_stats *stat = model_net_find_stats(m->category, ns->fn_stats_array);
+    stat->recv_count++;
+    stat->recv_bytes += m->net_msg_size_bytes;
+    stat->recv_time += m->flow_time;
+
+    if (m->event_size_bytes) {
+        void *tmp_ptr = model_net_method_get_edata(FLOWNET, m);
+        if (m->is_pull) {
+            struct codes_mctx mc_dst =
+                codes_mctx_set_global_direct(m->src_mn_lp);
+            struct codes_mctx mc_src =
+                codes_mctx_set_global_direct(lp->gid);
+            int net_id = model_net_get_id(LP_METHOD_NM);
+            m->event_rc = model_net_event_mctx(net_id, &mc_src, &mc_dst,
+                    m->category, m->src_gid, m->pull_size, 0.0,
+                    m->event_size_bytes, tmp_ptr, 0, NULL, lp);
+        }
+        else {
+            tw_event *e = tw_event_new(m->final_dest_gid,
+                    codes_local_latency(lp), lp);
+            memcpy(tw_event_data(e), tmp_ptr, m->event_size_bytes);
+            tw_event_send(e);
+        }
+    }
+}
+
+static void handle_flow_arrive_rev_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    mn_stats *stat = model_net_find_stats(m->category, ns->fn_stats_array);
+    stat->recv_count--;
+    stat->recv_bytes -= m->net_msg_size_bytes;
+    stat->recv_time -= m->flow_time;
+
+    if (m->event_size_bytes) {
+        if (m->is_pull)
+            model_net_event_rc2(lp, &m->event_rc);
+        else
+            codes_local_latency_reverse(lp);
+    }
+}
+
+static void handle_flow_sent_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    int total_event_size = model_net_get_msg_sz(FLOWNET) +
+        m->event_size_bytes + m->local_event_size_bytes;
+    mn_stats *stat = model_net_find_stats(m->category, ns->fn_stats_array);
+    stat->send_count++;
+    stat->send_bytes += m->net_msg_size_bytes;
+    stat->send_time += m->flow_time;
+    if (stat->max_event_size < total_event_size)
+        stat->max_event_size = total_event_size;
+
+    if (m->local_event_size_bytes) {
+        tw_event *e = tw_event_new(m->src_gid, codes_local_latency(lp), lp);
+        memcpy(tw_event_data(e), model_net_method_get_edata(FLOWNET, m),
+                m->local_event_size_bytes);
+        tw_event_send(e);
+    }
+}
+
+static void handle_flow_sent_rev_event(
+    fn_state * ns,
+    fn_message * m,
+    tw_lp * lp)
+{
+    mn_stats *stat = model_net_find_stats(m->category, ns->fn_stats_array);
+    stat->send_count--;
+    stat->send_bytes -= m->net_msg_size_bytes;
+    stat->send_time -= m->flow_time;
+
+    if (m->local_event_size_bytes)
+        codes_local_latency_reverse(lp);
+}
+
+static void fn_event(
+    fn_state * ns,
+    tw_bf * b,
+    fn_message * m,
+    tw_lp * lp)
+{
+    (void)b;
+    assert(m->magic == fn_magic);
+
+    if (ns->undo)
+        rc_stack_gc(lp, ns->undo);
+
+    switch (m->event_type)
+    {
+        case FN_FLOW_START:
+            handle_flow_start_event(ns, m, lp);
+            break;
+        case FN_FLOW_TIMER:
+            handle_flow_timer_event(ns, m, lp);
+            break;
+        case FN_FLOW_ARRIVE:
+            handle_flow_arrive_event(ns, m, lp);
+            break;
+        case FN_FLOW_SENT:
+            handle_flow_sent_event(ns, m, lp);
+            break;
+        default:
+            assert(0);
+            break;
+    }
+}
+
+static void fn_rev_event(
+    fn_state * ns,
+    tw_bf * b,
+    fn_message * m,
+    tw_lp * lp)
+{
+    (void)b;
+    assert(m->magic == fn_magic);
+
+    switch (m->event_type)
+    {
+        case FN_FLOW_START:
+            handle_flow_start_rev_event(ns, m, lp);
+            break;
+        case FN_FLOW_TIMER:
+            handle_flow_timer_rev_event(ns, m, lp);
+            break;
+        case FN_FLOW_ARRIVE:
+            handle_flow_arrive_rev_event(ns, m, lp);
+            break;
+        case FN_FLOW_SENT:
+            handle_flow_sent_rev_event(ns, m, lp);
+            break;
+        default:
+            assert(0);
+            break;
+    }
+}
+
+static void fn_finalize(
+    fn_state * ns,
+    tw_lp * lp)
+{
+    if (ns->undo) {
+        if (ns->num_flows)
+            fprintf(stderr, "flownet: %d flows still in the network at the "
+                    "end of the simulation\n", ns->num_flows);
+        for (int i = 0; i < ns->num_slots; i++)
+            if (ns->flows[i].active)
+                free(ns->flows[i].payload);
+        for (int l = 0; l < ns->params->num_links; l++)
+            free(ns->link_flows[l]);
+        free(ns->link_flows);
+        free(ns->link_num_flows);
+        free(ns->link_max_flows);
+        free(ns->free_slots);
+        free(ns->flows);
+        rc_stack_destroy(ns->undo);
+    }
+
+    model_net_print_stats(lp->gid, &ns->fn_stats_array[0]);
+}
+
+/* Model-net function calls */
+
+/* A message becomes a single flow no matter how the scheduler packetizes it:
+ * the first packet starts a flow of the whole message size carrying the
+ * remote and local events, the remaining packets only cost the transfer to
+ * the NIC */
+static tw_stime flownet_packet_event(
+        model_net_request const * req,
+        uint64_t message_offset,
+        uint64_t packet_size,
+        tw_stime offset,
+        mn_sched_params const * sched_params,
+        void const * remote_event,
+        void const * self_event,
+        tw_lp *sender,
+        int is_last_pckt)
+{
+    (void)packet_size;
+    (void)sched_params;
+    (void)is_last_pckt;
+    tw_event * e_new;
+    tw_stime xfer_to_nic_time;
+    fn_message * msg;
+    char* tmp_ptr;
+
+    xfer_to_nic_time = codes_local_latency(sender);
+    if (message_offset != 0)
+        return xfer_to_nic_time;
+
+    e_new = model_net_method_event_new(fn_get_params(sender->gid)->controller,
+            xfer_to_nic_time+offset, sender, FLOWNET, (void**)&msg,
+            (void**)&tmp_ptr);
+    memset(msg, 0, sizeof(*msg));
+    strcpy(msg->category, req->category);
+    msg->final_dest_gid = req->final_dest_lp;
+    msg->dest_mn_lp = req->dest_mn_lp;
+    msg->src_gid = req->src_lp;
+    msg->src_mn_lp = sender->gid;
+    msg->magic = fn_magic;
+    msg->net_msg_size_bytes = req->msg_size;
+    msg->event_type = FN_FLOW_START;
+    msg->is_pull = req->is_pull;
+    msg->pull_size = req->pull_size;
+
+    if (req->remote_event_size) {
+        msg->event_size_bytes = req->remote_event_size;
+        memcpy(tmp_ptr, remote_event, req->remote_event_size);
+        tmp_ptr += req->remote_event_size;
+    }
+    if (req->self_event_size) {
+        msg->local_event_size_bytes = req->self_event_size;
+        memcpy(tmp_ptr, self_event, req->self_event_size);
+    }
+    tw_event_send(e_new);
+    return xfer_to_nic_time;
+}
+
+static void flownet_packet_event_rc(tw_lp *sender)
+{
+    codes_local_latency_reverse(sender);
+    return;
+}
+
+static void fn_read_config(const char * anno, flownet_param *p)
+{
+    char topo[MAX_NAME_LENGTH];
+    int rc;
+
+    rc = configuration_get_value(&config, "PARAMS", "flownet_topology", anno,
+            topo, MAX_NAME_LENGTH);
+    if (rc <= 0)
+        tw_error(TW_LOC, "flownet: unable to read PARAMS:flownet_topology%s%s",
+                anno ? "@" : "", anno ? anno : "");
+    if (strcmp(topo, "dragonfly_dally") == 0) {
+        p->topo = FN_TOPO_DRAGONFLY_DALLY;
+        fn_read_dragonfly_dally(anno, p);
+    }
+    else if (strcmp(topo, "fattree") == 0) {
+        p->topo = FN_TOPO_FATTREE;
+        fn_read_fattree(anno, p);
+    }
+    else
+        tw_error(TW_LOC, "flownet: unknown flownet_topology \"%s\" (expected "
+                "dragonfly_dally or fattree)", topo);
+
+    p->hop_delay = 100;
+    configuration_get_value_double(&config, "PARAMS", "router_delay", anno,
+            &p->hop_delay);
+
+    p->num_lps = codes_mapping_get_lp_count(NULL, 0, LP_CONFIG_NM, anno, 0);
+    if (p->num_lps > p->num_terminals)
+        tw_error(TW_LOC, "flownet: %d flownet LPs but the %s topology only "
+                "has %d terminals", p->num_lps, topo, p->num_terminals);
+    p->controller = codes_mapping_get_lpid_from_relative(0, NULL,
+            LP_CONFIG_NM, anno, 1);
+
+    if (!g_tw_mynode)
+        fprintf(stderr, "flownet: %s topology, %d terminals, %d links\n",
+                topo, p->num_terminals, p->num_links);
+}
+
+static void fn_configure(){
+    anno_map = codes_mapping_get_lp_anno_map(LP_CONFIG_NM);
+    assert(anno_map);
+    num_params = anno_map->num_annos + (anno_map->has_unanno_lp > 0);
+    all_params = calloc(num_params, sizeof(*all_params));
+    for (int i = 0; i < anno_map->num_annos; i++){
+        fn_read_config(anno_map->annotations[i].ptr, &all_params[i]);
+    }
+    if (anno_map->has_unanno_lp > 0){
+        fn_read_config(NULL, &all_params[anno_map->num_annos]);
+    }
+
+    int max_links = 0;
+    for (uint64_t i = 0; i < num_params; i++)
+        if (all_params[i].num_links > max_links)
+            max_links = all_params[i].num_links;
+    link_rem = malloc(max_links * sizeof(*link_rem));
+    link_cnt = malloc(max_links * sizeof(*link_cnt));
+    link_stamp = calloc(max_links, sizeof(*link_stamp));
+    touched = malloc(max_links * sizeof(*touched));
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
@@ -17,6 +17,7 @@
 #include "codes/model-net-sched.h"
 #include "codes/codes_mapping.h"
 #include "codes/codes.h"
+#include "codes/param-table.h"
 #include "codes/net/loggp.h"
 
 #define CATEGORY_NAME_MAX 16
@@ -58,12 +59,31 @@ struct param_table_entry
 };
 typedef struct param_table_entry param_table_entry;
 
+/* columns of the lookup table, i.e. the parameters the model actually uses */
+enum loggp_param_col
+{
+    LG_COL_L,
+    LG_COL_g,
+    LG_COL_G,
+    LG_NUM_COLS
+};
+
 typedef struct loggp_param loggp_param;
 // loggp parameters
 struct loggp_param
 {
     int table_size;
-    param_table_entry table[100];
+    param_table_entry *table;
+    /* per-size lookup over table, see find_params */
+    struct codes_ptable *lookup;
+};
+
+/* loggp parameters resolved for a given msg size */
+struct loggp_lookup
+{
+    double L;
+    double g;
+    double G;
 };
 
 
@@ -107,7 +127,8 @@ static void loggp_collective_rc();
 /* sets up the loggp parameters through modelnet interface */
 static void loggp_configure();
 
-static void loggp_set_params(const char * config_file, loggp_param * params);
+static void loggp_set_params(const char * config_file,
+        enum codes_ptable_mode mode, loggp_param * params);
 
 /* Issues a loggp packet event call */
 static tw_stime loggp_packet_event(
@@ -139,9 +160,10 @@ void loggp_recv_msg_event_rc(tw_lp *sender);
 
 static void loggp_report_stats();
 
-static const struct param_table_entry* find_params(
+static void find_params(
         uint64_t msg_size,
-        const loggp_param *params);
+        const loggp_param *params,
+        struct loggp_lookup *param);
 
 /* data structure for model-net statistics */
 struct model_net_method loggp_method =
@@ -377,11 +399,11 @@ static void handle_msg_ready_event(
     loggp_message *m_new;
     struct mn_stats* stat;
     double recv_time;
-    const struct param_table_entry *param;
+    struct loggp_lookup param;
 
-    param = find_params(m->net_msg_size_bytes, ns->params);
+    find_params(m->net_msg_size_bytes, ns->params, &param);
 
-    recv_time = ((double)(m->net_msg_size_bytes-1)*param->G);
+    recv_time = ((double)(m->net_msg_size_bytes-1)*param.G);
     /* scale to nanoseconds */
     recv_time *= 1000.0;
     m->recv_time_saved = recv_time;
@@ -403,7 +425,7 @@ static void handle_msg_ready_event(
 
     /* bump up input queue idle time accordingly, include gap (g) parameter */
     m->net_recv_next_idle_saved = ns->net_recv_next_idle;
-    ns->net_recv_next_idle = recv_queue_time + tw_now(lp) + param->g*1000.0;
+    ns->net_recv_next_idle = recv_queue_time + tw_now(lp) + param.g*1000.0;
 
     dprintf("%lu (mn): ready msg    %lu->%lu, size %lu (%3s last)\n"
             "          now:%0.3le, idle[prev:%0.3le, next:%0.3le], "
@@ -500,9 +522,9 @@ static void handle_msg_start_event(
     mn_stats* stat;
     int total_event_size;
     double xmit_time;
-    const struct param_table_entry *param;
+    struct loggp_lookup param;
 
-    param = find_params(m->net_msg_size_bytes, ns->params);
+    find_params(m->net_msg_size_bytes, ns->params, &param);
 
     total_event_size = model_net_get_msg_sz(LOGGP) + m->event_size_bytes +
         m->local_event_size_bytes;
@@ -512,7 +534,7 @@ static void handle_msg_start_event(
      * msg xfer as well) and therefore are more important for overlapping
      * computation rather than simulating communication time.
      */
-    xmit_time = ((double)(m->net_msg_size_bytes-1)*param->G);
+    xmit_time = ((double)(m->net_msg_size_bytes-1)*param.G);
     /* scale to nanoseconds */
     xmit_time *= 1000.0;
     m->xmit_time_saved = xmit_time;
@@ -527,7 +549,7 @@ static void handle_msg_start_event(
         stat->max_event_size = total_event_size;
 
     /* calculate send time stamp */
-    send_queue_time = (param->L)*1000.0;
+    send_queue_time = (param.L)*1000.0;
     /* bump up time if the NIC send queue isn't idle right now */
     if(ns->net_send_next_idle > tw_now(lp))
         send_queue_time += ns->net_send_next_idle - tw_now(lp);
@@ -539,7 +561,7 @@ static void handle_msg_start_event(
     m->net_send_next_idle_saved = ns->net_send_next_idle;
     if(ns->net_send_next_idle < tw_now(lp))
         ns->net_send_next_idle = tw_now(lp);
-    ns->net_send_next_idle += xmit_time + param->g*1000.0;
+    ns->net_send_next_idle += xmit_time + param.g*1000.0;
 
     dprintf("%lu (mn): start msg    %lu->%lu, size %lu (%3s last)\n"
             "          now:%0.3le, idle[prev:%0.3le, next:%0.3le], "
@@ -715,6 +737,7 @@ void loggp_recv_msg_event_rc(tw_lp *sender){
 
 static void loggp_configure(){
     char config_file[MAX_NAME_LENGTH];
+    char interp[MAX_NAME_LENGTH];
 
     anno_map = codes_mapping_get_lp_anno_map(LP_CONFIG_NM);
     assert(anno_map);
@@ -729,7 +752,12 @@ static void loggp_configure(){
             tw_error(TW_LOC, "unable to read PARAMS:net_config_file@%s",
                     anno);
         }
-        loggp_set_params(config_file, &all_params[i]);
+        interp[0] = '\0';
+        configuration_get_value(&config, "PARAMS", "table_interp", anno,
+                interp, MAX_NAME_LENGTH);
+        loggp_set_params(config_file,
+                codes_ptable_mode_from_str(interp, CODES_PTABLE_ABOVE),
+                &all_params[i]);
     }
     if (anno_map->has_unanno_lp > 0){
         int rc = configuration_get_value_relpath(&config, "PARAMS",
@@ -737,15 +765,22 @@ static void loggp_configure(){
         if (rc <= 0){
             tw_error(TW_LOC, "unable to read PARAMS:net_config_file");
         }
-        loggp_set_params(config_file, &all_params[anno_map->num_annos]);
+        interp[0] = '\0';
+        configuration_get_value(&config, "PARAMS", "table_interp", NULL,
+                interp, MAX_NAME_LENGTH);
+        loggp_set_params(config_file,
+                codes_ptable_mode_from_str(interp, CODES_PTABLE_ABOVE),
+                &all_params[anno_map->num_annos]);
     }
 }
 
-void loggp_set_params(const char * config_file, loggp_param * params){
+void loggp_set_params(const char * config_file,
+        enum codes_ptable_mode mode, loggp_param * params){
     FILE *conf;
     int ret;
     char buffer[512];
     int line_nr = 0;
+    int table_cap = 64;
     printf("Loggp configured to use parameters from file %s\n", config_file);
 
     conf = fopen(config_file, "r");
@@ -756,11 +791,20 @@ void loggp_set_params(const char * config_file, loggp_param * params){
     }
 
     params->table_size = 0;
+    params->table = malloc(table_cap * sizeof(*params->table));
+    assert(params->table);
     while(fgets(buffer, 512, conf))
     {
         line_nr++;
         if(buffer[0] == '#')
             continue;
+        if(params->table_size == table_cap)
+        {
+            table_cap *= 2;
+            params->table = realloc(params->table,
+                    table_cap * sizeof(*params->table));
+            assert(params->table);
+        }
         ret = sscanf(buffer, "%"PRIu64" %d %lf %lf %lf %lf %lf %lf %lf %lf %lf",
             &params->table[params->table_size].size,
             &params->table[params->table_size].n,
@@ -786,6 +830,22 @@ void loggp_set_params(const char * config_file, loggp_param * params){
 
     fclose(conf);
 
+    /* build the lookup table over the parameters we actually use */
+    uint64_t *sizes = malloc(params->table_size * sizeof(*sizes));
+    double *vals = malloc(params->table_size * LG_NUM_COLS * sizeof(*vals));
+    assert(sizes && vals);
+    for(int i = 0; i < params->table_size; i++)
+    {
+        sizes[i] = params->table[i].size;
+        vals[i*LG_NUM_COLS + LG_COL_L] = params->table[i].L;
+        vals[i*LG_NUM_COLS + LG_COL_g] = params->table[i].g;
+        vals[i*LG_NUM_COLS + LG_COL_G] = params->table[i].G;
+    }
+    codes_ptable_create(params->table_size, LG_NUM_COLS, sizes, vals, mode,
+            &params->lookup);
+    free(sizes);
+    free(vals);
+
     return;
 }
 
@@ -797,26 +857,22 @@ static void loggp_packet_event_rc(tw_lp *sender)
 
 /* find the parameters corresponding to the message size we are transmitting
  */
-static const struct param_table_entry* find_params(
+static void find_params(
         uint64_t msg_size,
-        const loggp_param *params) {
-    int i;
-
-    /* pick parameters based on the next smallest size in the table, but
-     * default to beginning or end of table if we are out of range
+        const loggp_param *params,
+        struct loggp_lookup *param) {
+    double vals[LG_NUM_COLS];
+
+    /* by default, pick parameters based on the first table entry larger
+     * than the message, defaulting to the end of the table if we are out
+     * of range. With table_interp="linear", interpolate between the
+     * entries bracketing the message size instead.
      */
+    codes_ptable_lookup(params->lookup, msg_size, vals);
 
-    for(i=0; i < params->table_size; i++)
-    {
-        if(params->table[i].size > msg_size)
-        {
-            break;
-        }
-    }
-    if(i>=params->table_size)
-        i = params->table_size-1;
-
-    return(&params->table[i]);
+    param->L = vals[LG_COL_L];
+    param->g = vals[LG_COL_g];
+    param->G = vals[LG_COL_G];
 }
 
 /*
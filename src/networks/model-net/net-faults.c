@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/net/net-faults.h"
+
+int net_read_faults(const char *fname, int num_routers,
+    struct net_fault **faults)
+{
+  FILE *fp = fopen(fname, "r");
+  if(!fp)
+    tw_error(TW_LOC, "Could not open failure schedule %s\n", fname);
+
+  int num = 0, cap = 16;
+  struct net_fault *list = malloc(cap * sizeof(struct net_fault));
+  char line[1024];
+  int lineno = 0;
+  while(fgets(line, sizeof(line), fp)) {
+    lineno++;
+    char *comment = strchr(line, '#');
+    if(comment)
+      *comment = '\0';
+
+    char target[16], action[32];
+    struct net_fault f;
+    f.b = -1;
+    f.bandwidth = 0;
+    int n = sscanf(line, "%lf %15s", &f.time, target);
+    if(n <= 0)
+      continue;
+    if(n == 2 && strcmp(target, "link") == 0) {
+      f.target = FAULT_LINK;
+      n = sscanf(line, "%*f %*s %d %d %31s", &f.a, &f.b, action) == 3;
+    } else if(n == 2 && strcmp(target, "router") == 0) {
+      f.target = FAULT_ROUTER;
+      n = sscanf(line, "%*f %*s %d %31s", &f.a, action) == 2;
+    } else
+      n = 0;
+
+    if(n) {
+      if(strcmp(action, "down") == 0)
+        f.action = FAULT_DOWN;
+      else if(strcmp(action, "up") == 0)
+        f.action = FAULT_UP;
+      else if(f.target == FAULT_LINK && sscanf(action, "%lf", &f.bandwidth) == 1
+          && f.bandwidth > 0)
+        f.action = FAULT_BANDWIDTH;
+      else
+        n = 0;
+    }
+    if(!n || f.time < 0 || f.a < 0 || f.a >= num_routers ||
+        (f.target == FAULT_LINK && (f.b < 0 || f.b >= num_routers)))
+      tw_error(TW_LOC, "%s:%d: expected \"<time> link <router> <router> "
+          "down|up|<bandwidth>\" or \"<time> router <router> down|up\"\n",
+          fname, lineno);
+
+    if(num == cap) {
+      cap *= 2;
+      list = realloc(list, cap * sizeof(struct net_fault));
+    }
+    /* keep the list sorted by time, entries with the same time in file
+     * order; schedules are short */
+    int at = num++;
+    while(at > 0 && list[at - 1].time > f.time) {
+      list[at] = list[at - 1];
+      at--;
+    }
+    list[at] = f;
+  }
+  fclose(fp);
+
+  *faults = list;
+  return num;
+}
+
+int net_fault_hits(const struct net_fault *f, int u, int v)
+{
+  if(f->target == FAULT_ROUTER)
+    return f->a == u || f->a == v;
+  return (f->a == u && f->b == v) || (f->a == v && f->b == u);
+}
+
+int net_link_down(const struct net_fault *faults, int n, int u, int v)
+{
+  int link_down = 0, u_down = 0, v_down = 0;
+  for(int k = 0; k < n; k++) {
+    const struct net_fault *f = &faults[k];
+    if(f->action == FAULT_BANDWIDTH || !net_fault_hits(f, u, v))
+      continue;
+    if(f->target == FAULT_LINK)
+      link_down = f->action == FAULT_DOWN;
+    else if(f->a == u)
+      u_down = f->action == FAULT_DOWN;
+    else
+      v_down = f->action == FAULT_DOWN;
+  }
+  return link_down || u_down || v_down;
+}
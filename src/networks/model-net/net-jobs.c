@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ross.h>
+#include "codes/codes.h"
+#include "codes/codes_mapping.h"
+#include "codes/configuration.h"
+#include "codes/codes-jobmap.h"
+#include "codes/net/net-jobs.h"
+
+void net_jobs_init(struct net_jobs *jobs, int force)
+{
+  char alloc_file[MAX_NAME_LENGTH];
+  alloc_file[0] = '\0';
+  configuration_get_value_relpath(&config, "PARAMS", "job_alloc_file", NULL,
+      alloc_file, MAX_NAME_LENGTH);
+  jobs->map = NULL;
+  jobs->num_jobs = 1;
+  if(alloc_file[0] != '\0') {
+    struct codes_jobmap_params_list jobmap_p;
+    jobmap_p.alloc_file = alloc_file;
+    jobs->map = codes_jobmap_configure(CODES_JOBMAP_LIST, &jobmap_p);
+    jobs->num_jobs = codes_jobmap_get_num_jobs(jobs->map);
+  }
+  jobs->enabled = jobs->map != NULL || force;
+  jobs->packets = calloc(jobs->num_jobs, sizeof(long));
+  jobs->latency = calloc(jobs->num_jobs, sizeof(double));
+  jobs->ideal = calloc(jobs->num_jobs, sizeof(double));
+}
+
+/* job of a terminal, -1 if it is in none */
+static int net_jobs_of(struct net_jobs *jobs, int terminal)
+{
+  if(!jobs->map)
+    return 0;
+  return codes_jobmap_to_local_id(terminal, jobs->map).job;
+}
+
+void net_jobs_packet(struct net_jobs *jobs, int src, double latency,
+    double ideal)
+{
+  int job = net_jobs_of(jobs, src);
+  if(job < 0)
+    return;
+  jobs->packets[job]++;
+  jobs->latency[job] += latency;
+  jobs->ideal[job] += ideal;
+}
+
+void net_jobs_packet_rc(struct net_jobs *jobs, int src, double latency,
+    double ideal)
+{
+  int job = net_jobs_of(jobs, src);
+  if(job < 0)
+    return;
+  jobs->packets[job]--;
+  jobs->latency[job] -= latency;
+  jobs->ideal[job] -= ideal;
+}
+
+void net_jobs_report(struct net_jobs *jobs)
+{
+  if(!jobs->enabled)
+    return;
+
+  long *packets = malloc(jobs->num_jobs * sizeof(long));
+  double *latency = malloc(jobs->num_jobs * sizeof(double));
+  double *ideal = malloc(jobs->num_jobs * sizeof(double));
+  MPI_Reduce(jobs->packets, packets, jobs->num_jobs, MPI_LONG, MPI_SUM, 0,
+      MPI_COMM_CODES);
+  MPI_Reduce(jobs->latency, latency, jobs->num_jobs, MPI_DOUBLE, MPI_SUM, 0,
+      MPI_COMM_CODES);
+  MPI_Reduce(jobs->ideal, ideal, jobs->num_jobs, MPI_DOUBLE, MPI_SUM, 0,
+      MPI_COMM_CODES);
+  if(!g_tw_mynode) {
+    for(int j = 0; j < jobs->num_jobs; j++) {
+      printf(" Job %d finished packets %ld average packet latency %lf us "
+          "slowdown %lf \n", j, packets[j],
+          packets[j] ? latency[j] / (packets[j] * 1000) : 0.0,
+          ideal[j] > 0 ? latency[j] / ideal[j] : 0.0);
+    }
+  }
+  free(packets);
+  free(latency);
+  free(ideal);
+}
@@ -124,6 +124,22 @@ void slim_delete_terminal_message_list(slim_terminal_message_list *this) {
     free(this);
 }
 
+/* Precomputed connectivity of one rail of the MMS graph. Built once per
+ * parameter set at configure time and shared by every LP of the process, so
+ * that path-length and next-hop queries on the packet path are constant-time
+ * lookups instead of connection rebuilds and channel scans. Router ids are
+ * rail-relative (0..num_routers-1); callers fold the rail offset in and out */
+struct slimfly_path_table
+{
+    int num_routers;        /* routers per rail */
+    int words;              /* uint64_t words per adjacency row */
+    uint64_t *adj;          /* num_routers rows of adjacency bits */
+    /* intm[src*num_routers+dst]: first neighbour of src, in the router's
+     * global-then-local channel order, that is directly connected to dst.
+     * The slimfly diameter is 2, so this always exists */
+    int *intm;
+};
+
 struct slimfly_param
 {
     int sf_type;
@@ -156,6 +172,7 @@ struct slimfly_param
     double router_delay;	/*Router processing delay moving packet from input port to output port*/
     double link_delay;		/*Network link latency. Currently encorporated into the arrival time*/
     int num_local_channels;
+    struct slimfly_path_table paths;
 };
 
 struct sfly_hash_key
@@ -189,7 +206,6 @@ struct terminal_state
 #if MSG_TIMES
     int * msg_send_times;
     int * msg_rail_select;
-    char output_buf2[4096];
 #endif
 
     int router_id;
@@ -228,7 +244,6 @@ struct terminal_state
     tw_stime *last_buf_full;
     tw_stime *busy_time;
 
-    char output_buf[512];
 };
 
 /* terminal event type (1-4) */
@@ -297,8 +312,6 @@ struct router_state
     tw_stime* busy_time;
     tw_stime* busy_time_sample;
 
-    char output_buf[4096];
-    char output_buf2[4096];
 
     int** vc_occupancy;
     int64_t* link_traffic;	//Aren't used
@@ -334,6 +347,7 @@ static void ross_slimfly_rsample_rc_fn(router_state * s, tw_bf * bf, tw_lp * lp,
 int get_path_length_from_terminal(int src, int dest, const slimfly_param *p);
 void get_router_connections(int src_router_id, int num_global_channels, int num_local_channels,
         int total_routers, int* local_channels, int* global_channels, int sf_type, const slimfly_param * p);
+static void slimfly_build_path_table(slimfly_param *p);
 
 st_model_types slimfly_model_types[] = {
     {(ev_trace_f) slimfly_event_collect,
@@ -687,6 +701,7 @@ static void slimfly_read_config(const char * anno, slimfly_param *params){
     p->global_delay = bytes_to_ns(p->chunk_size, p->global_bandwidth);
     p->credit_delay = bytes_to_ns(8.0, p->local_bandwidth); //assume 8 bytes packet
 
+    slimfly_build_path_table(p);
 }
 
 static void slimfly_configure(){
@@ -945,8 +960,7 @@ void slim_terminal_init( terminal_state * s,
     }
 
 #if SLIMFLY_CONNECTIONS
-    int written = 0;
-    written += sprintf(s->output_buf + written, "%d, %d, ", s->terminal_id, s->params->slim_total_terminals + s->router_id);
+    lp_io_fmt("%d, %d, ", s->terminal_id, s->params->slim_total_terminals + s->router_id);
 #endif
 
 // TODO: Reintroduce fitfly multi rail connection output
@@ -960,7 +974,7 @@ void slim_terminal_init( terminal_state * s,
 //     }
 
 #if SLIMFLY_CONNECTIONS
-    lp_io_write(lp->gid, "slimfly-config-terminal-connections", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "slimfly-config-terminal-connections");
 #endif
 
     if(s->terminal_id == 1723)
@@ -1132,16 +1146,15 @@ void slim_router_setup(router_state * r, tw_lp * lp)
 #endif
 
 #if SLIMFLY_CONNECTIONS
-    int written = 0;
     int i;
 
     for(i=0;i<r->params->num_local_channels;i++){
-        written += sprintf(r->output_buf + written, "%d, %d, ", r->params->slim_total_terminals + r->router_id, r->params->slim_total_terminals + r->local_channel[i]);
+        lp_io_fmt("%d, %d, ", r->params->slim_total_terminals + r->router_id, r->params->slim_total_terminals + r->local_channel[i]);
     }
     for(i=0;i<r->params->num_global_channels;i++){
-        written += sprintf(r->output_buf + written, "%d, %d, ", r->params->slim_total_terminals + r->router_id, r->params->slim_total_terminals + r->global_channel[i]);
+        lp_io_fmt("%d, %d, ", r->params->slim_total_terminals + r->router_id, r->params->slim_total_terminals + r->global_channel[i]);
     }
-    lp_io_write(lp->gid, "slimfly-config-router-connections", written, r->output_buf);
+    lp_io_fmt_write(lp->gid, "slimfly-config-router-connections");
 #endif
 
     return;
@@ -2134,32 +2147,30 @@ void slimfly_terminal_final( terminal_state * s,
 
     model_net_print_stats(lp->gid, s->slimfly_stats_array);
 
-    int written = 0;
     if(!s->terminal_id)
-        written = sprintf(s->output_buf, "# Format <LP id> <Terminal ID> <Total Data Size> <Total Packet Latency> <# Flits/Packets finished> <Packets Generated> <Avg hops> <Busy Time>\n");
+        lp_io_fmt("# Format <LP id> <Terminal ID> <Total Data Size> <Total Packet Latency> <# Flits/Packets finished> <Packets Generated> <Avg hops> <Busy Time>\n");
 
     tw_stime final_terminal_busy_time = 0;
     for(int i=0; i<s->params->num_injection_queues;i++){
         final_terminal_busy_time += s->busy_time[i];
     }
 
-    written += sprintf(s->output_buf + written, "%llu %u %llu %lf %ld %d %lf %lf\n",
+    lp_io_fmt("%llu %u %llu %lf %ld %d %lf %lf\n",
             LLU(lp->gid), s->terminal_id, LLU(s->total_msg_size), s->total_time,
             s->finished_packets, s->packet_gen, (double)s->total_hops/s->finished_chunks,
             final_terminal_busy_time);
 
-    lp_io_write(lp->gid, "slimfly-msg-stats", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "slimfly-msg-stats");
 
  //   if(s->terminal_msgs[0] != NULL)
  //     printf("[%llu] leftover terminal messages \n", LLU(lp->gid));
 
 #if MSG_TIMES
-    int written2 = 0;
     if(!s->terminal_id)
-        written2 = sprintf(s->output_buf2, " Format <Terminal ID> <Send Time> <Rail>\n");
+        lp_io_fmt(" Format <Terminal ID> <Send Time> <Rail>\n");
     for(int i=0; i<200; i++)
-        written2 += sprintf(s->output_buf2 + written2, "%u %d %d\n", s->terminal_id, s->msg_send_times[i], s->msg_rail_select[i]);
-    lp_io_write(lp->gid, "slimfly-msg-times",written2, s->output_buf2);
+        lp_io_fmt("%u %d %d\n", s->terminal_id, s->msg_send_times[i], s->msg_rail_select[i]);
+    lp_io_fmt_write(lp->gid, "slimfly-msg-times");
 #endif
 
     qhash_finalize(s->rank_tbl);
@@ -2190,7 +2201,6 @@ void slimfly_router_final(router_state * s,
         }
     }
     rc_stack_destroy(s->st);
-    int written = 0;
     if(s->router_id == 0)
     {
         /* write metadata file */
@@ -2202,34 +2212,32 @@ void slimfly_router_final(router_state * s,
                   fprintf(fp, "# Router ports in the order: %d local channels, %d global channels", 
                   p->num_routers, p->num_global_channels);
                   fclose(fp);
-                  */        written = sprintf(s->output_buf,"# Format <LP ID> <Group ID> <Router ID> <Busy time per router port(s)>");
+                  */        lp_io_fmt("# Format <LP ID> <Group ID> <Router ID> <Busy time per router port(s)>");
     }
-    written += sprintf(s->output_buf + written, "\n %llu %d %d", 
+    lp_io_fmt("\n %llu %d %d", 
             LLU(lp->gid),
             s->group_id,
             s->router_id);
     for(int d = 0; d < s->params->radix; d++) 
-        written += sprintf(s->output_buf + written, " %lf", s->busy_time[d]);
+        lp_io_fmt(" %lf", s->busy_time[d]);
 
-    lp_io_write(lp->gid, "slimfly-router-stats", written, s->output_buf);
+    lp_io_fmt_write(lp->gid, "slimfly-router-stats");
 
-    written = 0;
     if(!s->router_id)
     {
-        written = sprintf(s->output_buf2, "# Format <LP ID> <Group ID> <Router ID> <Link traffic per router port(s)>");
-        written += sprintf(s->output_buf2 + written, "# Router ports in the order: %d local channels, %d global channels",
+        lp_io_fmt("# Format <LP ID> <Group ID> <Router ID> <Link traffic per router port(s)>");
+        lp_io_fmt("# Router ports in the order: %d local channels, %d global channels",
                 s->params->num_local_channels, s->params->num_global_channels);
     }
-    written += sprintf(s->output_buf2 + written, "\n %llu %d %d",
+    lp_io_fmt("\n %llu %d %d",
             LLU(lp->gid),
             s->group_id,
             s->router_id);
 
     for(int d = 0; d < s->params->radix; d++) 
-        written += sprintf(s->output_buf2 + written, " %lld", LLD(s->link_traffic[d]));
+        lp_io_fmt(" %lld", LLD(s->link_traffic[d]));
 
-    assert(written < 4096);
-    lp_io_write(lp->gid, "slimfly-router-traffic", written, s->output_buf2);
+    lp_io_fmt_write(lp->gid, "slimfly-router-traffic");
 }
 
 
@@ -2387,37 +2395,72 @@ void get_router_connections(int src_router_id, int num_global_channels, int num_
     assert(global_idx == num_global_channels);
 }
 
-/** Get the length (number of hops) in the route/path from a source terminal to dest router
- *  @param[in] dest         Local/relative ID of the destination router
- *  @param[in] src          Local/relative ID of the source terminal
- *  @param[out] num_hops 	number of hops in the minimal path/route
- */
-int get_path_length_from_terminal(int src, int dest, const slimfly_param *p)
+/* rail-relative adjacency test on the precomputed table */
+static inline int sf_adjacent(const struct slimfly_path_table *t, int src, int dest)
 {
-    int *local_channel = (int*) calloc(p->num_local_channels,sizeof(int)); //NM TODO: DYNAMIC ALLOCS ARE TIME EXPENSIVE - this function is called every packet generate?!
-    int *global_channel = (int*) calloc(p->num_global_channels,sizeof(int));
-    get_router_connections(src, p->num_global_channels, p->num_local_channels,
-            p->slim_total_routers, local_channel, global_channel, p->sf_type,p);
-    int i, num_hops=2;
-    for(i=0;i<p->num_global_channels;i++)
+    return (t->adj[(size_t)src * t->words + (dest >> 6)] >> (dest & 63)) & 1;
+}
+
+/* Build the per-rail adjacency bitsets and the all-pairs intermediate router
+ * table from the same MMS construction the routers wire themselves with */
+static void slimfly_build_path_table(slimfly_param *p)
+{
+    struct slimfly_path_table *t = &p->paths;
+    int n = p->slim_total_routers;
+    int nglobal = p->num_global_channels;
+    int nlocal = p->num_local_channels;
+    int *channels = malloc((nglobal + nlocal) * sizeof(int));
+    int src, dest, k;
+
+    t->num_routers = n;
+    t->words = (n + 63) / 64;
+    t->adj = calloc((size_t)n * t->words, sizeof(uint64_t));
+    t->intm = malloc((size_t)n * n * sizeof(int));
+    assert(channels && t->adj && t->intm);
+
+    for(src = 0; src < n; src++)
     {
-        if(global_channel[i] == dest)
-        {
-            num_hops = 1;
-        }
+        /* one rail is enough, the others are copies shifted by a rail offset */
+        get_router_connections(src, nglobal, nlocal, n, &channels[nglobal],
+                channels, 0, p);
+        for(k = 0; k < nglobal + nlocal; k++)
+            t->adj[(size_t)src * t->words + (channels[k] >> 6)] |=
+                (uint64_t)1 << (channels[k] & 63);
     }
-    for(i=0;i<p->num_local_channels;i++)
+
+    for(src = 0; src < n; src++)
     {
-        if(local_channel[i] == dest)
+        get_router_connections(src, nglobal, nlocal, n, &channels[nglobal],
+                channels, 0, p);
+        for(dest = 0; dest < n; dest++)
         {
-            num_hops = 1;
+            int m = -1;
+            for(k = 0; k < nglobal + nlocal; k++)
+            {
+                if(sf_adjacent(t, channels[k], dest))
+                {
+                    m = channels[k];
+                    break;
+                }
+            }
+            t->intm[(size_t)src * n + dest] = m;
         }
     }
+    free(channels);
+}
 
-    free(local_channel);
-    free(global_channel);
-
-    return num_hops;
+/** Get the length (number of hops) in the route/path from a source terminal to dest router
+ *  @param[in] dest         Local/relative ID of the destination router
+ *  @param[in] src          Local/relative ID of the source terminal
+ *  @param[out] num_hops 	number of hops in the minimal path/route
+ */
+int get_path_length_from_terminal(int src, int dest, const slimfly_param *p)
+{
+    const struct slimfly_path_table *t = &p->paths;
+    /* routers on different rails are never directly connected */
+    if(src / t->num_routers != dest / t->num_routers)
+        return 2;
+    return sf_adjacent(t, src % t->num_routers, dest % t->num_routers) ? 1 : 2;
 }
 
 /** Get the length (number of hops) in the route/path starting with a local src router to ending dest router
@@ -2427,22 +2470,7 @@ int get_path_length_from_terminal(int src, int dest, const slimfly_param *p)
  */
 int get_path_length_local(router_state * src, int dest)
 {
-    int i, num_hops=2;
-    for(i=0;i<src->params->num_global_channels;i++)
-    {
-        if(src->global_channel[i] == dest)
-        {
-            num_hops = 1;
-        }
-    }
-    for(i=0;i<src->params->num_local_channels;i++)
-    {
-        if(src->local_channel[i] == dest)
-        {
-            num_hops = 1;
-        }
-    }
-    return num_hops;
+    return get_path_length_from_terminal(src->router_id, dest, src->params);
 }
 
 void get3DCoordinates(int router_id, int *s, int *i, int *j, router_state * r)
@@ -2471,472 +2499,44 @@ void get3DCoordinates(int router_id, int *s, int *i, int *j, router_state * r)
  */
 int get_path_length_global(int src, int dest, router_state * r)
 {
-    int j,num_hops=2;
-    int s_s,s_d,i_s,i_d,j_s,j_d;
-    // Get corresponding graph coordinates for source and destination routers
-    get3DCoordinates(src,&s_s,&i_s,&j_s,r);
-    get3DCoordinates(dest,&s_d,&i_d,&j_d,r);
-
-    if(s_s == s_d)
-    {
-        if(s_s == 0)
-        {
-            //Case 1a local connection same subgroup 0
-            for(j=0;j<X_size;j++)
-            {
-                if(abs(j_s-j_d) == X[j])
-                {
-                    num_hops = 1;
-                    break;
-                }
-            }
-        }
-        else
-        {
-            //Case 1b local connection same subgroup 1
-            for(j=0;j<X_size;j++)
-            {
-                if(abs(j_s-j_d) == X_prime[j])
-                {
-                    num_hops = 1;
-                    break;
-                }
-            }
-        }
-    }
-    else
-    {
-        if(s_s == 0)
-        {
-            //Case 1c global connection s_s=0, s_d=1
-            if(j_s == (i_d*i_s+j_d) % r->params->num_routers)
-            {
-                num_hops = 1;
-            }
-        }
-        else
-        {
-            //Case 1d global connection s_s=1, s_d=0
-            if(j_d == (i_s*i_d+j_s) % r->params->num_routers)
-            {
-                num_hops = 1;
-            }
-        }
-    }
-    return num_hops;
-}
-
-/** Get the next router along the minimal path to the destination using the 3 paper connection equations
- *  Cases:
- *     1. Rs is directly connected to Rd.
- *       a. Subgraph 0 local connection
- *       b. Subgraph 1 local connection
- *       c. Subgraph 0 global connection to subgraph 1
- *       d. Subgraph 1 global connection to subgraph 0
- *     2. Rs is indirectly connected to Rd in separate subgraphs. (global and local path)
- *       a. Rs local to Rm and global to Rd. Rs and Rm in subgraph 0. Rd in subgraph 1.
- *       b. Rs global to Rm and local to Rd. Rs in subgraph 0. Rd and Rm in subgraph 1.
- *       c. Rs local to Rm and global to Rd. Rs and Rm in subgraph 1. Rd in subgraph 0.
- *       d. Rs global to Rm and local to Rd. Rs in subgraph 1. Rd and Rs in subgraph 0.
- *     3. Rs and Rd are in same group connected through Rm also in same group. (2 local paths)
- *       a. All in subgraph 0.
- *       b. All in subgraph 1.
- *     4. Rs and Rd in same subgraph globally connected to intermediate router in other subgraph (2 global paths)
- *       a. Rs and Rd in subgraph 0. Rm in subgraph 1.
- *       b. Rs and Rd in subgraph 1. Rm in subgraph 0.
+    const struct slimfly_path_table *t = &r->params->paths;
+    return sf_adjacent(t, src % t->num_routers, dest % t->num_routers) ? 1 : 2;
+}
+
+/** Get the next router along the minimal path to the destination.
+ *  Cases (from the MMS connection equations):
+ *     1. Rs is directly connected to Rd: the next stop is Rd.
+ *     2. Rs and Rd are in separate subgraphs: one local and one global hop
+ *        through Rm.
+ *     3. Rs and Rd are in the same group: two local hops through Rm in that
+ *        group.
+ *     4. Rs and Rd are in the same subgraph but different groups: two global
+ *        hops through Rm in the other subgraph.
+ *  Since the slimfly diameter is 2, all cases reduce to a lookup in the
+ *  precomputed path table: Rd itself if it is adjacent, otherwise the first
+ *  of Rs's neighbours (global channels first, then local) adjacent to Rd.
  *  @param[in] rid The ID for the destination router
  *  @param[in] r   The state for the current router
  *  @param[out] router_id The ID for a router in the destination router group
  */
-//////////////////////////////////////// Get router in the group which has a global channel to group id gid /////////////////////////////////
 tw_lpid getMinimalRouterFromEquations(slim_terminal_message * msg, int rid, router_state * r)
 {
-    int s_s,s_d,i_s,i_d,j_s,j_d;
-    int i,j;
-    int match = 0;
-    tw_lpid router_id = 0;
-    // Get corresponding graph coordinates for source and destination routers
-    get3DCoordinates((int)r->router_id,&s_s,&i_s,&j_s,r);
-    get3DCoordinates(rid,&s_d,&i_d,&j_d,r);
-#if DEBUG_ROUTING
-    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-    {
-        printf("source:%d, s_s:%d, i_s:%d, j_s:%d\n",(int)r->router_id,s_s, i_s, j_s);
-        printf("destination:%d s_d:%d, i_d:%d, j_d:%d\n",rid,s_d, i_d, j_d);
-    }
-#endif
+    const struct slimfly_path_table *t = &r->params->paths;
+    int n = t->num_routers;
+    int rail_base = ((int)r->router_id / n) * n;
+    int src = (int)r->router_id % n;
+    int intm;
 
-    // Check for case 1
-    for(i=0;i<r->params->num_local_channels;i++)
-    {
-#if DEBUG_ROUTING
-        if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-        {
-            printf("comparing local:%d with dest:%d\n",r->local_channel[i],rid);
-        }
-#endif
-        if(r->local_channel[i] == rid)
-        {
-            router_id = rid;
-            match = 1; 				// Case 1a and 1b
-#if DEBUG_ROUTING
-            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-            {
-                printf("match:%d case:1a/1b\n",(int)router_id);
-            }
-#endif
-            break;
-        }
-    }
-    if(match == 0)
-    {
-        for(i=0;i<r->params->num_global_channels;i++)
-        {
-#if DEBUG_ROUTING
-            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-            {
-                printf("comparing global:%d with dest:%d\n",r->global_channel[i],rid);
-            }
-#endif
-            if(r->global_channel[i] == rid)
-            {
-                router_id = rid;
-                match = 1;			// Case 1c
-#if DEBUG_ROUTING
-                if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                {
-                    printf("match case:1c\n");
-                }
-#endif
-                break;
-            }
-        }
-    }
-    if(match == 0)
-    {
-        //Loop over all global and local connections
-        for(i=0;i<r->params->num_global_channels+r->params->num_local_channels;i++)
-        {
-            int s_m,i_m,j_m;
-            if(i<r->params->num_global_channels)
-            {
-                get3DCoordinates(r->global_channel[i],&s_m,&i_m,&j_m,r);
-            }
-            else
-            {
-                get3DCoordinates(r->local_channel[i-r->params->num_global_channels],&s_m,&i_m,&j_m,r);
-            }
-#if DEBUG_ROUTING
-            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-            {
-                printf("possible case 2,3,4\n");
-                if(i<r->params->num_global_channels)
-                {
-                    printf("global_id:%d, s_m:%d, i_m:%d, j_m:%d\n",(int)r->global_channel[i%GLOBAL_CHANNELS],s_m, i_m, j_m);
-                    printf("case 4b,2a result comparing global%d and dest%d: %d=%d\n",r->global_channel[i%GLOBAL_CHANNELS],rid,j_m,(i_d*i_m+j_d) % NUM_ROUTER);
-                    printf("case 4a,2c result comparing global%d and dest%d: %d=%d\n",r->global_channel[i%GLOBAL_CHANNELS],rid,j_d,(i_m*i_d+j_m) % NUM_ROUTER);
-                }
-                else
-                {
-                    printf("local_id:%d, s_m:%d, i_m:%d, j_m:%d\n",(int)r->local_channel[i%GLOBAL_CHANNELS],s_m, i_m, j_m);
-                    printf("case 4b,2a result comparing local%d and dest%d: %d=%d\n",r->local_channel[i%GLOBAL_CHANNELS],rid,j_m,(i_d*i_m+j_d) % NUM_ROUTER);
-                    printf("case 4a,2c result comparing local%d and dest%d: %d=%d\n",r->local_channel[i%GLOBAL_CHANNELS],rid,j_d,(i_m*i_d+j_m) % NUM_ROUTER);
-                }
-            }
-#endif
-            if(s_s == s_d)
-            {
-                if(s_s == s_m)
-                {
-                    if(s_s == 0)
-                    {
-                        if(i_m == i_d && i_m == i_s)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:3a\n");
-                            }
-#endif
-                            for(j=0;j<X_size;j++)
-                            {
-                                if(abs(j_m-j_d) == X[j])
-                                {
-                                    if(i<r->params->num_global_channels)
-                                    {
-                                        router_id = r->global_channel[i];
-                                    }
-                                    else
-                                    {
-                                        router_id = r->local_channel[i-r->params->num_global_channels];
-                                    }
-                                    match = 1;			// Case 3a
-#if DEBUG_ROUTING
-                                    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                    {
-                                        printf("match case:3a\n");
-                                    }
-#endif
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if(i_m == i_d && i_m == i_s)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:3b\n");
-                            }
-#endif
-                            for(j=0;j<X_size;j++)
-                            {
-                                if(abs(j_m-j_d) == X_prime[j])
-                                {
-                                    if(i<r->params->num_global_channels)
-                                    {
-                                        router_id = r->global_channel[i];
-                                    }
-                                    else
-                                    {
-                                        router_id = r->local_channel[i-r->params->num_global_channels];
-                                    }
-                                    match = 1;			// Case 3b
-#if DEBUG_ROUTING
-                                    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                    {
-                                        printf("match case:3b\n");
-                                    }
-#endif
-                                }
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    if(s_s == 0)
-                    {
-#if DEBUG_ROUTING
-                        if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                        {
-                            printf("possible case:4a\n");
-                        }
-#endif
-                        if(j_d == (i_m*i_d+j_m) % r->params->num_routers)
-                        {
-                            if(i<r->params->num_global_channels)
-                            {
-                                router_id = r->global_channel[i];
-                            }
-                            else
-                            {
-                                router_id = r->local_channel[i-r->params->num_global_channels];
-                            }
-                            match = 1;				// Case 4a
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("match case:4a\n");
-                            }
-#endif
-                            break;
-                        }
+    if(rid / n == (int)r->router_id / n && sf_adjacent(t, src, rid % n))
+        return rid;
 
-                    }
-                    else
-                    {
-#if DEBUG_ROUTING
-                        if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                        {
-                            printf("possible case:4b\n");
-                        }
-#endif
-                        if(j_m == (i_d*i_m+j_d) % r->params->num_routers)
-                        {
-                            if(i<r->params->num_global_channels)
-                            {
-                                router_id = r->global_channel[i];
-                            }
-                            else
-                            {
-                                router_id = r->local_channel[i-r->params->num_global_channels];
-                            }
-                            match = 1;				// Case 4b
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("match case:4b\n");
-                            }
-#endif
-                            break;
-                        }
-                    }
-                }
-            }
-            else
-            {
-                if(s_s == s_m)
-                {
-                    if(s_s == 0)
-                    {
-                        if(i_m == i_s)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:2a\n");
-                            }
-#endif
-                            if(j_m == (i_d*i_m+j_d) % r->params->num_routers)
-                            {
-                                if(i<r->params->num_global_channels)
-                                {
-                                    router_id = r->global_channel[i];
-                                }
-                                else
-                                {
-                                    router_id = r->local_channel[i-r->params->num_global_channels];
-                                }
-                                match = 1;				// Case 2a
-#if DEBUG_ROUTING
-                                if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                {
-                                    printf("match case:2a\n");
-                                }
-#endif
-                                break;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if(i_m == i_s)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:2c\n");
-                            }
-#endif
-                            if(j_d == (i_m*i_d+j_m) % r->params->num_routers)
-                            {
-                                if(i<r->params->num_global_channels)
-                                {
-                                    router_id = r->global_channel[i];
-                                }
-                                else
-                                {
-                                    router_id = r->local_channel[i-r->params->num_global_channels];
-                                }
-                                match = 1;				// Case 2c
-#if DEBUG_ROUTING
-                                if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                {
-                                    printf("match case:2c\n");
-                                }
-#endif
-                                break;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    if(s_s == 0)
-                    {
-                        if(i_m == i_d)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:2b\n");
-                            }
-#endif
-                            for(j=0;j<X_size;j++)
-                            {
-                                if(abs(j_d-j_m) == X_prime[j])
-                                {
-                                    if(i<r->params->num_global_channels)
-                                    {
-                                        router_id = r->global_channel[i];
-                                    }
-                                    else
-                                    {
-                                        router_id = r->local_channel[i-r->params->num_global_channels];
-                                    }
-                                    match = 1;			// Case 2b
-#if DEBUG_ROUTING
-                                    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                    {
-                                        printf("match case:2b\n");
-                                    }
-#endif
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        if(i_m == i_d)
-                        {
-#if DEBUG_ROUTING
-                            if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                            {
-                                printf("possible case:2d\n");
-                            }
-#endif
-                            for(j=0;j<X_size;j++)
-                            {
-                                if(abs(j_m-j_d) == X[j])
-                                {
-                                    if(i<r->params->num_global_channels)
-                                    {
-                                        router_id = r->global_channel[i];
-                                    }
-                                    else
-                                    {
-                                        router_id = r->local_channel[i-r->params->num_global_channels];
-                                    }
-                                    match = 1;			// Case 2d
-#if DEBUG_ROUTING
-                                    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-                                    {
-                                        printf("match case:2d\n");
-                                    }
-#endif
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            if(match==1)
-                break;
-        }
-    }
-#if DEBUG_ROUTING
-    if( msg->packet_ID == TRACK && msg->chunk_id == num_chunks-1)
-    {
-        if(match == 1)
-        {
-            printf("source:%d destination:%d match:%d\n",(int)r->router_id,rid,(int)router_id);
-        }
-        else
-        {
-            printf("source:%d destination:%d no match so defaulting to router:%d\n",(int)r->router_id,rid,(int)router_id);
-        }
-    }
-#endif
-    if(match == 0 && (int)r->router_id != 0)
+    intm = t->intm[(size_t)src * n + rid % n];
+    if(intm < 0)
     {
-        printf("packet_ID:%d source:%d destination:%d no match so defaulting to router:%d\n",(int)msg->packet_ID,(int)r->router_id,rid,(int)router_id);
+        printf("packet_ID:%d source:%d destination:%d no match so defaulting to router:0\n",(int)msg->packet_ID,(int)r->router_id,rid);
+        return 0;
     }
-    return router_id;
+    return rail_base + intm;
 }
 
 /* get the next stop for the current packet
@@ -3121,14 +2721,14 @@ static int do_adaptive_routing( router_state * s,
         int * intm_id)
 {
     int i;
-    int *nonmin_out_port = (int *)malloc(num_indirect_routes * sizeof(int));
-    int *num_nonmin_hops = (int *)malloc(num_indirect_routes * sizeof(int));
-    int *nonmin_port_count = (int *)malloc(num_indirect_routes * sizeof(int));
+    int nonmin_out_port[num_indirect_routes];
+    int num_nonmin_hops[num_indirect_routes];
+    int nonmin_port_count[num_indirect_routes];
     int next_stop;
     int minimal_out_port = -1;
-    float *cost_nonminimal = (float *)(int *)malloc(num_indirect_routes * sizeof(float));
+    float cost_nonminimal[num_indirect_routes];
     float cost_minimal;
-    tw_lpid *nonmin_next_stop_lp_id = (tw_lpid *)malloc(num_indirect_routes * sizeof(tw_lpid));
+    tw_lpid nonmin_next_stop_lp_id[num_indirect_routes];
     tw_lpid minimal_next_stop_lp_id;
 
     int rail_id = msg->rail_id;
@@ -3314,7 +2914,7 @@ slim_router_packet_receive( router_state * s,
         dest_router_rel_id = default_rail_dest_router_rel_id;
 
     int intm_id = -1;
-    int *intm_router;		//Array version of intm_id for use in Adaptive routing
+    int intm_router[num_indirect_routes];		//Array version of intm_id for use in Adaptive routing
     int local_grp_id = (s->router_id % s->params->slim_total_routers) / s->params->num_routers;
     
     slim_terminal_message_list * cur_chunk = (slim_terminal_message_list *)calloc(1, 
@@ -3352,7 +2952,7 @@ slim_router_packet_receive( router_state * s,
             cur_chunk->msg.path_type = MINIMAL; /*defaults to the routing algorithm if we don't have adaptive routing here*/
             next_stop = slim_get_next_stop(s, bf, &(cur_chunk->msg), lp, cur_chunk->msg.path_type, dest_router_rel_id, intm_id);
         }else{
-            intm_router = (int *)malloc(num_indirect_routes * sizeof(int)); 	//indirect == nonMinimal == valiant
+            //indirect == nonMinimal == valiant
             //Generate n_I many indirect routes through intermediate random routers
             bf->c5 = 1;
             for(i=0;i<num_indirect_routes;i++)
@@ -3376,7 +2976,6 @@ slim_router_packet_receive( router_state * s,
                 }
             }
             next_stop = do_adaptive_routing(s, &(cur_chunk->msg), lp, dest_router_rel_id, intm_router);
-            free(intm_router);
         }
     }
     else
@@ -4044,6 +3643,8 @@ struct model_net_method slimfly_method =
     NULL,
     slimfly_register_model_types,
     slimfly_get_cn_model_types,
+    NULL, // partition hint
+    NULL, // lookahead
 };
 
 struct model_net_method slimfly_router_method =
@@ -4066,6 +3667,8 @@ struct model_net_method slimfly_router_method =
     NULL,
     slimfly_router_register_model_types,
     slimfly_get_router_model_types,
+    NULL, // partition hint
+    NULL, // lookahead
 };
 
 
@@ -6,6 +6,7 @@
 
 #include <ross.h>
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 #include "codes/lp-io.h"
@@ -15,7 +16,11 @@
 #include "codes/model-net-method.h"
 #include "codes/model-net-lp.h"
 #include "codes/net/torus.h"
+#include "codes/net/net-faults.h"
+#include "codes/net/net-jobs.h"
 #include "codes/rc-stack.h"
+#include "codes/quickhash.h"
+#include "codes/jenkins-hash.h"
 
 #ifdef ENABLE_CORTEX
 #include <cortex/cortex.h>
@@ -29,6 +34,11 @@
 #define TRACK ((tw_lpid)(-1))
 
 #define STATICQ 0
+/* second virtual channel: the adaptive channel with adaptive routing, the
+ * second phase with valiant routing */
+#define ADAPTIVEQ 1
+/* index of a (queue, virtual channel) pair in other_msgs */
+#define OTHERQ(s, queue, vc) ((queue) * (s)->params->num_vc + (vc))
 /* collective specific parameters */
 #define TREE_DEGREE 4
 #define LEVEL_DELAY 1000
@@ -40,6 +50,9 @@
 #define LP_CONFIG_NM (model_net_lp_config_names[TORUS])
 #define LP_METHOD_NM (model_net_method_names[TORUS])
 
+/* buckets of the tables of partly arrived packets and messages */
+#define TORUS_HASH_TABLE_SIZE 4999
+
 #ifdef ENABLE_CORTEX
 /* This structure is defined at the end of the file */
 extern cortex_topology torus_cortex_topology;
@@ -47,6 +60,19 @@ extern cortex_topology torus_cortex_topology;
 
 static double maxd(double a, double b) { return a < b ? b : a; }
 
+/* routing algorithms (PARAMS:routing) */
+enum torus_routing
+{
+    /* dimension-order routing on a single bubble channel */
+    TORUS_ROUTING_STATIC = 0,
+    /* minimal adaptive routing on the adaptive channel, dimension-order
+     * routing on the bubble escape channel */
+    TORUS_ROUTING_ADAPTIVE,
+    /* dimension-order routing to a random node on the first channel, then to
+     * the destination on the second one */
+    TORUS_ROUTING_VALIANT
+};
+
 /* Torus network model implementation of codes, implements the modelnet API */
 typedef struct nodes_message_list nodes_message_list;
 struct nodes_message_list {
@@ -76,6 +102,73 @@ static void free_tmp(void * ptr)
 
     free(entry);
 }
+
+/* With adaptive and Valiant routing the chunks of a packet, and the packets
+ * of a message, can overtake each other. The destination keeps what has
+ * arrived so far of the packets and messages that are not complete yet:
+ * chunks per packet, bytes per message. */
+struct torus_hash_key
+{
+    tw_lpid sender_node;
+    uint64_t id; /* packet_ID or message_id */
+};
+
+struct torus_hash_entry
+{
+    struct torus_hash_key key;
+    uint64_t count;
+    /* message table: completion event, carried by the last packet */
+    char * remote_event_data;
+    int remote_event_size;
+    struct qhash_head hash_link;
+};
+
+static int torus_hash_compare(void *key, struct qhash_head *link)
+{
+    struct torus_hash_key *k = key;
+    struct torus_hash_entry *tmp =
+        qhash_entry(link, struct torus_hash_entry, hash_link);
+
+    return tmp->key.id == k->id && tmp->key.sender_node == k->sender_node;
+}
+
+static int torus_hash_func(void *k, int table_size)
+{
+    uint32_t pc = 0, pb = 0;
+    bj_hashlittle2(k, sizeof(struct torus_hash_key), &pc, &pb);
+    return (int)(pc % (table_size - 1));
+}
+
+static void torus_hash_entry_free(void * ptr)
+{
+    struct torus_hash_entry * entry = ptr;
+    free(entry->remote_event_data);
+    free(entry);
+}
+
+/* entry of key, created if needed (*added is then set) */
+static struct torus_hash_entry * torus_hash_get(struct qhash_table * tbl,
+        struct torus_hash_key * key, int * added)
+{
+    struct qhash_head * link = qhash_search(tbl, key);
+    *added = 0;
+    if(link)
+        return qhash_entry(link, struct torus_hash_entry, hash_link);
+
+    struct torus_hash_entry * entry = calloc(1, sizeof(*entry));
+    entry->key = *key;
+    qhash_add(tbl, key, &entry->hash_link);
+    *added = 1;
+    return entry;
+}
+
+static struct torus_hash_entry * torus_hash_find(struct qhash_table * tbl,
+        struct torus_hash_key * key)
+{
+    struct qhash_head * link = qhash_search(tbl, key);
+    assert(link);
+    return qhash_entry(link, struct torus_hash_entry, hash_link);
+}
 typedef struct torus_param torus_param;
 struct torus_param
 {
@@ -100,7 +193,13 @@ struct torus_param
     double cn_delay;
 
     double router_delay;
+    /* routing algorithm, one of torus_routing */
     int routing;
+    /* number of torus nodes */
+    int num_nodes;
+    /* failure schedule (codes/net/net-faults.h), by flat node id */
+    int num_faults;
+    struct net_fault *faults;
 };
 
 /* codes mapping group name, lp type name */
@@ -117,6 +216,8 @@ static tw_stime         max_collective = 0;
 static long long       N_finished_packets = 0;
 /* total number of hops traversed by a message on each PE */
 static long long       total_hops = 0;
+/* per-job packet latencies, for the slowdown report */
+static struct net_jobs jobs;
 
 /* annotation-specific parameters (unannotated entry occurs at the
  * last index) */
@@ -157,8 +258,13 @@ struct nodes_state
   /* coordinates of the current torus node */
   int* dim_position;
   /* neighbor LP ids for this torus node */
-  int* neighbour_minus_lpID;
-  int* neighbour_plus_lpID;
+  tw_lpid* neighbour_minus_lpID;
+  tw_lpid* neighbour_plus_lpID;
+  /* flat id of the neighbour of each queue, and whether its link is up */
+  int *port_node;
+  char *port_up;
+  /* number of entries of the failure schedule in force */
+  int faults_applied;
 
   /* records torus statistics for this LP having different communication categories */
   struct mn_stats torus_stats_array[CATEGORY_MAX];
@@ -197,6 +303,10 @@ struct nodes_state
    /* create the RC stack */
    struct rc_stack * st;
 
+   /* packets and messages partly arrived at this node */
+   struct qhash_table * packet_tbl;
+   struct qhash_table * msg_tbl;
+
    /* finished chunks */
    long finished_chunks;
 
@@ -211,9 +321,6 @@ struct nodes_state
 
    /* total data */
    long total_data_sz;
-   /* output buf */
-   char output_buf[2048];
-   char output_busy_buf[2048];
 
    /* busy time */
    tw_stime * busy_time;
@@ -295,6 +402,24 @@ static tw_stime bytes_to_ns(uint64_t bytes, double GB_p_s)
     return(time);
 }
 
+/* returns 1 if torus nodes a and b (flat ids) are linked: their coordinates
+ * differ in one dimension only, by one around the ring */
+static int torus_neighbours(const torus_param * p, int a, int b)
+{
+    int dims = 0;
+    for (int i = 0; i < p->n_dims; i++) {
+        int len = p->dim_length[i];
+        int delta = (b % len - a % len + len) % len;
+        if (delta == 1 || delta == len - 1)
+            dims++;
+        else if (delta != 0)
+            return 0;
+        a /= len;
+        b /= len;
+    }
+    return dims == 1;
+}
+
 static void torus_read_config(
         const char         * anno,
         torus_param        * params){
@@ -311,6 +436,9 @@ static void torus_read_config(
                 "Warning: Number of dimensions not specified, setting to %d\n",
                 p->n_dims);
     }
+    if(p->n_dims <= 0 || p->n_dims > TORUS_MAX_DIMS)
+        tw_error(TW_LOC, "Invalid number of torus dimensions %d (1 to %d "
+                "supported)", p->n_dims, TORUS_MAX_DIMS);
 
    rc = configuration_get_value_double(&config, "PARAMS", "link_bandwidth", anno,
             &p->link_bandwidth);
@@ -334,9 +462,22 @@ static void torus_read_config(
         fprintf(stderr, "Warning: Chunk size not specified, setting to %d\n",
                 p->chunk_size);
     }
-        /* by default, we have one for taking packets,
-         * another for taking credit*/
-        p->num_vc = 1;
+    char routing_str[MAX_NAME_LENGTH];
+    rc = configuration_get_value(&config, "PARAMS", "routing", anno,
+            routing_str, MAX_NAME_LENGTH);
+    if(rc <= 0 || strcmp(routing_str, "static") == 0)
+        p->routing = TORUS_ROUTING_STATIC;
+    else if(strcmp(routing_str, "adaptive") == 0)
+        p->routing = TORUS_ROUTING_ADAPTIVE;
+    else if(strcmp(routing_str, "valiant") == 0)
+        p->routing = TORUS_ROUTING_VALIANT;
+    else
+        tw_error(TW_LOC, "Unknown torus routing %s (static, adaptive or "
+                "valiant)", routing_str);
+
+    /* static routing uses the bubble channel only, the other algorithms add
+     * a second channel */
+    p->num_vc = p->routing == TORUS_ROUTING_STATIC ? 1 : 2;
 
     rc = configuration_get_value(&config, "PARAMS", "dim_length", anno,
             dim_length_str, MAX_NAME_LENGTH);
@@ -367,6 +508,7 @@ static void torus_read_config(
     p->factor[0] = 1;
     for(i = 1; i < p->n_dims; i++)
         p->factor[i] = p->factor[i-1] * p->dim_length[i-1];
+    p->num_nodes = p->factor[p->n_dims-1] * p->dim_length[p->n_dims-1];
 
     p->half_length = malloc(p->n_dims * sizeof(int));
     for (i = 0; i < p->n_dims; i++)
@@ -375,6 +517,27 @@ static void torus_read_config(
     // some latency numbers
     p->head_delay = bytes_to_ns(p->chunk_size, p->link_bandwidth);
     p->credit_delay = bytes_to_ns(8, p->link_bandwidth);
+
+    char failure_file[MAX_NAME_LENGTH];
+    failure_file[0] = '\0';
+    configuration_get_value_relpath(&config, "PARAMS", "failure_file", anno,
+            failure_file, MAX_NAME_LENGTH);
+    p->num_faults = 0;
+    p->faults = NULL;
+    if(failure_file[0] != '\0') {
+        p->num_faults = net_read_faults(failure_file, p->num_nodes, &p->faults);
+        for(i = 0; i < p->num_faults; i++) {
+            const struct net_fault *f = &p->faults[i];
+            if(f->action == FAULT_BANDWIDTH)
+                tw_error(TW_LOC, "%s: torus links only go down or up, not to "
+                        "another bandwidth\n", failure_file);
+            if(f->target == FAULT_LINK && !torus_neighbours(p, f->a, f->b))
+                tw_error(TW_LOC, "%s: torus nodes %d and %d are not "
+                        "neighbours\n", failure_file, f->a, f->b);
+        }
+        if(!g_tw_mynode) printf("Torus failure schedule %s: %d entries\n",
+                failure_file, p->num_faults);
+    }
 }
 
 static void torus_configure(){
@@ -390,6 +553,7 @@ static void torus_configure(){
     if (anno_map->has_unanno_lp > 0){
         torus_read_config(NULL, &all_params[anno_map->num_annos]);
     }
+    net_jobs_init(&jobs, all_params[0].num_faults > 0);
 #ifdef ENABLE_CORTEX
 	model_net_topology = torus_cortex_topology;
 #endif
@@ -517,7 +681,10 @@ static tw_stime torus_packet_event(
     msg->dest_lp = req->dest_mn_lp;
     msg->sender_svr= req->src_lp;
     msg->sender_node = sender->gid;
+    msg->src_node = codes_mapping_get_lp_relative_id(sender->gid, 0, 1);
     msg->packet_size = packet_size;
+    msg->message_id = req->msg_id;
+    msg->total_size = req->msg_size;
     msg->travel_start_time = tw_now(sender);
     msg->remote_event_size_bytes = 0;
     msg->local_event_size_bytes = 0;
@@ -562,9 +729,11 @@ static void credit_send( nodes_state * s,
     if(sq == -1) {
         m->source_direction = msg->source_direction;
         m->source_dim = msg->source_dim;
+        m->vc = msg->vc;
     } else {
         m->source_direction = msg->saved_queue % 2;
         m->source_dim = msg->saved_queue / 2;
+        m->vc = msg->saved_vc;
     }
     m->type = CREDIT;
     tw_event_send(e);
@@ -577,6 +746,10 @@ static void torus_init( nodes_state * s,
     char anno[MAX_NAME_LENGTH];
 
     rc_stack_create(&s->st);
+    s->packet_tbl = qhash_init(torus_hash_compare, torus_hash_func,
+            TORUS_HASH_TABLE_SIZE);
+    s->msg_tbl = qhash_init(torus_hash_compare, torus_hash_func,
+            TORUS_HASH_TABLE_SIZE);
 
     codes_mapping_get_lp_info(lp->gid, grp_name, &mapping_grp_id, NULL, &mapping_type_id, anno, &mapping_rep_id, &mapping_offset);
 
@@ -598,8 +771,8 @@ static void torus_init( nodes_state * s,
     s->finished_chunks = 0;
     s->finished_packets = 0;
 
-    s->neighbour_minus_lpID = (int*)malloc(p->n_dims * sizeof(int));
-    s->neighbour_plus_lpID = (int*)malloc(p->n_dims * sizeof(int));
+    s->neighbour_minus_lpID = (tw_lpid*)malloc(p->n_dims * sizeof(tw_lpid));
+    s->neighbour_plus_lpID = (tw_lpid*)malloc(p->n_dims * sizeof(tw_lpid));
     s->dim_position = (int*)malloc(p->n_dims * sizeof(int));
     s->buffer = (int**)malloc(2*p->n_dims * sizeof(int*));
     s->next_link_available_time =
@@ -650,16 +823,20 @@ static void torus_init( nodes_state * s,
             (nodes_message_list**)malloc(p->num_vc*sizeof(nodes_message_list*));
 
     }
-    s->other_msgs =
-        (nodes_message_list**)malloc(2*p->n_dims*sizeof(nodes_message_list*));
-    s->other_msgs_tail =
-        (nodes_message_list**)malloc(2*p->n_dims*sizeof(nodes_message_list*));
+    s->other_msgs = (nodes_message_list**)malloc(
+            2*p->n_dims*p->num_vc*sizeof(nodes_message_list*));
+    s->other_msgs_tail = (nodes_message_list**)malloc(
+            2*p->n_dims*p->num_vc*sizeof(nodes_message_list*));
     s->in_send_loop =
         (int *)malloc(2*p->n_dims*sizeof(int));
 
     s->link_traffic = (int64_t *)malloc(2*p->n_dims*sizeof(int64_t));
     s->total_data_sz = 0;
 
+    s->port_node = (int *)malloc(2*p->n_dims*sizeof(int));
+    s->port_up = (char *)malloc(2*p->n_dims*sizeof(char));
+    s->faults_applied = 0;
+
     for(i=0; i < 2*p->n_dims; i++)
     {
 	s->buffer[i] = (int*)malloc(p->num_vc * sizeof(int));
@@ -671,14 +848,13 @@ static void torus_init( nodes_state * s,
             (tw_stime*)malloc(p->num_vc * sizeof(tw_stime));
         s->terminal_msgs[i] = NULL;
         s->terminal_msgs_tail[i] = NULL;
-        s->other_msgs[i] = NULL;
-        s->other_msgs_tail[i] = NULL;
         s->in_send_loop[i] = 0;
         s->terminal_length[i] = 0;
         s->queued_length[i] = 0;
         s->all_term_length = 0;
         s->busy_time[i] = 0;
         s->last_buf_full[i] = 0;
+        s->port_up[i] = 1;
     }
 
     // calculate my torus coords
@@ -701,15 +877,9 @@ static void torus_init( nodes_state * s,
       temp_dim_pos[ j ] = (s->dim_position[ j ] -1 + p->dim_length[ j ]) %
           p->dim_length[ j ];
 
-      s->neighbour_minus_lpID[j] =
-          to_flat_id(p->n_dims, p->dim_length, temp_dim_pos);
-
-      /* DEBUG
-      printf(" minus neighbor: flat:%d lpid:%lu\n",
-              s->neighbour_minus_lpID[j],
-              codes_mapping_get_lpid_from_relative(s->neighbour_minus_lpID[j],
-                      NULL, LP_CONFIG_NM, s->anno, 1));
-      */
+      s->port_node[ j * 2 ] = to_flat_id(p->n_dims, p->dim_length, temp_dim_pos);
+      s->neighbour_minus_lpID[j] = codes_mapping_get_lpid_from_relative(
+              s->port_node[ j * 2 ], NULL, LP_CONFIG_NM, s->anno, 1);
 
       temp_dim_pos[ j ] = s->dim_position[ j ];
     }
@@ -719,15 +889,9 @@ static void torus_init( nodes_state * s,
       temp_dim_pos[ j ] = ( s->dim_position[ j ] + 1 + p->dim_length[ j ]) %
           p->dim_length[ j ];
 
-      s->neighbour_plus_lpID[j] =
-          to_flat_id(p->n_dims, p->dim_length, temp_dim_pos);
-
-      /* DEBUG
-      printf(" plus neighbor: flat:%d lpid:%lu\n",
-              s->neighbour_plus_lpID[j],
-              codes_mapping_get_lpid_from_relative(s->neighbour_plus_lpID[j],
-                      NULL, LP_CONFIG_NM, s->anno, 1));
-      */
+      s->port_node[ 1 + j * 2 ] = to_flat_id(p->n_dims, p->dim_length, temp_dim_pos);
+      s->neighbour_plus_lpID[j] = codes_mapping_get_lpid_from_relative(
+              s->port_node[ 1 + j * 2 ], NULL, LP_CONFIG_NM, s->anno, 1);
 
       temp_dim_pos[ j ] = s->dim_position[ j ];
     }
@@ -744,11 +908,30 @@ static void torus_init( nodes_state * s,
        s->pending_msgs_tail[j][i] = NULL;
        s->queued_msgs[j][i] = NULL;
        s->queued_msgs_tail[j][i] = NULL;
+       s->other_msgs[OTHERQ(s, j, i)] = NULL;
+       s->other_msgs_tail[OTHERQ(s, j, i)] = NULL;
      }
    }
   // record LP time
     s->packet_counter = 0;
     torus_collective_init(s, lp);
+
+    /* the failure schedule is applied by events to self; a node only
+     * follows the entries that concern its own links */
+    int node = to_flat_id(p->n_dims, p->dim_length, s->dim_position);
+    for(int k = 0; k < p->num_faults; k++) {
+        int hits = 0;
+        for(j = 0; j < 2 * p->n_dims; j++)
+            hits |= net_fault_hits(&p->faults[k], node, s->port_node[j]);
+        if(!hits)
+            continue;
+        nodes_message *m;
+        tw_event *e = model_net_method_event_new(lp->gid,
+                g_tw_lookahead + p->faults[k].time, lp, TORUS, (void**)&m, NULL);
+        m->type = FAULT;
+        m->fault_id = k;
+        tw_event_send(e);
+    }
 }
 
 
@@ -1020,60 +1203,168 @@ static void node_collective_fan_out(nodes_state * s,
           }
 }
 
+/* direction of the minimal route towards coords in dimension dim: 1 for plus,
+ * 0 for minus, -1 if the dimension is already resolved */
+static int torus_route_dir( nodes_state * s,
+                            const int * coords,
+                            int dim )
+{
+  int delta = s->dim_position[ dim ] - coords[ dim ];
+
+  if ( delta > s->params->half_length[ dim ] )
+    return 1;
+  if ( delta < -s->params->half_length[ dim ] )
+    return 0;
+  if ( delta > 0 )
+    return 0;
+  if ( delta < 0 )
+    return 1;
+  return -1;
+}
+
+/* returns 1 if this node is at coords */
+static int torus_at_coords( nodes_state * s, const int * coords )
+{
+  for(int i = 0; i < s->params->n_dims; i++ )
+    if ( s->dim_position[ i ] != coords[ i ] )
+      return 0;
+  return 1;
+}
+
+/* returns 1 if chunks entering a new ring of vc need two free slots (bubble
+ * flow control). Both channels of valiant routing are dimension-order rings,
+ * the adaptive channel of adaptive routing is not. */
+static int torus_vc_bubble( const torus_param * p, int vc )
+{
+  return p->routing != TORUS_ROUTING_ADAPTIVE || vc == STATICQ;
+}
+
 /*Returns the next neighbor to which the packet should be routed by using DOR (Taken from Ning's code of the torus model)*/
 static void dimension_order_routing( nodes_state * s,
+			     const int * coords,
 			     tw_lpid * dst_lp,
 			     int * dim,
 			     int * dir )
 {
-     int dest[s->params->n_dims];
-     int dest_id = -1;
-
   /* dummys - check later */
   *dim = -1;
   *dir = -1;
 
-  to_dim_id(codes_mapping_get_lp_relative_id(*dst_lp, 0, 1),
-          s->params->n_dims, s->params->dim_length, dest);
-
   for(int i = 0; i < s->params->n_dims; i++ )
     {
-      if ( s->dim_position[ i ] - dest[ i ] > s->params->half_length[ i ] )
-	{
-	  dest_id = s->neighbour_plus_lpID[ i ];
-	  *dim = i;
-	  *dir = 1;
-	  break;
-	}
-      if ( s->dim_position[ i ] - dest[ i ] < -s->params->half_length[ i ] )
+      int d = torus_route_dir(s, coords, i);
+      if ( d != -1 )
 	{
-	  dest_id = s->neighbour_minus_lpID[ i ];
 	  *dim = i;
-	  *dir = 0;
+	  *dir = d;
 	  break;
 	}
-      if ( ( s->dim_position[i] - dest[i] <= s->params->half_length[i] ) &&
-              ( s->dim_position[ i ] - dest[ i ] > 0 ) )
+    }
+
+  assert(*dim != -1 && *dir != -1);
+  *dst_lp = *dir ? s->neighbour_plus_lpID[ *dim ] :
+      s->neighbour_minus_lpID[ *dim ];
+}
+
+/* returns 1 if a productive link towards coords is up */
+static int torus_productive_up( nodes_state * s, const int * coords )
+{
+  for(int i = 0; i < s->params->n_dims; i++ )
+    {
+      int d = torus_route_dir(s, coords, i);
+      if ( d != -1 && s->port_up[ d + ( i * 2 ) ] )
+        return 1;
+    }
+  return 0;
+}
+
+/* Dimension-order routing over the links that are up, for valiant routing:
+ * the first productive dimension whose link is up, or the dimension-order
+ * link when all of them are down (the chunk waits there for it to come back
+ * up). Without failures it is dimension-order routing. */
+static void valiant_routing( nodes_state * s,
+			     const int * coords,
+			     tw_lpid * dst_lp,
+			     int * dim,
+			     int * dir )
+{
+  dimension_order_routing(s, coords, dst_lp, dim, dir);
+  if ( s->port_up[ *dir + ( *dim * 2 ) ] )
+    return;
+
+  for(int i = *dim + 1; i < s->params->n_dims; i++ )
+    {
+      int d = torus_route_dir(s, coords, i);
+      if ( d != -1 && s->port_up[ d + ( i * 2 ) ] )
 	{
-	  dest_id = s->neighbour_minus_lpID[ i ];
 	  *dim = i;
-	  *dir = 0;
-	  break;
+	  *dir = d;
+	  *dst_lp = d ? s->neighbour_plus_lpID[ i ] :
+	      s->neighbour_minus_lpID[ i ];
+	  return;
 	}
-      if (( s->dim_position[i] - dest[i] >= -s->params->half_length[i] ) &&
-              ( s->dim_position[ i ] - dest[ i ] < 0) )
+    }
+}
+
+/* Minimal adaptive routing: picks the productive dimension whose queue holds
+ * the fewest chunks, among the ones whose link is up. With need_slot set,
+ * only queues with a free slot on the adaptive channel are considered. dim
+ * is -1 if no queue qualifies. */
+static void adaptive_routing( nodes_state * s,
+			     const int * coords,
+			     int need_slot,
+			     tw_lpid * dst_lp,
+			     int * dim,
+			     int * dir )
+{
+  int best = INT_MAX;
+
+  *dim = -1;
+  *dir = -1;
+
+  for(int i = 0; i < s->params->n_dims; i++ )
+    {
+      int d = torus_route_dir(s, coords, i);
+      if ( d == -1 )
+        continue;
+
+      int queue = d + ( i * 2 );
+      if ( !s->port_up[ queue ] )
+        continue;
+      if ( need_slot && s->buffer[ queue ][ ADAPTIVEQ ] + s->params->chunk_size
+              > s->params->buffer_size )
+        continue;
+
+      int occupancy = s->queued_length[ queue ] + s->terminal_length[ queue ];
+      for(int vc = 0; vc < s->params->num_vc; vc++ )
+        occupancy += s->buffer[ queue ][ vc ];
+
+      if ( occupancy < best )
 	{
-	  dest_id = s->neighbour_plus_lpID[ i ];
+	  best = occupancy;
 	  *dim = i;
-	  *dir = 1;
-	  break;
+	  *dir = d;
 	}
     }
 
-  assert(*dim != -1 && *dir != -1);
-  *dst_lp = codes_mapping_get_lpid_from_relative(dest_id, NULL, LP_CONFIG_NM,
-          s->anno, 1);
+  if ( *dim != -1 )
+    *dst_lp = *dir ? s->neighbour_plus_lpID[ *dim ] :
+        s->neighbour_minus_lpID[ *dim ];
+}
+
+/* returns the first pending chunk of queue, escape channel first */
+static nodes_message_list* first_pending( nodes_state * s, int queue, int * vc )
+{
+  for(int i = 0; i < s->params->num_vc; i++ )
+    if ( s->pending_msgs[ queue ][ i ] != NULL )
+      {
+        *vc = i;
+        return s->pending_msgs[ queue ][ i ];
+      }
+  *vc = -1;
+  return NULL;
 }
+
 static void packet_generate( nodes_state * ns,
         tw_bf * bf,
         nodes_message * msg,
@@ -1083,9 +1374,41 @@ static void packet_generate( nodes_state * ns,
     tw_stime ts;
     tw_event * e;
     nodes_message *m;
-
-    tw_lpid intm_dst = msg->dest_lp;
-    dimension_order_routing(ns, &intm_dst, &tmp_dim, &tmp_dir);
+    const torus_param *p = ns->params;
+
+    /* the destination coordinates are carried by every chunk, so that the
+     * nodes on the way do not have to look them up */
+    to_dim_id(codes_mapping_get_lp_relative_id(msg->dest_lp, 0, 1),
+            p->n_dims, p->dim_length, msg->dest_coords);
+    const int *coords = msg->dest_coords;
+    msg->vc = STATICQ;
+    msg->valiant_phase = 1;
+
+    tw_lpid intm_dst;
+    if(p->routing == TORUS_ROUTING_VALIANT) {
+        to_dim_id(tw_rand_integer(lp->rng, 0, p->num_nodes - 1),
+                p->n_dims, p->dim_length, msg->intm_coords);
+        /* an intermediate node cut off by failures is skipped */
+        msg->valiant_phase = torus_at_coords(ns, msg->intm_coords) ||
+            !torus_productive_up(ns, msg->intm_coords);
+        if(!msg->valiant_phase)
+            coords = msg->intm_coords;
+        msg->vc = msg->valiant_phase;
+        valiant_routing(ns, coords, &intm_dst, &tmp_dim, &tmp_dir);
+    }
+    if(p->routing == TORUS_ROUTING_ADAPTIVE) {
+        /* all chunks of the packet are injected on the least loaded
+         * productive queue of the adaptive channel, or on the escape channel
+         * when the links of all of them are down */
+        adaptive_routing(ns, coords, 0, &intm_dst, &tmp_dim, &tmp_dir);
+        msg->vc = ADAPTIVEQ;
+        if(tmp_dim == -1) {
+            dimension_order_routing(ns, coords, &intm_dst, &tmp_dim, &tmp_dir);
+            msg->vc = STATICQ;
+        }
+    }
+    if(p->routing == TORUS_ROUTING_STATIC)
+        dimension_order_routing(ns, coords, &intm_dst, &tmp_dim, &tmp_dir);
     queue = tmp_dir + ( tmp_dim * 2 );
 
     msg->packet_ID = ns->packet_counter;
@@ -1167,6 +1490,9 @@ static void packet_generate_rc( nodes_state * s,
 {
     s->packet_counter--;
 
+    if(s->params->routing == TORUS_ROUTING_VALIANT)
+        tw_rand_reverse_unif(lp->rng);
+
     int queue = msg->source_direction + (msg->source_dim * 2);
 
     uint64_t num_chunks = msg->packet_size/s->params->chunk_size;
@@ -1213,7 +1539,7 @@ static void packet_send_rc(nodes_state * s,
         return;
     }
      if(bf->c3) {
-         s->buffer[queue][STATICQ] -= s->params->chunk_size;
+         s->buffer[queue][msg->saved_channel] -= s->params->chunk_size;
      }
 
      codes_local_latency_reverse(lp);
@@ -1249,7 +1575,7 @@ static void packet_send_rc(nodes_state * s,
      if(bf->c8)
      {
         prepend_to_node_message_list(s->pending_msgs[queue],
-                s->pending_msgs_tail[queue], STATICQ, cur_entry);
+                s->pending_msgs_tail[queue], msg->saved_channel, cur_entry);
      }
 
      if(bf->c9)
@@ -1273,31 +1599,41 @@ static void packet_send( nodes_state * s,
     tw_event *e;
     nodes_message *m;
     int isT = 0;
+    int vc;
 
     int queue = msg->source_direction + (msg->source_dim * 2);
 
-    if(s->pending_msgs[queue][STATICQ] == NULL
-        && s->terminal_msgs[queue] == NULL) {
+    nodes_message_list *cur_entry = first_pending(s, queue, &vc);
+
+    /* chunks held on a link that is down wait for the fault event that
+     * brings it back up to restart the loop */
+    if((cur_entry == NULL && s->terminal_msgs[queue] == NULL) ||
+            !s->port_up[queue]) {
         bf->c1 = 1;
         s->in_send_loop[queue] = 0;
         return;
     }
 
-    nodes_message_list *cur_entry = s->pending_msgs[queue][STATICQ];
-
     if(cur_entry == NULL) {
         /* Bubble flow control method here, checking if there are 2 empty
          * buffer slots only then forward newly injected packets */
-                if((s->buffer[queue][STATICQ] + (2 * s->params->chunk_size) <= s->params->buffer_size)) {
+                vc = s->terminal_msgs[queue]->msg.vc;
+                int slots = torus_vc_bubble(s->params, vc) ? 2 : 1;
+                if((s->buffer[queue][vc] + (slots * s->params->chunk_size) <= s->params->buffer_size)) {
                     bf->c3 = 1;
-                    s->buffer[queue][STATICQ] += s->params->chunk_size;
+                    s->buffer[queue][vc] += s->params->chunk_size;
                     cur_entry = s->terminal_msgs[queue];
                     isT = 1;
                 }
               if(cur_entry == NULL)
               {
+                int queued = 0;
+                for(int i = 0; i < s->params->num_vc; i++)
+                    if(s->queued_msgs[queue][i] != NULL)
+                        queued = 1;
+
                 bf->c4 = 1;
-                if(s->queued_msgs[queue][STATICQ] != NULL && s->last_buf_full[queue] == 0.0)
+                if(queued && s->last_buf_full[queue] == 0.0)
                 {
                     bf->c24 = 1;
                     msg->saved_busy_time = s->last_buf_full[queue];
@@ -1308,6 +1644,7 @@ static void packet_send( nodes_state * s,
                 return;
             }
         }
+    msg->saved_channel = vc;
 
     uint64_t num_chunks = cur_entry->msg.packet_size/s->params->chunk_size;
     if(cur_entry->msg.packet_size % s->params->chunk_size)
@@ -1392,7 +1729,7 @@ static void packet_send( nodes_state * s,
     } else {
         bf->c8 = 1;
         cur_entry = return_head(s->pending_msgs[queue],
-            s->pending_msgs_tail[queue], STATICQ);
+            s->pending_msgs_tail[queue], vc);
     }
 
     rc_stack_push(lp, cur_entry, free_tmp, s->st);
@@ -1400,7 +1737,7 @@ static void packet_send( nodes_state * s,
     if(isT) {
         cur_entry = s->terminal_msgs[queue];
     } else {
-        cur_entry = s->pending_msgs[queue][STATICQ];
+        cur_entry = first_pending(s, queue, &vc);
             if(cur_entry == NULL) {
                 cur_entry = s->terminal_msgs[queue];
             }
@@ -1421,6 +1758,29 @@ static void packet_send( nodes_state * s,
     }
 }
 
+/* zero-load latency of a packet from torus node src to this node: its
+ * injection, then its chunks pipelined over the links of a minimal path */
+static double packet_ideal_time(nodes_state * s, int src,
+        uint64_t packet_size)
+{
+    const torus_param *p = s->params;
+    uint64_t num_chunks = packet_size/p->chunk_size;
+    if(packet_size % p->chunk_size)
+        num_chunks++;
+    if(!num_chunks)
+        num_chunks = 1;
+
+    int hops = 0;
+    for(int i = 0; i < p->n_dims; i++) {
+        int delta = abs(src % p->dim_length[i] - s->dim_position[i]);
+        hops += delta < p->dim_length[i] - delta ? delta :
+            p->dim_length[i] - delta;
+        src /= p->dim_length[i];
+    }
+    return p->cn_delay * packet_size +
+        (hops + num_chunks - 1) * (p->head_delay + p->router_delay);
+}
+
 static void packet_arrive_rc(nodes_state * s,
         tw_bf * bf,
         nodes_message * msg,
@@ -1433,8 +1793,40 @@ static void packet_arrive_rc(nodes_state * s,
     {
         tw_rand_reverse_unif(lp->rng);
         s->total_data_sz -= s->params->chunk_size;
+        struct torus_hash_key key;
+        key.sender_node = msg->sender_node;
         if(bf->c2)
         {
+            if(bf->c31)
+            {
+                model_net_event_rc2(lp, &msg->event_rc);
+            }
+
+            if(msg->packet_size != msg->total_size)
+            {
+                struct torus_hash_entry * m_ent;
+                key.id = msg->message_id;
+                if(bf->c9)
+                {
+                    m_ent = rc_stack_pop(s->st);
+                    qhash_add(s->msg_tbl, &key, &m_ent->hash_link);
+                }
+                else
+                    m_ent = torus_hash_find(s->msg_tbl, &key);
+                if(bf->c8)
+                {
+                    free(m_ent->remote_event_data);
+                    m_ent->remote_event_data = NULL;
+                    m_ent->remote_event_size = 0;
+                }
+                m_ent->count -= msg->packet_size;
+                if(bf->c7)
+                {
+                    qhash_del(&m_ent->hash_link);
+                    torus_hash_entry_free(m_ent);
+                }
+            }
+
             struct mn_stats* stat;
             stat = model_net_find_stats(msg->category, s->torus_stats_array);
             stat->recv_count--;
@@ -1443,6 +1835,10 @@ static void packet_arrive_rc(nodes_state * s,
             s->total_time = msg->saved_recv_time;
             N_finished_packets--;
             s->finished_packets--;
+            if(jobs.enabled)
+                net_jobs_packet_rc(&jobs, msg->src_node,
+                        tw_now(lp) - msg->travel_start_time,
+                        packet_ideal_time(s, msg->src_node, msg->packet_size));
 
             //total_time = msg->saved_total_time;
             total_time -= (tw_now(lp) - msg->travel_start_time);
@@ -1453,10 +1849,27 @@ static void packet_arrive_rc(nodes_state * s,
             {
                 max_latency = msg->saved_available_time;
             }
+        }
 
-            if(bf->c31)
+        uint64_t num_chunks = msg->packet_size/s->params->chunk_size;
+        if(msg->packet_size % s->params->chunk_size)
+            num_chunks++;
+        if(num_chunks > 1)
+        {
+            struct torus_hash_entry * pkt;
+            key.id = msg->packet_ID;
+            if(bf->c5)
             {
-                model_net_event_rc2(lp, &msg->event_rc);
+                pkt = rc_stack_pop(s->st);
+                qhash_add(s->packet_tbl, &key, &pkt->hash_link);
+            }
+            else
+                pkt = torus_hash_find(s->packet_tbl, &key);
+            pkt->count--;
+            if(bf->c4)
+            {
+                qhash_del(&pkt->hash_link);
+                torus_hash_entry_free(pkt);
             }
         }
     }
@@ -1464,12 +1877,13 @@ static void packet_arrive_rc(nodes_state * s,
     if(bf->c6)
     {
         int queue = msg->source_channel;
+        int vc = msg->saved_channel;
         nodes_message_list * cur_entry = NULL;
 
        if(bf->c30)
        {
         cur_entry = return_tail(s->queued_msgs[queue],
-                s->queued_msgs_tail[queue], STATICQ);
+                s->queued_msgs_tail[queue], vc);
         s->queued_length[queue] -= s->params->chunk_size;
         if(bf->c24)
         {
@@ -1480,15 +1894,15 @@ static void packet_arrive_rc(nodes_state * s,
        if(bf->c9 || bf->c11)
        {
         cur_entry = return_tail(s->pending_msgs[queue],
-                s->pending_msgs_tail[queue], STATICQ);
-        s->buffer[queue][STATICQ] -= s->params->chunk_size;
+                s->pending_msgs_tail[queue], vc);
+        s->buffer[queue][vc] -= s->params->chunk_size;
         tw_rand_reverse_unif(lp->rng);
        }
 
        if(bf->c8)
        {
         cur_entry = return_tail(s->other_msgs,
-                s->other_msgs_tail, queue);
+                s->other_msgs_tail, OTHERQ(s, queue, vc));
         if(bf->c24)
             s->last_buf_full[queue] = msg->saved_busy_time;
        }
@@ -1541,7 +1955,28 @@ static void packet_arrive( nodes_state * s,
         if(!num_chunks)
             num_chunks = 1;
 
-        if( msg->chunk_id == num_chunks - 1 )
+        /* the packet is complete once all of its chunks are in, whatever
+         * their order */
+        struct torus_hash_key key;
+        key.sender_node = msg->sender_node;
+        int packet_done = 1;
+        if(num_chunks > 1)
+        {
+            int added;
+            key.id = msg->packet_ID;
+            struct torus_hash_entry * pkt = torus_hash_get(s->packet_tbl,
+                    &key, &added);
+            bf->c4 = added;
+            packet_done = ++pkt->count == num_chunks;
+            if(packet_done)
+            {
+                bf->c5 = 1;
+                qhash_del(&pkt->hash_link);
+                rc_stack_push(lp, pkt, torus_hash_entry_free, s->st);
+            }
+        }
+
+        if(packet_done)
         {
 	    bf->c2 = 1;
 	    stat = model_net_find_stats(msg->category, s->torus_stats_array);
@@ -1554,6 +1989,10 @@ static void packet_arrive( nodes_state * s,
 	    /*count the number of packets completed overall*/
 	    N_finished_packets++;
         s->finished_packets++;
+        if(jobs.enabled)
+            net_jobs_packet(&jobs, msg->src_node,
+                    tw_now(lp) - msg->travel_start_time,
+                    packet_ideal_time(s, msg->src_node, msg->packet_size));
 
 	    msg->saved_total_time = total_time;
         total_time += tw_now( lp ) - msg->travel_start_time;
@@ -1565,10 +2004,43 @@ static void packet_arrive( nodes_state * s,
 		  msg->saved_available_time = max_latency;
 	          max_latency=tw_now( lp ) - msg->travel_start_time;
      		}
+
+            /* the message is complete once all of its bytes are in; the
+             * completion event comes with the last packet, which may not be
+             * the last to arrive */
+            int msg_done = 1;
+            void *tmp_ptr = model_net_method_get_edata(TORUS, msg);
+            int remote_event_size = msg->remote_event_size_bytes;
+            if(msg->packet_size != msg->total_size)
+            {
+                int added;
+                key.id = msg->message_id;
+                struct torus_hash_entry * m_ent = torus_hash_get(s->msg_tbl,
+                        &key, &added);
+                bf->c7 = added;
+                m_ent->count += msg->packet_size;
+                if(remote_event_size)
+                {
+                    bf->c8 = 1;
+                    m_ent->remote_event_data = malloc(remote_event_size);
+                    memcpy(m_ent->remote_event_data, tmp_ptr,
+                            remote_event_size);
+                    m_ent->remote_event_size = remote_event_size;
+                }
+                msg_done = m_ent->count == msg->total_size;
+                if(msg_done)
+                {
+                    bf->c9 = 1;
+                    tmp_ptr = m_ent->remote_event_data;
+                    remote_event_size = m_ent->remote_event_size;
+                    qhash_del(&m_ent->hash_link);
+                    rc_stack_push(lp, m_ent, torus_hash_entry_free, s->st);
+                }
+            }
+
 	    // Trigger an event on receiving server
-	    if(msg->remote_event_size_bytes)
+	    if(msg_done && remote_event_size)
 	    {
-               void *tmp_ptr = model_net_method_get_edata(TORUS, msg);
                if (msg->is_pull){
                    bf->c31 = 1;
                    int net_id = model_net_get_id(LP_METHOD_NM);
@@ -1578,14 +2050,14 @@ static void packet_arrive( nodes_state * s,
                        codes_mctx_set_global_direct(lp->gid);
                    msg->event_rc = model_net_event_mctx(net_id, &mc_src, &mc_dst,
                            msg->category, msg->sender_svr, msg->pull_size,
-                           0.0, msg->remote_event_size_bytes, tmp_ptr, 0,
+                           0.0, remote_event_size, tmp_ptr, 0,
                            NULL, lp);
                }
                else
                {
                    e = tw_event_new(msg->final_dest_gid, ts, lp);
                    void * m_remote = tw_event_data(e);
-                   memcpy(m_remote, tmp_ptr, msg->remote_event_size_bytes);
+                   memcpy(m_remote, tmp_ptr, remote_event_size);
                    tw_event_send(e);
                }
 	    }
@@ -1594,17 +2066,38 @@ static void packet_arrive( nodes_state * s,
   else
     {
         bf->c6 = 1;
-        int tmp_dir = -1, tmp_dim = -1, queue;
-        tw_lpid dst_lp = msg->dest_lp;
-
-        dimension_order_routing(s, &dst_lp, &tmp_dim, &tmp_dir);
-        queue = tmp_dir + (tmp_dim * 2);
+        int tmp_dir = -1, tmp_dim = -1, queue, vc = STATICQ;
+        tw_lpid dst_lp;
 
         nodes_message_list * cur_chunk = (nodes_message_list *)malloc(
                 sizeof(nodes_message_list));
         init_nodes_message_list(cur_chunk, msg);
 
+        const int *coords = msg->dest_coords;
+        if(s->params->routing == TORUS_ROUTING_VALIANT) {
+            /* the second phase starts at the intermediate node, or here when
+             * failures cut it off */
+            if(!msg->valiant_phase && (torus_at_coords(s, msg->intm_coords) ||
+                        !torus_productive_up(s, msg->intm_coords)))
+                cur_chunk->msg.valiant_phase = 1;
+            vc = cur_chunk->msg.valiant_phase;
+            if(!vc)
+                coords = msg->intm_coords;
+            valiant_routing(s, coords, &dst_lp, &tmp_dim, &tmp_dir);
+        }
+        if(s->params->routing == TORUS_ROUTING_ADAPTIVE) {
+            /* stay on the adaptive channel while it has room, otherwise take
+             * the dimension-order route on the escape channel */
+            adaptive_routing(s, coords, 1, &dst_lp, &tmp_dim, &tmp_dir);
+            if(tmp_dim != -1)
+                vc = ADAPTIVEQ;
+        }
+        if(tmp_dim == -1)
+            dimension_order_routing(s, coords, &dst_lp, &tmp_dim, &tmp_dir);
+        queue = tmp_dir + (tmp_dim * 2);
+
         msg->source_channel = queue;
+        msg->saved_channel = vc;
 
         if(msg->remote_event_size_bytes > 0) {
             void *m_data_src = model_net_method_get_edata(TORUS, msg);
@@ -1612,24 +2105,28 @@ static void packet_arrive( nodes_state * s,
             memcpy(cur_chunk->event_data, m_data_src,
                 msg->remote_event_size_bytes);
         }
+        /* entering a new ring of a bubble channel takes two free slots */
         int multfactor = 1;
-        if(msg->source_dim != tmp_dim) {
+        if(torus_vc_bubble(s->params, vc) &&
+                (msg->source_dim != tmp_dim || msg->vc != vc)) {
             multfactor = 2;
         }
         cur_chunk->msg.next_stop = dst_lp;
         cur_chunk->msg.source_dim = tmp_dim;
         cur_chunk->msg.source_direction = tmp_dir;
+        cur_chunk->msg.vc = vc;
         /* Message is traveling in the same dimension*/
         if(multfactor == 1) {
-            if(s->buffer[queue][STATICQ] + s->params->chunk_size
+            if(s->buffer[queue][vc] + s->params->chunk_size
                 > s->params->buffer_size) {
                 /* No buffer space available, add it in the queued messages for
                  * now */
                 bf->c30 = 1;
                 cur_chunk->msg.saved_queue =
                     msg->source_direction + ( msg->source_dim * 2 );
+                cur_chunk->msg.saved_vc = msg->vc;
                 append_to_node_message_list(s->queued_msgs[queue],
-                        s->queued_msgs_tail[queue], STATICQ, cur_chunk);
+                        s->queued_msgs_tail[queue], vc, cur_chunk);
                 s->queued_length[queue] += s->params->chunk_size;
 
                 if(!s->last_buf_full[queue])
@@ -1644,31 +2141,33 @@ static void packet_arrive( nodes_state * s,
                  * this queue, send a credit back and increment the buffer
                  * space. */
                 bf->c9 = 1;
-                s->buffer[queue][STATICQ] += s->params->chunk_size;
+                s->buffer[queue][vc] += s->params->chunk_size;
                 credit_send( s, lp, msg, -1 );
                 append_to_node_message_list(s->pending_msgs[queue],
-                    s->pending_msgs_tail[queue], STATICQ, cur_chunk);
+                    s->pending_msgs_tail[queue], vc, cur_chunk);
             }
         }
         else
         {
             /* Message is travelling in different dimension so two buffer
              * spaces are required. */
-                if(s->buffer[queue][STATICQ] + 2 * s->params->chunk_size
+                if(s->buffer[queue][vc] + 2 * s->params->chunk_size
                     <= s->params->buffer_size) {
                     bf->c11 = 1;
-                    s->buffer[queue][STATICQ] += s->params->chunk_size;
+                    s->buffer[queue][vc] += s->params->chunk_size;
                     credit_send( s, lp, msg, -1 );
                     append_to_node_message_list(s->pending_msgs[queue],
-                        s->pending_msgs_tail[queue], STATICQ, cur_chunk);
+                        s->pending_msgs_tail[queue], vc, cur_chunk);
                 }
                 else
                 {
                     bf->c8 = 1;
                     cur_chunk->msg.saved_queue =
                         msg->source_direction + ( msg->source_dim * 2 );
+                    cur_chunk->msg.saved_vc = msg->vc;
                     append_to_node_message_list(s->other_msgs,
-                            s->other_msgs_tail, queue, cur_chunk);
+                            s->other_msgs_tail, OTHERQ(s, queue, vc),
+                            cur_chunk);
                 if(!s->last_buf_full[queue])
                 {
                     bf->c24 = 1;
@@ -1710,6 +2209,9 @@ static void torus_report_stats()
        printf(" Average number of hops traversed %f average packet latency %lf us maximum packet latency %lf us finished packets %lld finished hops %lld \n",
                (float)avg_hops/total_finished_packets, avg_time/(total_finished_packets*1000), max_time/1000, total_finished_packets, avg_hops);
      }
+
+    /* per-job slowdown: summed packet latency over summed zero-load latency */
+    net_jobs_report(&jobs);
 }
 /* finalize the torus node and free all event buffers available */
 void
@@ -1720,19 +2222,26 @@ final( nodes_state * s, tw_lp * lp )
 
   for( j = 0; j < 2 * p->n_dims; j++)
   {
-  if(s->pending_msgs[j][STATICQ] != NULL)
+  for(int vc = 0; vc < p->num_vc; vc++)
+  {
+  if(s->pending_msgs[j][vc] != NULL)
       printf("\n LP %llu leftover pending messages ", LLU(lp->gid));
 
-  if(s->other_msgs[j] != NULL)
+  if(s->other_msgs[OTHERQ(s, j, vc)] != NULL)
       printf("\n LP %llu leftover other messages ", LLU(lp->gid));
 
-  if(s->queued_msgs[j][STATICQ] != NULL)
+  if(s->queued_msgs[j][vc] != NULL)
       printf("\n LP %llu leftover queued messages ", LLU(lp->gid));
+  }
 
   if(s->terminal_msgs[j] != NULL)
       printf("\n LP %llu leftover terminal messages ", LLU(lp->gid));
   }
   rc_stack_destroy(s->st);
+  qhash_destroy_and_finalize(s->packet_tbl, struct torus_hash_entry, hash_link,
+          torus_hash_entry_free);
+  qhash_destroy_and_finalize(s->msg_tbl, struct torus_hash_entry, hash_link,
+          torus_hash_entry_free);
 
   model_net_print_stats(lp->gid, s->torus_stats_array);
   free(s->next_link_available_time);
@@ -1746,34 +2255,34 @@ final( nodes_state * s, tw_lp * lp )
   free(s->queued_msgs);
   free(s->queued_msgs_tail);
   free(s->other_msgs);
+  free(s->port_node);
+  free(s->port_up);
 
 
-  int written = 0;
   if(!s->node_id)
   {
-      written = sprintf(s->output_buf,
+      lp_io_fmt(
               "# Format <LP id> <Node ID> <Total Data Size> <Total Time Spent> <# Packets finished> <Avg hops> \n");
   }
-     written += sprintf(s->output_buf + written, "%llu %llu %ld %lf %ld %lf\n",
+     lp_io_fmt("%llu %llu %ld %lf %ld %lf\n",
                           LLU(lp->gid), LLU(s->node_id), s->total_data_sz, s->total_time,
                           s->finished_packets, (double)s->total_hops/s->finished_packets);
 
-     lp_io_write(lp->gid, "torus-msg-stats", written, s->output_buf);
+     lp_io_fmt_write(lp->gid, "torus-msg-stats");
 
-     written = 0;
       if(!s->node_id)
       {
-          written = sprintf(s->output_busy_buf,
+          lp_io_fmt(
                   "# Format <LP id> <Node ID> <Busy time(s) per torus link> \n");
       }
-      written += sprintf(s->output_busy_buf + written, "%llu %llu", LLU(lp->gid), LLU(s->node_id));
+      lp_io_fmt("%llu %llu", LLU(lp->gid), LLU(s->node_id));
      for(int i = 0; i < 2 * p->n_dims; i++)
      {
-       written += sprintf(s->output_busy_buf + written, " %lf ", s->busy_time[i]);
+       lp_io_fmt(" %lf ", s->busy_time[i]);
      }
-     written += sprintf(s->output_busy_buf + written, "\n");
+     lp_io_fmt("\n");
 
-     lp_io_write(lp->gid, "torus-link-stats", written, s->output_busy_buf);
+     lp_io_fmt_write(lp->gid, "torus-link-stats");
 
   // since all LPs are sharing params, just let them leak for now
   // TODO: add a post-sim "cleanup" function?
@@ -1789,7 +2298,8 @@ static void packet_buffer_process_rc(nodes_state * s,
         tw_lp * lp)
 {
     int queue = msg->source_direction + ( msg->source_dim * 2 );
-    s->buffer[queue][STATICQ] += s->params->chunk_size;
+    int vc = msg->vc;
+    s->buffer[queue][vc] += s->params->chunk_size;
 
     if(bf->c24)
     {
@@ -1799,24 +2309,22 @@ static void packet_buffer_process_rc(nodes_state * s,
     if(bf->c2)
     {
         nodes_message_list *tail = return_tail(
-                s->pending_msgs[queue], s->pending_msgs_tail[queue],
-                STATICQ);
+                s->pending_msgs[queue], s->pending_msgs_tail[queue], vc);
         prepend_to_node_message_list(s->queued_msgs[queue],
-                s->queued_msgs_tail[queue], STATICQ, tail);
+                s->queued_msgs_tail[queue], vc, tail);
         s->queued_length[queue] += s->params->chunk_size;
         tw_rand_reverse_unif(lp->rng);
-        s->buffer[queue][STATICQ] -= s->params->chunk_size;
+        s->buffer[queue][vc] -= s->params->chunk_size;
     }
 
     if(bf->c3)
     {
         nodes_message_list *tail = return_tail(
-                s->pending_msgs[queue], s->pending_msgs_tail[queue],
-                STATICQ);
+                s->pending_msgs[queue], s->pending_msgs_tail[queue], vc);
         prepend_to_node_message_list(s->other_msgs,
-                s->other_msgs_tail, queue, tail);
+                s->other_msgs_tail, OTHERQ(s, queue, vc), tail);
         tw_rand_reverse_unif(lp->rng);
-        s->buffer[queue][STATICQ] -= s->params->chunk_size;
+        s->buffer[queue][vc] -= s->params->chunk_size;
     }
 
     if(bf->c5)
@@ -1830,7 +2338,8 @@ static void packet_buffer_process_rc(nodes_state * s,
 static void packet_buffer_process( nodes_state * ns, tw_bf * bf, nodes_message * msg, tw_lp * lp )
 {
     int queue = msg->source_direction + ( msg->source_dim * 2 );
-    ns->buffer[queue][STATICQ] -= ns->params->chunk_size;
+    int vc = msg->vc;
+    ns->buffer[queue][vc] -= ns->params->chunk_size;
     if(ns->last_buf_full[queue])
     {
         bf->c24 = 1;
@@ -1848,25 +2357,25 @@ static void packet_buffer_process( nodes_state * ns, tw_bf * bf, nodes_message *
      * the buffer space is not available right now (2 buffer spaces must be
      * available to go to a different dimension according to bubble flow
      * control */
-    if(ns->queued_msgs[queue][STATICQ] != NULL) {
+    if(ns->queued_msgs[queue][vc] != NULL) {
             bf->c2 = 1;
             nodes_message_list *head = return_head(ns->queued_msgs[queue],
-                ns->queued_msgs_tail[queue], STATICQ);
+                ns->queued_msgs_tail[queue], vc);
             ns->queued_length[queue] -= ns->params->chunk_size;
             credit_send( ns, lp, &head->msg, 1);
             append_to_node_message_list(ns->pending_msgs[queue],
-                ns->pending_msgs_tail[queue], STATICQ, head);
-            ns->buffer[queue][STATICQ] += ns->params->chunk_size;
-        } else if(ns->buffer[queue][STATICQ] + 2 * ns->params->chunk_size
+                ns->pending_msgs_tail[queue], vc, head);
+            ns->buffer[queue][vc] += ns->params->chunk_size;
+        } else if(ns->buffer[queue][vc] + 2 * ns->params->chunk_size
             <= ns->params->buffer_size) {
-            if(ns->other_msgs[queue] != NULL) {
+            if(ns->other_msgs[OTHERQ(ns, queue, vc)] != NULL) {
                 bf->c3 = 1;
                 nodes_message_list *head = return_head(ns->other_msgs,
-                        ns->other_msgs_tail, queue);
+                        ns->other_msgs_tail, OTHERQ(ns, queue, vc));
                 credit_send( ns, lp, &head->msg, 1);
                 append_to_node_message_list(ns->pending_msgs[queue],
-                        ns->pending_msgs_tail[queue], STATICQ, head);
-                ns->buffer[queue][STATICQ] += ns->params->chunk_size;
+                        ns->pending_msgs_tail[queue], vc, head);
+                ns->buffer[queue][vc] += ns->params->chunk_size;
             }
            }
     if(ns->in_send_loop[queue] == 0) {
@@ -1884,6 +2393,62 @@ static void packet_buffer_process( nodes_state * ns, tw_bf * bf, nodes_message *
 }
 
 /* reverse handler for torus node */
+static void torus_apply_faults(nodes_state * s, int n)
+{
+    const torus_param *p = s->params;
+    int node = to_flat_id(p->n_dims, p->dim_length, s->dim_position);
+    for(int queue = 0; queue < 2 * p->n_dims; queue++)
+        s->port_up[queue] = !net_link_down(p->faults, n, node,
+                s->port_node[queue]);
+}
+
+/* applies an entry of the failure schedule. Entries with the same time come
+ * in any order, so the node only ever moves forward in the schedule. */
+static void torus_fault(nodes_state * s, tw_bf * bf, nodes_message * msg,
+        tw_lp * lp)
+{
+    (void)bf;
+    msg->saved_faults_applied = s->faults_applied;
+    if(msg->fault_id + 1 > s->faults_applied)
+        s->faults_applied = msg->fault_id + 1;
+    torus_apply_faults(s, s->faults_applied);
+
+    /* links that came back up resume sending the chunks held on them */
+    int *restarted = malloc((2 * s->params->n_dims + 1) * sizeof(int));
+    restarted[0] = 0;
+    for(int queue = 0; queue < 2 * s->params->n_dims; queue++) {
+        int vc;
+        if(!s->port_up[queue] || s->in_send_loop[queue] ||
+                (first_pending(s, queue, &vc) == NULL &&
+                 s->terminal_msgs[queue] == NULL))
+            continue;
+        nodes_message *m;
+        tw_event *e = model_net_method_event_new(lp->gid,
+                codes_local_latency(lp), lp, TORUS, (void**)&m, NULL);
+        m->type = SEND;
+        m->source_direction = queue % 2;
+        m->source_dim = queue / 2;
+        tw_event_send(e);
+        s->in_send_loop[queue] = 1;
+        restarted[++restarted[0]] = queue;
+    }
+    rc_stack_push(lp, restarted, free, s->st);
+}
+
+static void torus_fault_rc(nodes_state * s, tw_bf * bf, nodes_message * msg,
+        tw_lp * lp)
+{
+    (void)bf;
+    int *restarted = rc_stack_pop(s->st);
+    for(int i = 1; i <= restarted[0]; i++) {
+        codes_local_latency_reverse(lp);
+        s->in_send_loop[restarted[i]] = 0;
+    }
+    free(restarted);
+    s->faults_applied = msg->saved_faults_applied;
+    torus_apply_faults(s, s->faults_applied);
+}
+
 static void node_rc_handler(nodes_state * s, tw_bf * bf, nodes_message * msg, tw_lp * lp)
 {
   switch(msg->type)
@@ -1937,6 +2502,10 @@ static void node_rc_handler(nodes_state * s, tw_bf * bf, nodes_message * msg, tw
                     }
                 }
         break;
+
+        case FAULT:
+            torus_fault_rc(s, bf, msg, lp);
+        break;
     default:
         printf("\n Being sent to wrong event handler %d ", msg->type);
      }
@@ -1977,6 +2546,10 @@ static void event_handler(nodes_state * s, tw_bf * bf, nodes_message * msg, tw_l
     node_collective_fan_out(s, bf, msg, lp);
   break;
 
+  case FAULT:
+    torus_fault(s, bf, msg, lp);
+  break;
+
   default:
 	printf("\n Being sent to wrong LP %d", msg->type);
   break;
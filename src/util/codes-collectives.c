@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/codes-collectives.h"
+
+struct codes_col_thresholds const codes_col_default_thresholds = {
+    .allreduce_short = 2048,
+    .allreduce_long  = 8*1024*1024,
+    .allgather_long  = 512*1024,
+};
+
+static char const * const algo_names[] = {
+    [CODES_COL_ALGO_AUTO]               = "auto",
+    [CODES_COL_ALGO_BINOMIAL]           = "binomial",
+    [CODES_COL_ALGO_RING]               = "ring",
+    [CODES_COL_ALGO_RECURSIVE_DOUBLING] = "recursive-doubling",
+    [CODES_COL_ALGO_RABENSEIFNER]       = "rabenseifner",
+    [CODES_COL_ALGO_PAIRWISE]           = "pairwise",
+};
+
+static int is_pof2(int n)
+{
+    return n > 0 && (n & (n-1)) == 0;
+}
+
+/* floor(log2(n)), n > 0 */
+static int ilog2(int n)
+{
+    int l = 0;
+    while (n >>= 1)
+        l++;
+    return l;
+}
+
+/* ceil(log2(n)), n > 0 */
+static int ilog2_ceil(int n)
+{
+    return n == 1 ? 0 : ilog2(n-1) + 1;
+}
+
+static int mod(int a, int n)
+{
+    int r = a % n;
+    return r < 0 ? r + n : r;
+}
+
+static void step_clear(struct codes_col_step *step)
+{
+    step->send_peer = -1;
+    step->send_bytes = 0;
+    step->recv_peer = -1;
+    step->recv_bytes = 0;
+}
+
+static void step_send(struct codes_col_step *step, int peer, int64_t bytes)
+{
+    step->send_peer = peer;
+    step->send_bytes = bytes;
+}
+
+static void step_recv(struct codes_col_step *step, int peer, int64_t bytes)
+{
+    step->recv_peer = peer;
+    step->recv_bytes = bytes;
+}
+
+static void step_exchange(struct codes_col_step *step, int peer, int64_t bytes)
+{
+    step_send(step, peer, bytes);
+    step_recv(step, peer, bytes);
+}
+
+static int algo_valid(enum codes_col_type type, enum codes_col_algo algo,
+        int nranks)
+{
+    switch (type) {
+        case CODES_COL_BCAST:
+        case CODES_COL_REDUCE:
+            return algo == CODES_COL_ALGO_BINOMIAL;
+        case CODES_COL_ALLREDUCE:
+            return algo == CODES_COL_ALGO_RING ||
+                algo == CODES_COL_ALGO_RECURSIVE_DOUBLING ||
+                algo == CODES_COL_ALGO_RABENSEIFNER;
+        case CODES_COL_ALLGATHER:
+            return algo == CODES_COL_ALGO_RING ||
+                (algo == CODES_COL_ALGO_RECURSIVE_DOUBLING && is_pof2(nranks));
+        case CODES_COL_ALLTOALL:
+            return algo == CODES_COL_ALGO_PAIRWISE;
+    }
+    return 0;
+}
+
+static enum codes_col_algo algo_select(enum codes_col_type type, int nranks,
+        int64_t num_bytes, struct codes_col_thresholds const *th)
+{
+    switch (type) {
+        case CODES_COL_BCAST:
+        case CODES_COL_REDUCE:
+            return CODES_COL_ALGO_BINOMIAL;
+        case CODES_COL_ALLREDUCE:
+            if (num_bytes < th->allreduce_short)
+                return CODES_COL_ALGO_RECURSIVE_DOUBLING;
+            /* halving needs at least a byte per participant */
+            else if (num_bytes < th->allreduce_long &&
+                    num_bytes >= (1 << ilog2(nranks)))
+                return CODES_COL_ALGO_RABENSEIFNER;
+            else
+                return CODES_COL_ALGO_RING;
+        case CODES_COL_ALLGATHER:
+            if (is_pof2(nranks) && num_bytes * nranks < th->allgather_long)
+                return CODES_COL_ALGO_RECURSIVE_DOUBLING;
+            else
+                return CODES_COL_ALGO_RING;
+        case CODES_COL_ALLTOALL:
+            return CODES_COL_ALGO_PAIRWISE;
+    }
+    assert(0);
+    return CODES_COL_ALGO_AUTO;
+}
+
+void codes_col_init(
+        struct codes_col_desc *d,
+        enum codes_col_type type,
+        enum codes_col_algo algo,
+        int nranks,
+        int rank,
+        int root,
+        int64_t num_bytes,
+        struct codes_col_thresholds const *th)
+{
+    if (nranks <= 0 || rank < 0 || rank >= nranks || root < 0 ||
+            root >= nranks)
+        tw_error(TW_LOC, "invalid collective: rank %d, root %d of %d ranks\n",
+                rank, root, nranks);
+
+    if (algo == CODES_COL_ALGO_AUTO)
+        algo = algo_select(type, nranks, num_bytes,
+                th ? th : &codes_col_default_thresholds);
+    if (!algo_valid(type, algo, nranks))
+        tw_error(TW_LOC, "collective algorithm \"%s\" cannot implement "
+                "collective type %d over %d ranks\n",
+                codes_col_algo_to_str(algo), type, nranks);
+
+    d->type = type;
+    d->algo = algo;
+    d->nranks = nranks;
+    d->rank = rank;
+    d->root = root;
+    d->num_bytes = num_bytes;
+}
+
+/* recursive doubling and Rabenseifner fold the ranks beyond the largest power
+ * of two into their even neighbors first (one extra round before and after
+ * the power-of-two core when nranks isn't one) */
+static int fold_extra(struct codes_col_desc const *d)
+{
+    return d->nranks - (1 << ilog2(d->nranks));
+}
+
+static int folded_rank(int rank, int extra)
+{
+    if (rank < 2*extra)
+        return rank % 2 ? rank / 2 : -1;
+    return rank - extra;
+}
+
+static int unfolded_rank(int frank, int extra)
+{
+    return frank < extra ? frank*2 + 1 : frank + extra;
+}
+
+int codes_col_num_rounds(struct codes_col_desc const *d)
+{
+    int p = d->nranks;
+    if (p == 1)
+        return 0;
+
+    switch (d->algo) {
+        case CODES_COL_ALGO_BINOMIAL:
+            return ilog2_ceil(p);
+        case CODES_COL_ALGO_RING:
+            return d->type == CODES_COL_ALLREDUCE ? 2*(p-1) : p-1;
+        case CODES_COL_ALGO_RECURSIVE_DOUBLING:
+            if (d->type == CODES_COL_ALLGATHER)
+                return ilog2(p);
+            return ilog2(p) + (fold_extra(d) ? 2 : 0);
+        case CODES_COL_ALGO_RABENSEIFNER:
+            return 2*ilog2(p) + (fold_extra(d) ? 2 : 0);
+        case CODES_COL_ALGO_PAIRWISE:
+            return p-1;
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+/* bytes of the i-th of nranks near-equal chunks of the buffer */
+static int64_t ring_chunk(struct codes_col_desc const *d, int i)
+{
+    int64_t n = d->num_bytes, p = d->nranks;
+    return n / p + (i < n % p);
+}
+
+static void ring_step(struct codes_col_desc const *d, int round,
+        struct codes_col_step *step)
+{
+    int p = d->nranks, r = d->rank;
+    int next = mod(r+1, p), prev = mod(r-1, p);
+
+    if (d->type == CODES_COL_ALLGATHER) {
+        step_send(step, next, d->num_bytes);
+        step_recv(step, prev, d->num_bytes);
+        return;
+    }
+
+    /* reduce-scatter, then allgather of the reduced chunks */
+    int k = round < p-1 ? round : round - (p-1);
+    int off = round < p-1 ? 0 : 1;
+    step_send(step, next, ring_chunk(d, mod(r - k + off, p)));
+    step_recv(step, prev, ring_chunk(d, mod(r - k - 1 + off, p)));
+}
+
+static void folded_step(struct codes_col_desc const *d, int round,
+        struct codes_col_step *step)
+{
+    int r = d->rank;
+    int extra = fold_extra(d);
+    int nrounds = codes_col_num_rounds(d);
+    int64_t n = d->num_bytes;
+
+    if (extra) {
+        /* fold in / fan back out the ranks past the power of two */
+        if (round == 0 || round == nrounds-1) {
+            if (r >= 2*extra)
+                return;
+            int sender = (round == 0) == (r % 2 == 0);
+            int peer = r % 2 ? r-1 : r+1;
+            if (sender)
+                step_send(step, peer, n);
+            else
+                step_recv(step, peer, n);
+            return;
+        }
+        round--;
+    }
+
+    int fr = folded_rank(r, extra);
+    if (fr < 0)
+        return;
+
+    int l = ilog2(d->nranks);
+    int64_t bytes = n;
+    int mask;
+    if (d->algo == CODES_COL_ALGO_RECURSIVE_DOUBLING)
+        mask = 1 << round;
+    else if (round < l) {
+        /* recursive halving: half of what's left in each round */
+        mask = 1 << round;
+        bytes = n >> (round+1);
+    }
+    else {
+        /* and doubling back up */
+        int k = round - l;
+        mask = 1 << (l-1-k);
+        bytes = n >> (l-k);
+    }
+    step_exchange(step, unfolded_rank(fr ^ mask, extra), bytes);
+}
+
+void codes_col_get_step(
+        struct codes_col_desc const *d,
+        int round,
+        struct codes_col_step *step)
+{
+    int p = d->nranks, r = d->rank;
+    assert(round >= 0 && round < codes_col_num_rounds(d));
+    step_clear(step);
+
+    switch (d->algo) {
+        case CODES_COL_ALGO_BINOMIAL: {
+            /* positions relative to the root */
+            int l = ilog2_ceil(p);
+            int vr = mod(r - d->root, p);
+            int mask = d->type == CODES_COL_BCAST ?
+                1 << (l-1-round) : 1 << round;
+            int to_child = vr % (2*mask) == 0 && vr + mask < p;
+            int to_parent = vr % (2*mask) == mask;
+            int child = mod(vr + mask + d->root, p);
+            int parent = mod(vr - mask + d->root, p);
+            if (d->type == CODES_COL_BCAST) {
+                if (to_child)
+                    step_send(step, child, d->num_bytes);
+                if (to_parent)
+                    step_recv(step, parent, d->num_bytes);
+            }
+            else {
+                if (to_parent)
+                    step_send(step, parent, d->num_bytes);
+                if (to_child)
+                    step_recv(step, child, d->num_bytes);
+            }
+            break;
+        }
+        case CODES_COL_ALGO_RING:
+            ring_step(d, round, step);
+            break;
+        case CODES_COL_ALGO_RECURSIVE_DOUBLING:
+            if (d->type == CODES_COL_ALLGATHER)
+                step_exchange(step, r ^ (1 << round),
+                        d->num_bytes << round);
+            else
+                folded_step(d, round, step);
+            break;
+        case CODES_COL_ALGO_RABENSEIFNER:
+            folded_step(d, round, step);
+            break;
+        case CODES_COL_ALGO_PAIRWISE: {
+            int k = round + 1;
+            if (is_pof2(p))
+                step_exchange(step, r ^ k, d->num_bytes);
+            else {
+                step_send(step, mod(r + k, p), d->num_bytes);
+                step_recv(step, mod(r - k, p), d->num_bytes);
+            }
+            break;
+        }
+        default:
+            assert(0);
+    }
+}
+
+int codes_col_recv_matches(int tag, int source, int msg_tag, int msg_source,
+        int msg_is_col)
+{
+    if (tag != msg_tag && (tag != -1 || msg_is_col))
+        return 0;
+    return source == msg_source || (source == -1 && !msg_is_col);
+}
+
+enum codes_col_algo codes_col_algo_from_str(char const *str)
+{
+    for (size_t i = 0; i < sizeof(algo_names)/sizeof(algo_names[0]); i++) {
+        if (strcmp(str, algo_names[i]) == 0)
+            return (enum codes_col_algo)i;
+    }
+    tw_error(TW_LOC, "unknown collective algorithm \"%s\"\n", str);
+    return CODES_COL_ALGO_AUTO;
+}
+
+char const * codes_col_algo_to_str(enum codes_col_algo algo)
+{
+    return algo_names[algo];
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/codes-rand.h"
+
+/* multipliers and Weyl key increments of Philox-4x32 (Salmon et al., "Parallel
+ * random numbers: as easy as 1, 2, 3", SC'11) */
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+static uint32_t rand_seed = 0;
+
+void codes_rand_set_seed(uint32_t seed)
+{
+    rand_seed = seed;
+}
+
+void codes_rand_philox4x32(uint32_t ctr[4], const uint32_t key[2])
+{
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int i = 0; i < PHILOX_ROUNDS; i++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * ctr[0];
+        uint64_t p1 = (uint64_t)PHILOX_M1 * ctr[2];
+        uint32_t out[4];
+
+        out[0] = (uint32_t)(p1 >> 32) ^ ctr[1] ^ k0;
+        out[1] = (uint32_t)p1;
+        out[2] = (uint32_t)(p0 >> 32) ^ ctr[3] ^ k1;
+        out[3] = (uint32_t)p0;
+        memcpy(ctr, out, sizeof(out));
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+void codes_rand_begin(codes_rand *r, tw_lp *lp, uint32_t salt)
+{
+    double now = tw_now(lp);
+    uint64_t now_bits;
+
+    memcpy(&now_bits, &now, sizeof(now_bits));
+    r->key[0] = (uint32_t)lp->gid;
+    r->key[1] = (uint32_t)(lp->gid >> 32) ^ rand_seed;
+    r->ctr[0] = 0;
+    r->ctr[1] = salt;
+    r->ctr[2] = (uint32_t)now_bits;
+    r->ctr[3] = (uint32_t)(now_bits >> 32);
+}
+
+double codes_rand_unif(codes_rand *r)
+{
+    uint32_t out[4];
+
+    memcpy(out, r->ctr, sizeof(out));
+    codes_rand_philox4x32(out, r->key);
+    r->ctr[0]++;
+
+    /* 53 random bits, centered so that neither 0 nor 1 comes out */
+    uint64_t bits = ((uint64_t)(out[0] >> 5) << 26) | (out[1] >> 6);
+    return ((double)bits + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+long codes_rand_integer(codes_rand *r, long low, long high)
+{
+    if (high < low)
+        return low;
+    return low + (long)(codes_rand_unif(r) * (double)(high - low + 1));
+}
+
+double codes_rand_exponential(codes_rand *r, double mean)
+{
+    return -mean * log(codes_rand_unif(r));
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ft=c ts=8 sts=4 sw=4 expandtab
+ */
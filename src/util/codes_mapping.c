@@ -8,6 +8,7 @@
  * CODES custom mapping file for ROSS
  */
 #include "codes/codes_mapping.h"
+#include "codes/codes-rand.h"
 
 #define CODES_MAPPING_DEBUG 0
 
@@ -17,6 +18,37 @@
 static tw_lpid lps_per_pe_floor = 0;
 static tw_lpid lps_leftover = 0;
 
+/* LP to PE partitioning (PARAMS:pe_partition). "block" splits the LP IDs
+ * evenly using the counts above, "group" splits them at topology unit
+ * boundaries kept in pe_lp_start, "file" reads an arbitrary assignment into
+ * lp_pe/lp_local */
+enum pe_partition_type
+{
+    PE_PART_BLOCK,
+    PE_PART_GROUP,
+    PE_PART_FILE
+};
+static enum pe_partition_type pe_partition = PE_PART_BLOCK;
+/* group: first LP ID of each PE, followed by the number of LPs */
+static tw_lpid *pe_lp_start = NULL;
+/* file: PE of each LP and index of each LP on its PE */
+static int *lp_pe = NULL;
+static tw_lpid *lp_local = NULL;
+/* file: LP IDs of the LPs on this PE */
+static tw_lpid *local_gids = NULL;
+/* group, file: number of LPs on this PE */
+static tw_lpid lps_on_pe = 0;
+
+/* place contiguous LPs on the same KP (PARAMS:kp_partition="block") */
+static int kp_block = 0;
+
+#define MAX_PARTITION_HINTS 16
+static struct {
+    char lp_type_name[MAX_NAME_LENGTH];
+    int lps_per_unit;
+} partition_hints[MAX_PARTITION_HINTS];
+static int num_partition_hints = 0;
+
 static int mem_factor = 256;
 
 static int mini(int a, int b){ return a < b ? a : b; }
@@ -68,6 +100,8 @@ int codes_mapping_get_lps_for_pe()
 {
     int rank;
     MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    if (pe_partition != PE_PART_BLOCK)
+        return lps_on_pe;
 #if CODES_MAPPING_DEBUG
     printf("%d lps for rank %d\n", lps_per_pe_floor+(g_tw_mynode < lps_leftover), rank);
 #endif
@@ -77,6 +111,21 @@ int codes_mapping_get_lps_for_pe()
 /* Takes the global LP ID and returns the rank (PE id) on which the LP is mapped */
 tw_peid codes_mapping( tw_lpid gid)
 {
+    if (pe_partition == PE_PART_FILE)
+        return lp_pe[gid];
+    if (pe_partition == PE_PART_GROUP){
+        /* last PE starting at or before gid */
+        tw_peid lo = 0, hi = tw_nnodes() - 1;
+        while (lo < hi){
+            tw_peid mid = (lo + hi + 1) / 2;
+            if (pe_lp_start[mid] <= gid)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return lo;
+    }
+
     tw_lpid lps_on_pes_with_leftover = lps_leftover * (lps_per_pe_floor+1);
     if (gid < lps_on_pes_with_leftover){
         return gid / (lps_per_pe_floor+1);
@@ -456,7 +505,7 @@ static void codes_mapping_init(void)
      tw_pe * pe;
      char lp_type_name[MAX_NAME_LENGTH];
      tw_lpid nkp_per_pe = g_tw_nkp;
-     tw_lpid         lpid, kpid;
+     tw_lpid         kpid;
      const tw_lptype *lptype;
      const st_model_types *trace_type;
 
@@ -466,14 +515,20 @@ static void codes_mapping_init(void)
 
      tw_lpid lp_start =
          g_tw_mynode * lps_per_pe_floor + mini(g_tw_mynode,lps_leftover);
-     tw_lpid lp_end =
-         (g_tw_mynode+1) * lps_per_pe_floor + mini(g_tw_mynode+1,lps_leftover);
+     if (pe_partition == PE_PART_GROUP)
+         lp_start = pe_lp_start[g_tw_mynode];
+     tw_lpid nlps = codes_mapping_get_lps_for_pe();
 
-     for (lpid = lp_start; lpid < lp_end; lpid++)
+     for (ross_lid = 0; ross_lid < nlps; ross_lid++)
       {
-	 ross_gid = lpid;
-	 ross_lid = lpid - lp_start;
-	 kpid = ross_lid % g_tw_nkp;
+	 if (pe_partition == PE_PART_FILE)
+	     ross_gid = local_gids[ross_lid];
+	 else
+	     ross_gid = lp_start + ross_lid;
+	 if (kp_block)
+	     kpid = ross_lid * g_tw_nkp / nlps;
+	 else
+	     kpid = ross_lid % g_tw_nkp;
 	 pe = g_tw_pe;
 	 codes_mapping_get_lp_info(ross_gid, NULL, &grp_id, lp_type_name,
                  &lpt_id, NULL, &rep_id, &offset);
@@ -503,12 +558,133 @@ static void codes_mapping_init(void)
  * global LP IDs are unique across all PEs, local LP IDs are unique within a PE */
 static tw_lp * codes_mapping_to_lp( tw_lpid lpid)
 {
+   if (pe_partition == PE_PART_FILE)
+       return g_tw_lp[lp_local[lpid]];
+   if (pe_partition == PE_PART_GROUP)
+       return g_tw_lp[lpid - pe_lp_start[g_tw_mynode]];
+
    int index = lpid - (g_tw_mynode * lps_per_pe_floor) -
        mini(g_tw_mynode, lps_leftover);
 //   printf("\n global id %d index %d lps_before %d lps_offset %d local index %d ", lpid, index, lps_before, g_tw_mynode, local_index);
    return g_tw_lp[index];
 }
 
+void codes_mapping_add_partition_hint(const char * lp_type_name,
+        int lps_per_unit)
+{
+    if (num_partition_hints == MAX_PARTITION_HINTS)
+        tw_error(TW_LOC, "too many LP partition hints (max %d)",
+                MAX_PARTITION_HINTS);
+    strncpy(partition_hints[num_partition_hints].lp_type_name, lp_type_name,
+            MAX_NAME_LENGTH-1);
+    partition_hints[num_partition_hints].lps_per_unit = lps_per_unit;
+    num_partition_hints++;
+}
+
+/* number of repetitions of an LP group forming one topology unit */
+static int group_unit_reps(const config_lpgroup_t *lpg)
+{
+    for (int h = 0; h < num_partition_hints; h++){
+        for (int l = 0; l < lpg->lptypes_count; l++){
+            const config_lptype_t *lpt = &lpg->lptypes[l];
+            if (lpt->count > 0 &&
+                    strcmp(lpt->name.ptr, partition_hints[h].lp_type_name) == 0){
+                int reps = partition_hints[h].lps_per_unit / (int)lpt->count;
+                return reps > 1 ? reps : 1;
+            }
+        }
+    }
+    return 1;
+}
+
+/* split the LP IDs into contiguous PE ranges, as even as possible without
+ * breaking up topology units */
+static void partition_groups(tw_lpid global_nlps, int pes)
+{
+    /* unit boundaries, in increasing order */
+    tw_lpid *bounds = malloc((global_nlps + 1) * sizeof(*bounds));
+    size_t nbounds = 0;
+    tw_lpid gid = 0;
+
+    bounds[nbounds++] = 0;
+    for (int g = 0; g < lpconf.lpgroups_count; g++){
+        const config_lpgroup_t *lpg = &lpconf.lpgroups[g];
+        tw_lpid per_rep = 0;
+        for (int l = 0; l < lpg->lptypes_count; l++)
+            per_rep += lpg->lptypes[l].count;
+        int unit = group_unit_reps(lpg);
+        for (int r = 0; r < lpg->repetitions; r += unit){
+            gid += per_rep * mini(unit, lpg->repetitions - r);
+            bounds[nbounds++] = gid;
+        }
+    }
+    assert(gid == global_nlps);
+
+    pe_lp_start = malloc((pes + 1) * sizeof(*pe_lp_start));
+    pe_lp_start[0] = 0;
+    pe_lp_start[pes] = global_nlps;
+    size_t b = 0;
+    for (int p = 1; p < pes; p++){
+        tw_lpid ideal = (tw_lpid)((double)global_nlps * p / pes);
+        /* every PE keeps at least one LP */
+        tw_lpid lo = pe_lp_start[p-1] + 1, hi = global_nlps - (pes - p);
+        while (b + 1 < nbounds && bounds[b+1] <= ideal)
+            b++;
+        tw_lpid start = bounds[b];
+        if (b + 1 < nbounds && bounds[b+1] - ideal < ideal - bounds[b])
+            start = bounds[b+1];
+        if (start < lo)
+            start = lo;
+        if (start > hi)
+            start = hi;
+        pe_lp_start[p] = start;
+    }
+    free(bounds);
+
+    lps_on_pe = pe_lp_start[g_tw_mynode+1] - pe_lp_start[g_tw_mynode];
+}
+
+/* read the PE of every LP from a partition file */
+static void partition_file(tw_lpid global_nlps, int pes)
+{
+    char path[MAX_NAME_LENGTH];
+    int rank;
+    int rc = configuration_get_value_relpath(&config, "PARAMS",
+            "pe_partition_file", NULL, path, MAX_NAME_LENGTH);
+    if (rc <= 0)
+        tw_error(TW_LOC, "PARAMS:pe_partition=\"file\" requires "
+                "PARAMS:pe_partition_file");
+
+    lp_pe = malloc(global_nlps * sizeof(*lp_pe));
+    MPI_Comm_rank(MPI_COMM_CODES, &rank);
+    if (rank == 0){
+        FILE *f = fopen(path, "r");
+        if (f == NULL)
+            tw_error(TW_LOC, "unable to open LP partition file %s", path);
+        for (tw_lpid i = 0; i < global_nlps; i++){
+            if (fscanf(f, "%d", &lp_pe[i]) != 1 || lp_pe[i] < 0)
+                tw_error(TW_LOC, "LP partition file %s: expected %llu "
+                        "non-negative partition numbers, bad entry %llu",
+                        path, LLU(global_nlps), LLU(i));
+            lp_pe[i] %= pes;
+        }
+        fclose(f);
+    }
+    MPI_Bcast(lp_pe, global_nlps, MPI_INT, 0, MPI_COMM_CODES);
+
+    tw_lpid *pe_count = calloc(pes, sizeof(*pe_count));
+    lp_local = malloc(global_nlps * sizeof(*lp_local));
+    for (tw_lpid i = 0; i < global_nlps; i++)
+        lp_local[i] = pe_count[lp_pe[i]]++;
+    lps_on_pe = pe_count[g_tw_mynode];
+    free(pe_count);
+
+    local_gids = malloc(lps_on_pe * sizeof(*local_gids));
+    for (tw_lpid i = 0; i < global_nlps; i++)
+        if (lp_pe[i] == (int)g_tw_mynode)
+            local_gids[lp_local[i]] = i;
+}
+
 /* This function loads the configuration file and sets up the number of LPs on each PE */
 void codes_mapping_setup_with_seed_offset(int offset)
 {
@@ -524,6 +700,30 @@ void codes_mapping_setup_with_seed_offset(int offset)
   tw_lpid global_nlps = lps_per_pe_floor;
   lps_leftover = lps_per_pe_floor % pes;
   lps_per_pe_floor /= pes;
+
+  char part_str[MAX_NAME_LENGTH];
+  int rc = configuration_get_value(&config, "PARAMS", "pe_partition", NULL,
+          part_str, MAX_NAME_LENGTH);
+  if (rc > 0 && strcmp(part_str, "group") == 0 && global_nlps >= (tw_lpid)pes){
+      pe_partition = PE_PART_GROUP;
+      partition_groups(global_nlps, pes);
+  }
+  else if (rc > 0 && strcmp(part_str, "file") == 0){
+      pe_partition = PE_PART_FILE;
+      partition_file(global_nlps, pes);
+  }
+  else if (rc > 0 && strcmp(part_str, "block") != 0 &&
+          strcmp(part_str, "group") != 0)
+      tw_error(TW_LOC, "unknown PARAMS:pe_partition \"%s\" "
+              "(expected block, group or file)", part_str);
+
+  rc = configuration_get_value(&config, "PARAMS", "kp_partition", NULL,
+          part_str, MAX_NAME_LENGTH);
+  if (rc > 0 && strcmp(part_str, "block") == 0)
+      kp_block = 1;
+  else if (rc > 0 && strcmp(part_str, "round-robin") != 0)
+      tw_error(TW_LOC, "unknown PARAMS:kp_partition \"%s\" "
+              "(expected round-robin or block)", part_str);
  //printf("\n LPs for this PE are %d reps %d ", lps_per_pe_floor,  lpconf.lpgroups[grp].repetitions);
   g_tw_mapping=CUSTOM;
   g_tw_custom_initial_mapping=&codes_mapping_init;
@@ -531,7 +731,7 @@ void codes_mapping_setup_with_seed_offset(int offset)
 
   // configure mem-factor
   int mem_factor_conf;
-  int rc = configuration_get_value_int(&config, "PARAMS", "pe_mem_factor", NULL,
+  rc = configuration_get_value_int(&config, "PARAMS", "pe_mem_factor", NULL,
           &mem_factor_conf);
   if (rc == 0 && mem_factor_conf > 0)
     mem_factor = mem_factor_conf;
@@ -556,6 +756,7 @@ void codes_mapping_setup_with_seed_offset(int offset)
   // ross/rand-clcg4.c for the specific computation
   // an "offset" < 0 is ignored
   if (offset > 0){
+      codes_rand_set_seed(offset);
       for (tw_lpid l = 0; l < g_tw_nlp; l++){
           for (unsigned int i = 0; i < g_tw_nRNG_per_lp; i++){
               tw_rand_initial_seed(&g_tw_lp[l]->rng[i], (g_tw_lp[l]->gid +
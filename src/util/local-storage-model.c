@@ -14,6 +14,7 @@
 #include <codes/local-storage-model.h>
 #include <codes/quicklist.h>
 #include <codes/rc-stack.h>
+#include <codes/param-table.h>
 
 #define CATEGORY_NAME_MAX 16
 #define CATEGORY_MAX 12
@@ -33,8 +34,36 @@ typedef struct lsm_stats_s
     long write_bytes;
     long write_seeks;
     tw_stime write_time;
+    /* page cache statistics (in pages, bytes where noted) */
+    long cache_read_hits;
+    long cache_read_misses;
+    long cache_write_hits;
+    long cache_write_misses;
+    long cache_evictions;
+    long cache_writeback_bytes;
+    long cache_readahead_bytes;
 } lsm_stats_t;
 
+/*
+ * columns of the per-direction disk parameter tables
+ */
+enum lsm_param_col
+{
+    LSM_COL_RATE,
+    LSM_COL_SEEK,
+    LSM_COL_OVERHEAD,
+    LSM_NUM_COLS
+};
+
+/*
+ * page cache replacement policies
+ */
+enum lsm_cache_policy
+{
+    LSM_CACHE_LRU,
+    LSM_CACHE_CLOCK
+};
+
 /*
  * disk model parameters
  */
@@ -48,10 +77,32 @@ typedef struct disk_model_s
     double *write_seeks;
     double *read_seeks;
     unsigned int bins;
+    // per-size lookup tables built from the above (see transfer_time_table)
+    struct codes_ptable *write_table;
+    struct codes_ptable *read_table;
     // sched params
     //   0  - no scheduling
     //  >0  - make scheduler with use_sched priority lanes
     int use_sched;
+    // queued requests within this many bytes of each other on the same
+    // object are merged (0 -> no merging)
+    long sched_merge_window;
+    // page cache params (cache_size == 0 -> no cache)
+    long cache_size;            // bytes
+    int cache_page_size;        // bytes
+    enum lsm_cache_policy cache_policy;
+    int cache_writeback;        // 0 - write-through, 1 - write-back
+    double cache_dirty_ratio;   // fraction of pages allowed to be dirty
+    int cache_readahead;        // pages prefetched on sequential misses
+    double cache_rate;          // MiB/s
+    double cache_overhead;      // microseconds
+    // flash device params (device_channels == 0 -> single disk)
+    int device_channels;
+    long device_stripe_size;    // bytes
+    int device_queues;
+    int device_queue_depth;
+    // request overhead multiplier by number of requests in flight
+    struct codes_ptable *device_qd_table;
 } disk_model_t;
 
 /*
@@ -76,8 +127,12 @@ typedef struct lsm_message_data_s
  */
 typedef struct lsm_sched_op_s
 {
+    lsm_event_t event;
     lsm_message_data_t data;
+    struct codes_cb_params cb;
     struct qlist_head ql;
+    // requests merged into this one, completed along with it
+    struct qlist_head merged;
 } lsm_sched_op_t;
 
 /*
@@ -92,8 +147,108 @@ typedef struct lsm_sched_s
     // scheduler mallocs data per-request - hold onto and free later
     struct rc_stack *freelist;
     struct qlist_head *queues;
+    // request in service, if it was taken off a queue (NULL if issued
+    // directly)
+    lsm_sched_op_t *cur;
 } lsm_sched_t;
 
+/*
+ * lsm_cache_page_t - a page frame of the host page cache
+ *   - frames are linked into a hash chain by (object, page) and, for LRU, into
+ *     a recency list (head = most recently used). Free frames are chained
+ *     through lru_next
+ */
+typedef struct lsm_cache_page_s
+{
+    uint64_t object;
+    uint64_t page;
+    int valid;
+    int dirty;
+    int ref; // clock reference bit
+    int lru_prev;
+    int lru_next;
+    int hash_next;
+} lsm_cache_page_t;
+
+/*
+ * lsm_cache_hdr_t - scalar cache state, saved wholesale for reverse
+ *   computation on every cached request
+ */
+typedef struct lsm_cache_hdr_s
+{
+    tw_stime next_idle; // next time the memory copy path is idle
+    int lru_head;
+    int lru_tail;
+    int free_head;
+    int clock_hand;
+    int num_dirty;
+    // sequential read stream detection for read-ahead
+    uint64_t ra_object;
+    uint64_t ra_next_offset;
+} lsm_cache_hdr_t;
+
+/*
+ * lsm_cache_undo_t - undo log of a single cached request. Every frame and
+ *   hash bucket is saved before it is modified; reverse computation replays
+ *   the log backwards
+ */
+typedef struct lsm_cache_undo_ent_s
+{
+    int is_bucket;
+    int idx;
+    union {
+        lsm_cache_page_t page;
+        int bucket;
+    } old;
+} lsm_cache_undo_ent_t;
+
+typedef struct lsm_cache_undo_s
+{
+    lsm_cache_hdr_t hdr;
+    int count;
+    int cap;
+    lsm_cache_undo_ent_t *ents;
+} lsm_cache_undo_t;
+
+/*
+ * lsm_cache_t - optional host page cache / write-back buffer in front of
+ *   the disk
+ */
+typedef struct lsm_cache_s
+{
+    lsm_cache_hdr_t hdr;
+    int num_pages; // 0 -> cache disabled
+    int dirty_max;
+    uint64_t bucket_mask;
+    lsm_cache_page_t *pages;
+    int *buckets;
+    // undo logs (only kept in optimistic modes)
+    int log_undo;
+    lsm_cache_undo_t *cur_undo;
+    struct rc_stack *undo;
+} lsm_cache_t;
+
+/*
+ * lsm_device_t - multi-queue, multi-channel (flash) device state
+ *   - requests are assigned a submission queue by sender, each queue holding
+ *     at most device_queue_depth requests in flight. Excess requests wait in
+ *     the queue's pending list until one of its requests completes
+ *   - requests are striped over the channels by offset, each channel being
+ *     busy until chan_next_idle
+ */
+typedef struct lsm_device_s
+{
+    int inflight;
+    int *queue_inflight;
+    struct qlist_head *pending;
+    tw_stime *chan_next_idle;
+    // pending requests that were dispatched - hold onto and free later
+    struct rc_stack *freelist;
+    // channel busy times prior to each request (only in optimistic modes)
+    int log_idle;
+    struct rc_stack *saved_idle;
+} lsm_device_t;
+
 /*
  * lsm_state_s
  *   - state tracking structure for each LP node
@@ -112,6 +267,10 @@ typedef struct lsm_state_s
     /* scheduling state */
     int use_sched;
     lsm_sched_t sched;
+    /* page cache state */
+    lsm_cache_t cache;
+    /* flash device state (device_channels > 0) */
+    lsm_device_t dev;
 } lsm_state_t;
 
 /*
@@ -130,6 +289,10 @@ typedef struct lsm_message_s
     lsm_stats_t prev_stat;
     int64_t     prev_offset;
     uint64_t    prev_object;
+    // queued op this request was merged into and its prior size (prior
+    // offset in prev_offset)
+    struct lsm_sched_op_s *prev_merge;
+    uint64_t    prev_size;
     lsm_message_data_t data;
     struct codes_cb_params cb;
 } lsm_message_t;
@@ -143,14 +306,19 @@ static void lsm_rev_event (lsm_state_t *ns, tw_bf *b, lsm_message_t *m, tw_lp *l
 static void lsm_finalize (lsm_state_t *ns, tw_lp *lp);
 static void handle_io_sched_new(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
 static void handle_rev_io_sched_new(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
-static void handle_io_request(lsm_state_t *ns, tw_bf *b, lsm_message_data_t *data, lsm_message_t *m_in, tw_lp *lp);
+static void handle_io_dev_new(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
+static void handle_rev_io_dev_new(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
+static void handle_io_dev_compl(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
+static void handle_rev_io_dev_compl(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
+static void handle_io_request(lsm_state_t *ns, tw_bf *b, lsm_event_t event, lsm_message_data_t *data, struct codes_cb_params const *cb, lsm_message_t *m_in, tw_lp *lp);
 static void handle_rev_io_request(lsm_state_t *ns, tw_bf *b, lsm_message_data_t *data, lsm_message_t *m_in, tw_lp *lp);
 static void handle_io_sched_compl(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
 static void handle_rev_io_sched_compl(lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
+static void send_io_callback(struct codes_cb_params const *cb, tw_lp *lp);
 static void handle_io_completion (lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
 static void handle_rev_io_completion (lsm_state_t *ns, tw_bf *b, lsm_message_t *m_in, tw_lp *lp);
 static lsm_stats_t *find_stats(const char* category, lsm_state_t *ns);
-static void write_stats(tw_lp* lp, lsm_stats_t* stat);
+static void write_stats(tw_lp* lp, lsm_stats_t* stat, int with_cache);
 
 /*
  * Globals
@@ -190,36 +358,17 @@ static tw_stime transfer_time_table (lsm_state_t *ns,
 {
     double mb;
     double time = 0.0;
+    double params[LSM_NUM_COLS];
     double disk_rate;
     double disk_seek;
     double disk_overhead;
-    unsigned int i;
-
-    /* find nearest size rounded down. */
-    for (i = 0; i < ns->model->bins; i++)
-    {
-        if (ns->model->request_sizes[i] > size)
-        {
-            break;
-        }
-    }
-    if (i > 0) i--;
-
-    if (rw)
-    {
-        /* read */
-        disk_rate = ns->model->read_rates[i];
-        disk_seek = ns->model->read_seeks[i];
-        disk_overhead = ns->model->read_overheads[i];
-    }
-    else
-    {
-        /* write */
-        disk_rate = ns->model->write_rates[i];
-        disk_seek = ns->model->write_seeks[i];
-        disk_overhead = ns->model->write_overheads[i];
 
-    }
+    /* find nearest size rounded down (or interpolate, if configured) */
+    codes_ptable_lookup(rw ? ns->model->read_table : ns->model->write_table,
+            size, params);
+    disk_rate = params[LSM_COL_RATE];
+    disk_seek = params[LSM_COL_SEEK];
+    disk_overhead = params[LSM_COL_OVERHEAD];
 
     /* transfer time */
     mb = ((double)size) / (1024.0 * 1024.0);
@@ -255,6 +404,533 @@ static tw_stime transfer_time_table (lsm_state_t *ns,
     return time;
 }
 
+/*
+ * device_transfer
+ *   - flash device mode: spreads bytes[c] over the channels and returns the
+ *     completion time of a request submitted at 'earliest'. Channels are
+ *     busy for their share of the transfer; the request overhead (scaled by
+ *     the number of requests in flight) is paid once, after the data moved
+ */
+static tw_stime device_transfer(lsm_state_t *ns,
+                                lsm_stats_t *stat,
+                                int rw,
+                                uint64_t size,
+                                uint64_t const *bytes,
+                                tw_stime earliest)
+{
+    double params[LSM_NUM_COLS];
+    double qd_scale;
+    tw_stime done = earliest;
+    tw_stime busy = 0.0;
+
+    codes_ptable_lookup(rw ? ns->model->read_table : ns->model->write_table,
+            size, params);
+    codes_ptable_lookup(ns->model->device_qd_table, ns->dev.inflight,
+            &qd_scale);
+
+    for (int c = 0; c < ns->model->device_channels; c++)
+    {
+        if (bytes[c] == 0)
+            continue;
+        double mb = ((double)bytes[c]) / (1024.0 * 1024.0);
+        tw_stime t = (mb / params[LSM_COL_RATE]) * 1000.0 * 1000.0 * 1000.0;
+        tw_stime start = ns->dev.chan_next_idle[c] > earliest ?
+            ns->dev.chan_next_idle[c] : earliest;
+        ns->dev.chan_next_idle[c] = start + t;
+        if (ns->dev.chan_next_idle[c] > done)
+            done = ns->dev.chan_next_idle[c];
+        if (t > busy)
+            busy = t;
+    }
+    done += params[LSM_COL_OVERHEAD] * 1000.0 * qd_scale;
+    busy += params[LSM_COL_OVERHEAD] * 1000.0 * qd_scale;
+
+    if (rw)
+    {
+        stat->read_count += 1;
+        stat->read_bytes += size;
+        stat->read_time  += busy;
+    }
+    else
+    {
+        stat->write_count += 1;
+        stat->write_bytes += size;
+        stat->write_time  += busy;
+    }
+
+    return done;
+}
+
+/*
+ * disk_access
+ *   - performs an access starting no earlier than 'earliest' and returns the
+ *     time it completes
+ *   - single disk: serialized through next_idle, with seek tracking
+ *   - flash device: the access is striped over the channels by offset in
+ *     device_stripe_size units, starting at a channel picked by the object
+ */
+static tw_stime disk_access(lsm_state_t *ns,
+                            lsm_stats_t *stat,
+                            int rw,
+                            uint64_t object,
+                            int64_t offset,
+                            uint64_t size,
+                            tw_stime earliest)
+{
+    if (ns->model->device_channels == 0)
+    {
+        tw_stime start = ns->next_idle > earliest ? ns->next_idle : earliest;
+        ns->next_idle = start +
+            transfer_time_table(ns, stat, rw, object, offset, size);
+        ns->current_offset = offset + size;
+        ns->current_object = object;
+        return ns->next_idle;
+    }
+
+    int nchan = ns->model->device_channels;
+    uint64_t stripe = ns->model->device_stripe_size;
+    uint64_t bytes[nchan];
+    memset(bytes, 0, sizeof(bytes));
+    if (size > 0)
+    {
+        /* stripe counts per channel, trimmed by the partial first and last
+         * stripes */
+        uint64_t first = offset / stripe;
+        uint64_t last = (offset + size - 1) / stripe;
+        uint64_t n = last - first + 1;
+        int c0 = (int)((first + object) % nchan);
+        for (uint64_t k = 0; k < n && k < (uint64_t)nchan; k++)
+            bytes[(c0 + k) % nchan] = ((n - k + nchan - 1) / nchan) * stripe;
+        bytes[c0] -= offset - first * stripe;
+        bytes[(c0 + (n-1)) % nchan] -= (last + 1) * stripe - (offset + size);
+    }
+    return device_transfer(ns, stat, rw, size, bytes, earliest);
+}
+
+/*
+ * disk_writeback
+ *   - writes bytes of scattered dirty pages back to disk, starting no
+ *     earlier than 'earliest' and returning the completion time
+ *   - single disk: always pays a seek, doesn't move the disk head tracking
+ *   - flash device: the pages are spread evenly over the channels
+ */
+static tw_stime disk_writeback(lsm_state_t *ns,
+                               lsm_stats_t *stat,
+                               uint64_t bytes,
+                               tw_stime earliest)
+{
+    stat->cache_writeback_bytes += bytes;
+
+    if (ns->model->device_channels > 0)
+    {
+        int nchan = ns->model->device_channels;
+        uint64_t per_chan[nchan];
+        for (int c = 0; c < nchan; c++)
+            per_chan[c] = bytes / nchan + ((uint64_t)c < bytes % nchan);
+        return device_transfer(ns, stat, 0, bytes, per_chan, earliest);
+    }
+
+    double params[LSM_NUM_COLS];
+    double mb;
+    tw_stime time;
+
+    codes_ptable_lookup(ns->model->write_table, bytes, params);
+    mb = ((double)bytes) / (1024.0 * 1024.0);
+    time = (mb / params[LSM_COL_RATE]) * 1000.0 * 1000.0 * 1000.0;
+    time += params[LSM_COL_OVERHEAD] * 1000.0;
+    time += params[LSM_COL_SEEK] * 1000.0;
+
+    stat->write_count += 1;
+    stat->write_bytes += bytes;
+    stat->write_seeks += 1;
+    stat->write_time  += time;
+
+    tw_stime start = ns->next_idle > earliest ? ns->next_idle : earliest;
+    ns->next_idle = start + time;
+    return ns->next_idle;
+}
+
+/*
+ * cache_copy_time
+ *   - time to move size bytes between the caller and the page cache
+ */
+static tw_stime cache_copy_time(lsm_state_t *ns, uint64_t size)
+{
+    double mb = ((double)size) / (1024.0 * 1024.0);
+    return (mb / ns->model->cache_rate) * 1000.0 * 1000.0 * 1000.0 +
+        ns->model->cache_overhead * 1000.0;
+}
+
+/*
+ * page cache internals
+ *   - all frame/bucket modifications go through cache_page_mod and
+ *     cache_bucket_set, which record the previous contents in the undo log of
+ *     the current request (if any)
+ */
+static void cache_undo_free(void *ptr)
+{
+    lsm_cache_undo_t *u = ptr;
+    free(u->ents);
+    free(u);
+}
+
+static lsm_cache_undo_ent_t *cache_undo_next(lsm_cache_t *c)
+{
+    lsm_cache_undo_t *u = c->cur_undo;
+    if (u->count == u->cap) {
+        u->cap = u->cap ? 2 * u->cap : 8;
+        u->ents = realloc(u->ents, u->cap * sizeof(*u->ents));
+        assert(u->ents);
+    }
+    return &u->ents[u->count++];
+}
+
+static lsm_cache_page_t *cache_page_mod(lsm_cache_t *c, int idx)
+{
+    if (c->cur_undo) {
+        lsm_cache_undo_ent_t *ent = cache_undo_next(c);
+        ent->is_bucket = 0;
+        ent->idx = idx;
+        ent->old.page = c->pages[idx];
+    }
+    return &c->pages[idx];
+}
+
+static void cache_bucket_set(lsm_cache_t *c, int b, int val)
+{
+    if (c->cur_undo) {
+        lsm_cache_undo_ent_t *ent = cache_undo_next(c);
+        ent->is_bucket = 1;
+        ent->idx = b;
+        ent->old.bucket = c->buckets[b];
+    }
+    c->buckets[b] = val;
+}
+
+static void cache_undo_begin(lsm_cache_t *c, tw_lp *lp)
+{
+    if (!c->log_undo)
+        return;
+    rc_stack_gc(lp, c->undo);
+    lsm_cache_undo_t *u = malloc(sizeof(*u));
+    assert(u);
+    u->hdr = c->hdr;
+    u->count = 0;
+    u->cap = 0;
+    u->ents = NULL;
+    c->cur_undo = u;
+}
+
+static void cache_undo_end(lsm_cache_t *c, tw_lp *lp)
+{
+    if (!c->log_undo)
+        return;
+    rc_stack_push(lp, c->cur_undo, cache_undo_free, c->undo);
+    c->cur_undo = NULL;
+}
+
+static void cache_undo_rev(lsm_cache_t *c)
+{
+    if (!c->log_undo)
+        return;
+    lsm_cache_undo_t *u = rc_stack_pop(c->undo);
+    for (int i = u->count-1; i >= 0; i--) {
+        lsm_cache_undo_ent_t *ent = &u->ents[i];
+        if (ent->is_bucket)
+            c->buckets[ent->idx] = ent->old.bucket;
+        else
+            c->pages[ent->idx] = ent->old.page;
+    }
+    c->hdr = u->hdr;
+    cache_undo_free(u);
+}
+
+static inline int cache_bucket(lsm_cache_t const *c, uint64_t object,
+        uint64_t page)
+{
+    uint64_t h = object * 0x9E3779B97F4A7C15ULL ^
+        (page + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+    return (int)((h ^ (h >> 29)) & c->bucket_mask);
+}
+
+static int cache_find(lsm_cache_t const *c, uint64_t object, uint64_t page)
+{
+    int idx = c->buckets[cache_bucket(c, object, page)];
+    while (idx >= 0) {
+        lsm_cache_page_t const *pg = &c->pages[idx];
+        if (pg->object == object && pg->page == page)
+            return idx;
+        idx = pg->hash_next;
+    }
+    return -1;
+}
+
+static void cache_hash_remove(lsm_cache_t *c, int idx)
+{
+    lsm_cache_page_t const *pg = &c->pages[idx];
+    int b = cache_bucket(c, pg->object, pg->page);
+    if (c->buckets[b] == idx)
+        cache_bucket_set(c, b, pg->hash_next);
+    else {
+        int prev = c->buckets[b];
+        while (c->pages[prev].hash_next != idx)
+            prev = c->pages[prev].hash_next;
+        cache_page_mod(c, prev)->hash_next = pg->hash_next;
+    }
+}
+
+static void cache_lru_unlink(lsm_cache_t *c, int idx)
+{
+    lsm_cache_page_t *pg = cache_page_mod(c, idx);
+    if (pg->lru_prev >= 0)
+        cache_page_mod(c, pg->lru_prev)->lru_next = pg->lru_next;
+    else
+        c->hdr.lru_head = pg->lru_next;
+    if (pg->lru_next >= 0)
+        cache_page_mod(c, pg->lru_next)->lru_prev = pg->lru_prev;
+    else
+        c->hdr.lru_tail = pg->lru_prev;
+    pg->lru_prev = pg->lru_next = -1;
+}
+
+static void cache_lru_push(lsm_cache_t *c, int idx)
+{
+    lsm_cache_page_t *pg = cache_page_mod(c, idx);
+    pg->lru_prev = -1;
+    pg->lru_next = c->hdr.lru_head;
+    if (c->hdr.lru_head >= 0)
+        cache_page_mod(c, c->hdr.lru_head)->lru_prev = idx;
+    else
+        c->hdr.lru_tail = idx;
+    c->hdr.lru_head = idx;
+}
+
+/* record an access to a resident page */
+static void cache_touch(lsm_cache_t *c, enum lsm_cache_policy policy,
+        int idx)
+{
+    if (policy == LSM_CACHE_LRU) {
+        if (c->hdr.lru_head != idx) {
+            cache_lru_unlink(c, idx);
+            cache_lru_push(c, idx);
+        }
+    }
+    else if (!c->pages[idx].ref)
+        cache_page_mod(c, idx)->ref = 1;
+}
+
+/* pick and release a frame, returning 1 if it held dirty data */
+static int cache_evict(lsm_cache_t *c, enum lsm_cache_policy policy,
+        int *idx_out)
+{
+    int idx;
+    if (policy == LSM_CACHE_LRU) {
+        idx = c->hdr.lru_tail;
+        cache_lru_unlink(c, idx);
+    }
+    else {
+        while (c->pages[c->hdr.clock_hand].ref) {
+            cache_page_mod(c, c->hdr.clock_hand)->ref = 0;
+            c->hdr.clock_hand = (c->hdr.clock_hand + 1) % c->num_pages;
+        }
+        idx = c->hdr.clock_hand;
+        c->hdr.clock_hand = (c->hdr.clock_hand + 1) % c->num_pages;
+    }
+    cache_hash_remove(c, idx);
+    int was_dirty = c->pages[idx].dirty;
+    if (was_dirty)
+        c->hdr.num_dirty--;
+    *idx_out = idx;
+    return was_dirty;
+}
+
+/* insert a non-resident page. Returns 1 if a dirty page had to be evicted to
+ * make room */
+static int cache_insert(lsm_state_t *ns, lsm_stats_t *stat, uint64_t object,
+        uint64_t page, int dirty)
+{
+    lsm_cache_t *c = &ns->cache;
+    enum lsm_cache_policy policy = ns->model->cache_policy;
+    int idx, evicted_dirty = 0;
+
+    if (c->hdr.free_head >= 0) {
+        idx = c->hdr.free_head;
+        c->hdr.free_head = c->pages[idx].lru_next;
+    }
+    else {
+        evicted_dirty = cache_evict(c, policy, &idx);
+        stat->cache_evictions++;
+    }
+
+    int b = cache_bucket(c, object, page);
+    lsm_cache_page_t *pg = cache_page_mod(c, idx);
+    pg->object = object;
+    pg->page = page;
+    pg->valid = 1;
+    pg->dirty = dirty;
+    pg->ref = 1;
+    pg->lru_prev = pg->lru_next = -1;
+    pg->hash_next = c->buckets[b];
+    cache_bucket_set(c, b, idx);
+    if (policy == LSM_CACHE_LRU)
+        cache_lru_push(c, idx);
+    if (dirty)
+        c->hdr.num_dirty++;
+    return evicted_dirty;
+}
+
+/* write dirty pages back until at most half of the dirty limit remains,
+ * oldest first. Returns the number of pages cleaned */
+static uint64_t cache_flush(lsm_state_t *ns)
+{
+    lsm_cache_t *c = &ns->cache;
+    int target = c->dirty_max / 2;
+    uint64_t cleaned = 0;
+
+    if (ns->model->cache_policy == LSM_CACHE_LRU) {
+        int idx = c->hdr.lru_tail;
+        while (idx >= 0 && c->hdr.num_dirty > target) {
+            if (c->pages[idx].dirty) {
+                cache_page_mod(c, idx)->dirty = 0;
+                c->hdr.num_dirty--;
+                cleaned++;
+            }
+            idx = c->pages[idx].lru_prev;
+        }
+    }
+    else {
+        for (int i = 0; i < c->num_pages && c->hdr.num_dirty > target; i++) {
+            int idx = (c->hdr.clock_hand + i) % c->num_pages;
+            if (c->pages[idx].valid && c->pages[idx].dirty) {
+                cache_page_mod(c, idx)->dirty = 0;
+                c->hdr.num_dirty--;
+                cleaned++;
+            }
+        }
+    }
+    return cleaned;
+}
+
+/*
+ * cache_io_request
+ *   - services a request through the page cache, going to disk for read
+ *     misses (plus read-ahead on sequential streams), write-through, dirty
+ *     evictions and dirty-limit flushing
+ *   - returns the delay until the request completes
+ */
+static tw_stime cache_io_request(lsm_state_t *ns,
+                                 lsm_stats_t *stat,
+                                 int rw,
+                                 lsm_message_data_t const *data,
+                                 tw_lp *lp)
+{
+    lsm_cache_t *c = &ns->cache;
+    disk_model_t const *model = ns->model;
+    uint64_t psz = model->cache_page_size;
+    uint64_t first = data->offset / psz;
+    uint64_t last = data->size ?
+        (data->offset + data->size - 1) / psz : first;
+    uint64_t miss_first = 0, miss_last = 0, wb_pages = 0, p;
+    int missed = 0;
+    tw_stime now = tw_now(lp);
+    tw_stime done;
+
+    cache_undo_begin(c, lp);
+
+    if (rw) {
+        int sequential = data->object == c->hdr.ra_object &&
+            data->offset == c->hdr.ra_next_offset;
+        c->hdr.ra_object = data->object;
+        c->hdr.ra_next_offset = data->offset + data->size;
+
+        for (p = first; p <= last; p++) {
+            int idx = cache_find(c, data->object, p);
+            if (idx >= 0) {
+                stat->cache_read_hits++;
+                cache_touch(c, model->cache_policy, idx);
+            }
+            else {
+                stat->cache_read_misses++;
+                if (!missed)
+                    miss_first = p;
+                miss_last = p;
+                missed = 1;
+            }
+        }
+
+        if (!missed) {
+            tw_stime start = c->hdr.next_idle > now ? c->hdr.next_idle : now;
+            c->hdr.next_idle = start + cache_copy_time(ns, data->size);
+            done = c->hdr.next_idle;
+        }
+        else {
+            /* read the missing span (and read-ahead) from the disk in one
+             * request */
+            uint64_t ra_last = miss_last;
+            if (sequential && model->cache_readahead > 0)
+                ra_last += model->cache_readahead;
+            for (p = miss_first; p <= ra_last; p++) {
+                if (cache_find(c, data->object, p) < 0)
+                    wb_pages += cache_insert(ns, stat, data->object, p, 0);
+            }
+            stat->cache_readahead_bytes += (ra_last - miss_last) * psz;
+
+            tw_stime t = now;
+            if (wb_pages)
+                t = disk_writeback(ns, stat, wb_pages * psz, t);
+            t = disk_access(ns, stat, 1, data->object, miss_first * psz,
+                    (ra_last - miss_first + 1) * psz, t);
+            done = t + cache_copy_time(ns, data->size);
+        }
+    }
+    else {
+        for (p = first; p <= last; p++) {
+            int idx = cache_find(c, data->object, p);
+            if (idx >= 0) {
+                stat->cache_write_hits++;
+                cache_touch(c, model->cache_policy, idx);
+                if (model->cache_writeback && !c->pages[idx].dirty) {
+                    cache_page_mod(c, idx)->dirty = 1;
+                    c->hdr.num_dirty++;
+                }
+            }
+            else {
+                stat->cache_write_misses++;
+                wb_pages += cache_insert(ns, stat, data->object, p,
+                        model->cache_writeback);
+            }
+        }
+
+        tw_stime start = c->hdr.next_idle > now ? c->hdr.next_idle : now;
+        c->hdr.next_idle = start + cache_copy_time(ns, data->size);
+        done = c->hdr.next_idle;
+
+        if (wb_pages || !model->cache_writeback) {
+            /* the request has to wait on the disk: for evicted dirty
+             * pages and/or for the data itself when writing through */
+            tw_stime t = now;
+            if (wb_pages)
+                t = disk_writeback(ns, stat, wb_pages * psz, t);
+            if (!model->cache_writeback)
+                t = disk_access(ns, stat, 0, data->object, data->offset,
+                        data->size, t);
+            if (t > done)
+                done = t;
+        }
+
+        /* past the dirty limit, flush in the background - this only holds
+         * up later disk accesses */
+        if (c->hdr.num_dirty > c->dirty_max) {
+            uint64_t cleaned = cache_flush(ns);
+            disk_writeback(ns, stat, cleaned * psz, now);
+        }
+    }
+
+    cache_undo_end(c, lp);
+
+    return done - now;
+}
+
 void lsm_io_event_rc(tw_lp *sender)
 {
     codes_local_latency_reverse(sender);
@@ -383,6 +1059,61 @@ static void lsm_lp_init (lsm_state_t *ns, tw_lp *lp)
             INIT_QLIST_HEAD(&ns->sched.queues[i]);
     }
 
+    // initialize the page cache if need be
+    if (ns->model->cache_size > 0)
+    {
+        lsm_cache_t *c = &ns->cache;
+        uint64_t nbuckets = 1;
+        c->num_pages = ns->model->cache_size / ns->model->cache_page_size;
+        assert(c->num_pages > 0);
+        c->dirty_max = (int)(ns->model->cache_dirty_ratio * c->num_pages);
+        while (nbuckets < (uint64_t)c->num_pages)
+            nbuckets <<= 1;
+        c->bucket_mask = nbuckets - 1;
+        c->pages = malloc(c->num_pages * sizeof(*c->pages));
+        c->buckets = malloc(nbuckets * sizeof(*c->buckets));
+        assert(c->pages && c->buckets);
+        for (uint64_t i = 0; i < nbuckets; i++)
+            c->buckets[i] = -1;
+        for (int i = 0; i < c->num_pages; i++)
+        {
+            memset(&c->pages[i], 0, sizeof(c->pages[i]));
+            c->pages[i].lru_prev = -1;
+            c->pages[i].lru_next = (i+1 < c->num_pages) ? i+1 : -1;
+            c->pages[i].hash_next = -1;
+        }
+        c->hdr.next_idle = tw_now(lp);
+        c->hdr.lru_head = c->hdr.lru_tail = -1;
+        c->hdr.free_head = 0;
+        c->hdr.ra_object = UINT64_MAX;
+        c->log_undo = g_tw_synchronization_protocol == OPTIMISTIC ||
+            g_tw_synchronization_protocol == OPTIMISTIC_DEBUG ||
+            g_tw_synchronization_protocol == OPTIMISTIC_REALTIME;
+        if (c->log_undo)
+            rc_stack_create(&c->undo);
+    }
+
+    // initialize the flash device if need be
+    if (ns->model->device_channels > 0)
+    {
+        lsm_device_t *d = &ns->dev;
+        d->queue_inflight =
+            calloc(ns->model->device_queues, sizeof(*d->queue_inflight));
+        d->pending = malloc(ns->model->device_queues * sizeof(*d->pending));
+        d->chan_next_idle =
+            malloc(ns->model->device_channels * sizeof(*d->chan_next_idle));
+        assert(d->queue_inflight && d->pending && d->chan_next_idle);
+        for (int i = 0; i < ns->model->device_queues; i++)
+            INIT_QLIST_HEAD(&d->pending[i]);
+        for (int i = 0; i < ns->model->device_channels; i++)
+            d->chan_next_idle[i] = tw_now(lp);
+        rc_stack_create(&d->freelist);
+        d->log_idle = g_tw_synchronization_protocol == OPTIMISTIC ||
+            g_tw_synchronization_protocol == OPTIMISTIC_DEBUG ||
+            g_tw_synchronization_protocol == OPTIMISTIC_REALTIME;
+        rc_stack_create(&d->saved_idle);
+    }
+
     return;
 }
 
@@ -409,8 +1140,10 @@ static void lsm_event (lsm_state_t *ns, tw_bf *b, lsm_message_t *m, tw_lp *lp)
             assert(ns->model);
             if (ns->use_sched)
                 handle_io_sched_new(ns, b, m, lp);
+            else if (ns->model->device_channels > 0)
+                handle_io_dev_new(ns, b, m, lp);
             else
-                handle_io_request(ns, b, &m->data, m, lp);
+                handle_io_request(ns, b, m->event, &m->data, &m->cb, m, lp);
             break;
         case LSM_WRITE_COMPLETION:
         case LSM_READ_COMPLETION:
@@ -452,6 +1185,8 @@ static void lsm_rev_event(lsm_state_t *ns,
                     (unsigned long long)m->data.size);
             if (ns->use_sched)
                 handle_rev_io_sched_new(ns, b, m, lp);
+            else if (ns->model->device_channels > 0)
+                handle_rev_io_dev_new(ns, b, m, lp);
             else
                 handle_rev_io_request(ns, b, &m->data, m, lp);
             break;
@@ -497,16 +1232,70 @@ static void lsm_finalize(lsm_state_t *ns,
             all.read_bytes += ns->lsm_stats_array[i].read_bytes;
             all.read_seeks += ns->lsm_stats_array[i].read_seeks;
             all.read_time += ns->lsm_stats_array[i].read_time;
-
-            write_stats(lp, &ns->lsm_stats_array[i]);
+            all.cache_read_hits += ns->lsm_stats_array[i].cache_read_hits;
+            all.cache_read_misses += ns->lsm_stats_array[i].cache_read_misses;
+            all.cache_write_hits += ns->lsm_stats_array[i].cache_write_hits;
+            all.cache_write_misses += ns->lsm_stats_array[i].cache_write_misses;
+            all.cache_evictions += ns->lsm_stats_array[i].cache_evictions;
+            all.cache_writeback_bytes +=
+                ns->lsm_stats_array[i].cache_writeback_bytes;
+            all.cache_readahead_bytes +=
+                ns->lsm_stats_array[i].cache_readahead_bytes;
+
+            write_stats(lp, &ns->lsm_stats_array[i], ns->cache.num_pages > 0);
         }
     }
 
-    write_stats(lp, &all);
+    write_stats(lp, &all, ns->cache.num_pages > 0);
 
     return;
 }
 
+static void sched_op_free(void *p)
+{
+    lsm_sched_op_t *op = p;
+    struct qlist_head *ent;
+    while ((ent = qlist_pop(&op->merged)) != NULL)
+        free(qlist_entry(ent, lsm_sched_op_t, ql));
+    free(op);
+}
+
+/*
+ * sched_find_merge
+ *   - elevator merge: find a queued request on the same object, of the same
+ *     type and category, that the new request overlaps or abuts such that the
+ *     merged request spans at most sched_merge_window bytes. Searches from
+ *     the back of the queue, where the latest requests (those most likely
+ *     contiguous with the new one) are
+ */
+static lsm_sched_op_t *sched_find_merge(
+        lsm_state_t *ns,
+        lsm_event_t event,
+        lsm_message_data_t const *data,
+        struct qlist_head *queue)
+{
+    uint64_t window = ns->model->sched_merge_window;
+    uint64_t start = data->offset;
+    uint64_t end = data->offset + data->size;
+    struct qlist_head *ent;
+
+    for (ent = queue->prev; ent != queue; ent = ent->prev)
+    {
+        lsm_sched_op_t *op = qlist_entry(ent, lsm_sched_op_t, ql);
+        uint64_t op_start = op->data.offset;
+        uint64_t op_end = op->data.offset + op->data.size;
+
+        if (op->event != event || op->data.object != data->object ||
+                start > op_end || op_start > end ||
+                strcmp(op->data.category, data->category) != 0)
+            continue;
+        if ((end > op_end ? end : op_end) -
+                (start < op_start ? start : op_start) <= window)
+            return op;
+    }
+    return NULL;
+}
+
 static void handle_io_sched_new(
         lsm_state_t *ns,
         tw_bf *b,
@@ -517,11 +1306,38 @@ static void handle_io_sched_new(
         printf("handle_io_sched_new called\n");
     // if nothing else is going on, then issue directly
     if (!ns->sched.active_count)
-        handle_io_request(ns, b, &m_in->data, m_in, lp);
+        handle_io_request(ns, b, m_in->event, &m_in->data, &m_in->cb, m_in,
+                lp);
     else {
+        struct qlist_head *queue = &ns->sched.queues[m_in->prio];
         lsm_sched_op_t *op = malloc(sizeof(*op));
+        op->event = m_in->event;
         op->data = m_in->data;
-        qlist_add_tail(&op->ql, &ns->sched.queues[m_in->prio]);
+        op->cb = m_in->cb;
+        INIT_QLIST_HEAD(&op->merged);
+
+        lsm_sched_op_t *into = NULL;
+        if (ns->model->sched_merge_window > 0)
+            into = sched_find_merge(ns, m_in->event, &m_in->data, queue);
+        if (into != NULL) {
+            // widen the queued request to cover this one, which completes
+            // along with it
+            uint64_t start = into->data.offset;
+            uint64_t end = into->data.offset + into->data.size;
+            b->c3 = 1;
+            m_in->prev_merge = into;
+            m_in->prev_offset = into->data.offset;
+            m_in->prev_size = into->data.size;
+            if (m_in->data.offset < start)
+                start = m_in->data.offset;
+            if (m_in->data.offset + m_in->data.size > end)
+                end = m_in->data.offset + m_in->data.size;
+            into->data.offset = start;
+            into->data.size = end - start;
+            qlist_add_tail(&op->ql, &into->merged);
+            return;
+        }
+        qlist_add_tail(&op->ql, queue);
     }
     ns->sched.active_count++;
 }
@@ -534,6 +1350,15 @@ static void handle_rev_io_sched_new(
 {
     if (LSM_DEBUG)
         printf("handle_rev_io_sched_new called\n");
+    if (b->c3) {
+        lsm_sched_op_t *into = m_in->prev_merge;
+        struct qlist_head *ent = qlist_pop_back(&into->merged);
+        assert(ent);
+        free(qlist_entry(ent, lsm_sched_op_t, ql));
+        into->data.offset = m_in->prev_offset;
+        into->data.size = m_in->prev_size;
+        return;
+    }
     ns->sched.active_count--;
     if (!ns->sched.active_count)
         handle_rev_io_request(ns, b, &m_in->data, m_in, lp);
@@ -553,6 +1378,20 @@ static void handle_io_sched_compl(
 {
     if (LSM_DEBUG)
         printf("handle_io_sched_compl called\n");
+
+    rc_stack_gc(lp, ns->sched.freelist);
+
+    // complete the requests merged into the one that just finished
+    if (ns->sched.cur != NULL) {
+        struct qlist_head *ent;
+        b->c4 = 1;
+        qlist_for_each(ent, &ns->sched.cur->merged)
+            send_io_callback(&qlist_entry(ent, lsm_sched_op_t, ql)->cb, lp);
+        // now done with this request metadata
+        rc_stack_push(lp, ns->sched.cur, sched_op_free, ns->sched.freelist);
+        ns->sched.cur = NULL;
+    }
+
     ns->sched.active_count--;
     if (ns->sched.active_count) {
         lsm_sched_op_t *next = NULL;
@@ -566,9 +1405,9 @@ static void handle_io_sched_compl(
             }
         }
         assert(next);
-        handle_io_request(ns, b, &next->data, m_in, lp);
-        // now done with this request metadata
-        rc_stack_push(lp, next, free, ns->sched.freelist);
+        handle_io_request(ns, b, next->event, &next->data, &next->cb, m_in,
+                lp);
+        ns->sched.cur = next;
     }
 }
 
@@ -581,11 +1420,20 @@ static void handle_rev_io_sched_compl(
     if (LSM_DEBUG)
         printf("handle_rev_io_sched_compl called\n");
     if (ns->sched.active_count) {
-        lsm_sched_op_t *prev = rc_stack_pop(ns->sched.freelist);
+        lsm_sched_op_t *prev = ns->sched.cur;
         handle_rev_io_request(ns, b, &prev->data, m_in, lp);
-        qlist_add_tail(&prev->ql, &ns->sched.queues[m_in->prio]);
+        // it was popped off the head of its queue
+        qlist_add(&prev->ql, &ns->sched.queues[m_in->prio]);
+        ns->sched.cur = NULL;
     }
     ns->sched.active_count++;
+
+    if (b->c4) {
+        struct qlist_head *ent;
+        ns->sched.cur = rc_stack_pop(ns->sched.freelist);
+        qlist_for_each(ent, &ns->sched.cur->merged)
+            codes_local_latency_reverse(lp);
+    }
 }
 
 
@@ -597,20 +1445,18 @@ static void handle_rev_io_sched_compl(
  */
 static void handle_io_request(lsm_state_t *ns,
                               tw_bf *b,
+                              lsm_event_t event,
                               lsm_message_data_t *data,
+                              struct codes_cb_params const *cb,
                               lsm_message_t *m_in,
                               tw_lp *lp)
 {
     (void)b;
-    tw_stime queue_time, t_time;
+    tw_stime queue_time;
     tw_event *e;
     lsm_message_t *m_out;
     lsm_stats_t *stat;
-    int rw = (m_in->event == LSM_READ_REQUEST) ? 1 : 0;
-
-    tw_stime (*transfer_time) (lsm_state_t *, lsm_stats_t *, int, uint64_t, int64_t, uint64_t);
-
-    transfer_time = transfer_time_table;
+    int rw = (event == LSM_READ_REQUEST) ? 1 : 0;
 
     stat = find_stats(data->category, ns);
 
@@ -620,32 +1466,35 @@ static void handle_io_request(lsm_state_t *ns,
     m_in->prev_object = ns->current_object;
     m_in->prev_offset = ns->current_offset;
 
-    if (ns->next_idle > tw_now(lp))
+    if (ns->model->device_channels > 0)
     {
-        queue_time = ns->next_idle - tw_now(lp);
+        rc_stack_gc(lp, ns->dev.saved_idle);
+        rc_stack_gc(lp, ns->dev.freelist);
+        if (ns->dev.log_idle)
+        {
+            tw_stime *saved = malloc(ns->model->device_channels *
+                    sizeof(*saved));
+            memcpy(saved, ns->dev.chan_next_idle,
+                    ns->model->device_channels * sizeof(*saved));
+            rc_stack_push(lp, saved, free, ns->dev.saved_idle);
+        }
+    }
+
+    if (ns->cache.num_pages > 0)
+    {
+        queue_time = cache_io_request(ns, stat, rw, data, lp);
     }
     else
     {
-        queue_time = 0;
+        queue_time = disk_access(ns, stat, rw, data->object, data->offset,
+                data->size, tw_now(lp)) - tw_now(lp);
     }
 
-
-    t_time = transfer_time(ns,
-                           stat,
-                           rw,
-                           data->object,
-                           data->offset,
-                           data->size);
-    queue_time += t_time;
-    ns->next_idle = queue_time + tw_now(lp);
-    ns->current_offset = data->offset + data->size;
-    ns->current_object = data->object;
-
     e = tw_event_new(lp->gid, queue_time, lp);
     m_out = (lsm_message_t*)tw_event_data(e);
 
     memcpy(m_out, m_in, sizeof(*m_in));
-    if (m_out->event == LSM_WRITE_REQUEST)
+    if (event == LSM_WRITE_REQUEST)
     {
         m_out->event = LSM_WRITE_COMPLETION;
     }
@@ -653,6 +1502,8 @@ static void handle_io_request(lsm_state_t *ns,
     {
         m_out->event = LSM_READ_COMPLETION;
     }
+    m_out->data = *data;
+    m_out->cb = *cb;
 
     m_out->prio = m_in->prio;
 
@@ -683,34 +1534,162 @@ static void handle_rev_io_request(lsm_state_t *ns,
     ns->current_object = m_in->prev_object;
     ns->current_offset = m_in->prev_offset;
 
+    if (ns->cache.num_pages > 0)
+        cache_undo_rev(&ns->cache);
+
+    if (ns->model->device_channels > 0)
+    {
+        tw_stime *saved = rc_stack_pop(ns->dev.saved_idle);
+        assert(saved);
+        memcpy(ns->dev.chan_next_idle, saved,
+                ns->model->device_channels * sizeof(*saved));
+        free(saved);
+    }
+
     return;
 }
 
 /*
- * handle_io_completion
- *   - handle IO completion events
- *   - invoke the callers original completion event
+ * handle_io_dev_new
+ *   - flash device mode: issue the request if its submission queue has room,
+ *     otherwise hold it until a request of the same queue completes
  */
-static void handle_io_completion (lsm_state_t *ns,
-                                  tw_bf *b,
-                                  lsm_message_t *m_in,
-                                  tw_lp *lp)
+static void handle_io_dev_new(
+        lsm_state_t *ns,
+        tw_bf *b,
+        lsm_message_t *m_in,
+        tw_lp *lp)
+{
+    int q = (int)(m_in->cb.h.src % ns->model->device_queues);
+
+    if (ns->dev.queue_inflight[q] < ns->model->device_queue_depth)
+    {
+        b->c1 = 0;
+        ns->dev.queue_inflight[q]++;
+        ns->dev.inflight++;
+        handle_io_request(ns, b, m_in->event, &m_in->data, &m_in->cb, m_in,
+                lp);
+    }
+    else
+    {
+        b->c1 = 1;
+        lsm_sched_op_t *op = malloc(sizeof(*op));
+        op->event = m_in->event;
+        op->data = m_in->data;
+        op->cb = m_in->cb;
+        qlist_add_tail(&op->ql, &ns->dev.pending[q]);
+    }
+}
+
+static void handle_rev_io_dev_new(
+        lsm_state_t *ns,
+        tw_bf *b,
+        lsm_message_t *m_in,
+        tw_lp *lp)
+{
+    int q = (int)(m_in->cb.h.src % ns->model->device_queues);
+
+    if (b->c1)
+    {
+        struct qlist_head *ent = qlist_pop_back(&ns->dev.pending[q]);
+        assert(ent);
+        free(qlist_entry(ent, lsm_sched_op_t, ql));
+    }
+    else
+    {
+        ns->dev.queue_inflight[q]--;
+        ns->dev.inflight--;
+        handle_rev_io_request(ns, b, &m_in->data, m_in, lp);
+    }
+}
+
+/*
+ * handle_io_dev_compl
+ *   - flash device mode: retire the completed request and issue the next
+ *     pending request of its submission queue, if any
+ */
+static void handle_io_dev_compl(
+        lsm_state_t *ns,
+        tw_bf *b,
+        lsm_message_t *m_in,
+        tw_lp *lp)
 {
-    SANITY_CHECK_CB(&m_in->cb.info, lsm_return_t);
+    int q = (int)(m_in->cb.h.src % ns->model->device_queues);
 
-    tw_event * e = tw_event_new(m_in->cb.h.src, codes_local_latency(lp), lp);
+    ns->dev.queue_inflight[q]--;
+    ns->dev.inflight--;
+
+    struct qlist_head *ent = qlist_pop(&ns->dev.pending[q]);
+    if (ent != NULL)
+    {
+        b->c2 = 1;
+        lsm_sched_op_t *next = qlist_entry(ent, lsm_sched_op_t, ql);
+        ns->dev.queue_inflight[q]++;
+        ns->dev.inflight++;
+        handle_io_request(ns, b, next->event, &next->data, &next->cb, m_in,
+                lp);
+        // now done with this request metadata
+        rc_stack_push(lp, next, free, ns->dev.freelist);
+    }
+}
+
+static void handle_rev_io_dev_compl(
+        lsm_state_t *ns,
+        tw_bf *b,
+        lsm_message_t *m_in,
+        tw_lp *lp)
+{
+    int q = (int)(m_in->cb.h.src % ns->model->device_queues);
+
+    if (b->c2)
+    {
+        lsm_sched_op_t *prev = rc_stack_pop(ns->dev.freelist);
+        ns->dev.queue_inflight[q]--;
+        ns->dev.inflight--;
+        handle_rev_io_request(ns, b, &prev->data, m_in, lp);
+        qlist_add(&prev->ql, &ns->dev.pending[q]);
+    }
+
+    ns->dev.queue_inflight[q]++;
+    ns->dev.inflight++;
+}
+
+/*
+ * send_io_callback
+ *   - invoke a caller's completion event
+ */
+static void send_io_callback(struct codes_cb_params const *cb, tw_lp *lp)
+{
+    SANITY_CHECK_CB(&cb->info, lsm_return_t);
+
+    tw_event * e = tw_event_new(cb->h.src, codes_local_latency(lp), lp);
     void * m = tw_event_data(e);
 
-    GET_INIT_CB_PTRS(&m_in->cb, m, lp->gid, h, tag, rc, lsm_return_t);
+    GET_INIT_CB_PTRS(cb, m, lp->gid, h, tag, rc, lsm_return_t);
 
     /* no failures to speak of yet */
     rc->rc = 0;
 
     tw_event_send(e);
+}
+
+/*
+ * handle_io_completion
+ *   - handle IO completion events
+ *   - invoke the callers original completion event
+ */
+static void handle_io_completion (lsm_state_t *ns,
+                                  tw_bf *b,
+                                  lsm_message_t *m_in,
+                                  tw_lp *lp)
+{
+    send_io_callback(&m_in->cb, lp);
 
     // continue the loop
     if (ns->use_sched)
         handle_io_sched_compl(ns, b, m_in, lp);
+    else if (ns->model->device_channels > 0)
+        handle_io_dev_compl(ns, b, m_in, lp);
 
     return;
 }
@@ -727,6 +1706,8 @@ static void handle_rev_io_completion (lsm_state_t *ns,
 {
     if (ns->use_sched)
         handle_rev_io_sched_compl(ns, b, m_in, lp);
+    else if (ns->model->device_channels > 0)
+        handle_rev_io_dev_compl(ns, b, m_in, lp);
 
     codes_local_latency_reverse(lp);
     return;
@@ -763,15 +1744,16 @@ static lsm_stats_t *find_stats(const char* category, lsm_state_t *ns)
 
 }
 
-static void write_stats(tw_lp* lp, lsm_stats_t* stat)
+static void write_stats(tw_lp* lp, lsm_stats_t* stat, int with_cache)
 {
     int ret;
     char id[32];
     char data[1024];
+    int len;
 
     sprintf(id, "lsm-category-%s", stat->category);
-    sprintf(data, "lp:%ld\twrite_count:%ld\twrite_bytes:%ld\twrite_seeks:%ld\twrite_time:%f\t"
-        "read_count:%ld\tread_bytes:%ld\tread_seeks:%ld\tread_time:%f\n",
+    len = sprintf(data, "lp:%ld\twrite_count:%ld\twrite_bytes:%ld\twrite_seeks:%ld\twrite_time:%f\t"
+        "read_count:%ld\tread_bytes:%ld\tread_seeks:%ld\tread_time:%f",
         (long)lp->gid,
         stat->write_count,
         stat->write_bytes,
@@ -781,6 +1763,19 @@ static void write_stats(tw_lp* lp, lsm_stats_t* stat)
         stat->read_bytes,
         stat->read_seeks,
         stat->read_time);
+    if (with_cache)
+        len += sprintf(data+len, "\tcache_read_hits:%ld\tcache_read_misses:%ld"
+            "\tcache_write_hits:%ld\tcache_write_misses:%ld"
+            "\tcache_evictions:%ld\tcache_writeback_bytes:%ld"
+            "\tcache_readahead_bytes:%ld",
+            stat->cache_read_hits,
+            stat->cache_read_misses,
+            stat->cache_write_hits,
+            stat->cache_write_misses,
+            stat->cache_evictions,
+            stat->cache_writeback_bytes,
+            stat->cache_readahead_bytes);
+    sprintf(data+len, "\n");
 
     ret = lp_io_write(lp->gid, id, strlen(data), data);
     assert(ret == 0);
@@ -896,10 +1891,156 @@ static void read_config(ConfigHandle *ch, char const * anno, disk_model_t *model
     }
     free(values);
 
+    // lookup tables - step lookup unless asked to interpolate (this can
+    // fail)
+    char interp[MAX_NAME_LENGTH];
+    interp[0] = '\0';
+    configuration_get_value(ch, LSM_NAME, "table_interp", anno, interp,
+            MAX_NAME_LENGTH);
+    enum codes_ptable_mode mode =
+        codes_ptable_mode_from_str(interp, CODES_PTABLE_FLOOR);
+    uint64_t *sizes = malloc(model->bins * sizeof(*sizes));
+    double *wvals = malloc(model->bins * LSM_NUM_COLS * sizeof(*wvals));
+    double *rvals = malloc(model->bins * LSM_NUM_COLS * sizeof(*rvals));
+    assert(sizes && wvals && rvals);
+    for (unsigned int i = 0; i < model->bins; i++)
+    {
+        sizes[i] = model->request_sizes[i];
+        wvals[i*LSM_NUM_COLS + LSM_COL_RATE] = model->write_rates[i];
+        wvals[i*LSM_NUM_COLS + LSM_COL_SEEK] = model->write_seeks[i];
+        wvals[i*LSM_NUM_COLS + LSM_COL_OVERHEAD] = model->write_overheads[i];
+        rvals[i*LSM_NUM_COLS + LSM_COL_RATE] = model->read_rates[i];
+        rvals[i*LSM_NUM_COLS + LSM_COL_SEEK] = model->read_seeks[i];
+        rvals[i*LSM_NUM_COLS + LSM_COL_OVERHEAD] = model->read_overheads[i];
+    }
+    codes_ptable_create(model->bins, LSM_NUM_COLS, sizes, wvals, mode,
+            &model->write_table);
+    codes_ptable_create(model->bins, LSM_NUM_COLS, sizes, rvals, mode,
+            &model->read_table);
+    free(sizes);
+    free(wvals);
+    free(rvals);
+
     // scheduling parameters (this can fail)
+    model->use_sched = 0;
     configuration_get_value_int(ch, LSM_NAME, "enable_scheduler", anno,
             &model->use_sched);
     assert(model->use_sched >= 0);
+    model->sched_merge_window = 0;
+    configuration_get_value_longint(ch, LSM_NAME, "sched_merge_window", anno,
+            &model->sched_merge_window);
+    assert(model->sched_merge_window >= 0);
+
+    // page cache parameters (all optional, cache disabled by default)
+    long cache_size = 0;
+    model->cache_page_size = 4096;
+    model->cache_policy = LSM_CACHE_LRU;
+    model->cache_writeback = 1;
+    model->cache_dirty_ratio = 0.2;
+    model->cache_readahead = 0;
+    model->cache_rate = 10000.0;
+    model->cache_overhead = 1.0;
+    configuration_get_value_longint(ch, LSM_NAME, "cache_size", anno,
+            &cache_size);
+    configuration_get_value_int(ch, LSM_NAME, "cache_page_size", anno,
+            &model->cache_page_size);
+    configuration_get_value_int(ch, LSM_NAME, "cache_writeback", anno,
+            &model->cache_writeback);
+    configuration_get_value_double(ch, LSM_NAME, "cache_dirty_ratio", anno,
+            &model->cache_dirty_ratio);
+    configuration_get_value_int(ch, LSM_NAME, "cache_readahead", anno,
+            &model->cache_readahead);
+    configuration_get_value_double(ch, LSM_NAME, "cache_rate", anno,
+            &model->cache_rate);
+    configuration_get_value_double(ch, LSM_NAME, "cache_overhead", anno,
+            &model->cache_overhead);
+    interp[0] = '\0';
+    configuration_get_value(ch, LSM_NAME, "cache_policy", anno, interp,
+            MAX_NAME_LENGTH);
+    if (strcmp(interp, "clock") == 0)
+        model->cache_policy = LSM_CACHE_CLOCK;
+    else if (interp[0] != '\0' && strcmp(interp, "lru") != 0)
+        tw_error(TW_LOC, "unknown lsm cache_policy \"%s\" "
+                "(expected \"lru\" or \"clock\")\n", interp);
+    model->cache_size = cache_size;
+    if (model->cache_size > 0)
+    {
+        if (model->cache_page_size <= 0 ||
+                model->cache_size < model->cache_page_size)
+            tw_error(TW_LOC, "lsm cache_size (%ld) must hold at least one "
+                    "page of cache_page_size (%d) bytes\n",
+                    model->cache_size, model->cache_page_size);
+        assert(model->cache_dirty_ratio >= 0.0 &&
+                model->cache_dirty_ratio <= 1.0);
+        assert(model->cache_readahead >= 0);
+        assert(model->cache_rate > 0.0);
+    }
+
+    // flash device parameters (all optional, single disk by default)
+    long stripe_size = 131072;
+    model->device_channels = 0;
+    model->device_queues = 1;
+    model->device_queue_depth = 32;
+    model->device_qd_table = NULL;
+    configuration_get_value_int(ch, LSM_NAME, "device_channels", anno,
+            &model->device_channels);
+    configuration_get_value_longint(ch, LSM_NAME, "device_stripe_size", anno,
+            &stripe_size);
+    configuration_get_value_int(ch, LSM_NAME, "device_queues", anno,
+            &model->device_queues);
+    configuration_get_value_int(ch, LSM_NAME, "device_queue_depth", anno,
+            &model->device_queue_depth);
+    model->device_stripe_size = stripe_size;
+    if (model->device_channels > 0)
+    {
+        if (model->use_sched > 0)
+            tw_error(TW_LOC, "lsm enable_scheduler and device_channels are "
+                    "mutually exclusive\n");
+        if (model->device_stripe_size <= 0 || model->device_queues <= 0 ||
+                model->device_queue_depth <= 0)
+            tw_error(TW_LOC, "lsm device_stripe_size, device_queues and "
+                    "device_queue_depth must be positive\n");
+
+        // per-request overhead scaling by requests in flight, linearly
+        // interpolated between the given points (this can fail)
+        uint64_t *qd_points;
+        double *qd_scales;
+        size_t npoints = 0;
+        rc = configuration_get_multivalue(ch, LSM_NAME, "device_qd_points",
+                anno, &values, &length);
+        if (rc == 1 && length > 0)
+        {
+            npoints = length;
+            qd_points = malloc(npoints * sizeof(*qd_points));
+            assert(qd_points);
+            for (size_t i = 0; i < length; i++)
+                qd_points[i] = strtoull(values[i], NULL, 10);
+            free(values);
+            rc = configuration_get_multivalue(ch, LSM_NAME,
+                    "device_qd_latency", anno, &values, &length);
+            if (rc != 1 || length != npoints)
+                tw_error(TW_LOC, "lsm device_qd_latency must have one entry "
+                        "per device_qd_points entry\n");
+            qd_scales = malloc(npoints * sizeof(*qd_scales));
+            assert(qd_scales);
+            for (size_t i = 0; i < length; i++)
+                qd_scales[i] = strtod(values[i], NULL);
+            free(values);
+        }
+        else
+        {
+            npoints = 1;
+            qd_points = malloc(sizeof(*qd_points));
+            qd_scales = malloc(sizeof(*qd_scales));
+            assert(qd_points && qd_scales);
+            qd_points[0] = 1;
+            qd_scales[0] = 1.0;
+        }
+        codes_ptable_create(npoints, 1, qd_points, qd_scales,
+                CODES_PTABLE_LINEAR, &model->device_qd_table);
+        free(qd_points);
+        free(qd_scales);
+    }
 }
 
 void lsm_configure(void)
@@ -5,6 +5,7 @@
  */
 
 #include <assert.h>
+#include <stdarg.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -36,6 +37,11 @@ int identifiers_count = 0;
 struct identifier global_identifiers[64];
 int global_identifiers_count = 0;
 
+/* shared formatting buffer, see lp_io_fmt */
+static char *fmt_buf = NULL;
+static int fmt_len = 0;
+static int fmt_cap = 0;
+
 static int write_id(char* directory, char* identifier, MPI_Comm comm);
 
 int lp_io_write(tw_lpid gid, char* identifier, int size, void* buffer)
@@ -101,6 +107,62 @@ int lp_io_write(tw_lpid gid, char* identifier, int size, void* buffer)
     return(0);
 }
 
+int lp_io_fmt(char const * fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if(!fmt_buf)
+    {
+        fmt_cap = 4096;
+        fmt_buf = (char*)malloc(fmt_cap);
+        assert(fmt_buf);
+        fmt_buf[0] = '\0';
+    }
+
+    va_start(ap, fmt);
+    n = vsnprintf(fmt_buf + fmt_len, fmt_cap - fmt_len, fmt, ap);
+    va_end(ap);
+    assert(n >= 0);
+
+    if(fmt_len + n >= fmt_cap)
+    {
+        while(fmt_len + n >= fmt_cap)
+            fmt_cap *= 2;
+        fmt_buf = (char*)realloc(fmt_buf, fmt_cap);
+        assert(fmt_buf);
+        va_start(ap, fmt);
+        vsnprintf(fmt_buf + fmt_len, fmt_cap - fmt_len, fmt, ap);
+        va_end(ap);
+    }
+    fmt_len += n;
+    return n;
+}
+
+int lp_io_fmt_write(tw_lpid gid, char* identifier)
+{
+    int ret = lp_io_write(gid, identifier, fmt_len, (void*)lp_io_fmt_buf());
+    lp_io_fmt_reset();
+    return ret;
+}
+
+void lp_io_fmt_reset(void)
+{
+    fmt_len = 0;
+    if(fmt_buf)
+        fmt_buf[0] = '\0';
+}
+
+char const * lp_io_fmt_buf(void)
+{
+    return fmt_buf ? fmt_buf : "";
+}
+
+int lp_io_fmt_len(void)
+{
+    return fmt_len;
+}
+
 int lp_io_write_rev(tw_lpid gid, char* identifier){
     struct identifier* id, *id_prev;
     struct io_buffer *buf, *buf_prev;
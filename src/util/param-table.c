@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/param-table.h"
+
+/* one bucket per possible bit length of a 64-bit key (0..64) */
+#define PTABLE_NBUCKETS 65
+
+struct codes_ptable {
+    int nrows;
+    int ncols;
+    enum codes_ptable_mode mode;
+    uint64_t *keys;
+    double *vals;
+    /* bucket_end[b] = number of rows with key < 2^b, i.e. the search for
+     * any key of bit length b is confined to [bucket_end[b-1],
+     * bucket_end[b]) */
+    int bucket_end[PTABLE_NBUCKETS];
+};
+
+static inline int key_bits(uint64_t key)
+{
+    return key ? 64 - __builtin_clzll(key) : 0;
+}
+
+/* number of rows in [lo, hi) with row key <= key, plus lo. No data-dependent
+ * branches in the loop - the compiler turns the select into a cmov */
+static inline int upper_bound_range(
+        uint64_t const *keys,
+        int lo,
+        int hi,
+        uint64_t key)
+{
+    int n = hi - lo;
+    uint64_t const *base = keys + lo;
+    if (n == 0)
+        return lo;
+    while (n > 1) {
+        int half = n >> 1;
+        base = (base[half] <= key) ? base + half : base;
+        n -= half;
+    }
+    return (int)(base - keys) + (*base <= key);
+}
+
+/* number of rows with row key <= key */
+static inline int upper_bound(struct codes_ptable const *t, uint64_t key)
+{
+    int b = key_bits(key);
+    int lo = b ? t->bucket_end[b-1] : 0;
+    return upper_bound_range(t->keys, lo, t->bucket_end[b], key);
+}
+
+void codes_ptable_create(
+        int nrows,
+        int ncols,
+        uint64_t const *keys,
+        double const *vals,
+        enum codes_ptable_mode mode,
+        struct codes_ptable **t)
+{
+    if (nrows <= 0 || ncols <= 0)
+        tw_error(TW_LOC, "parameter table needs at least one row and column "
+                "(got %d rows, %d columns)\n", nrows, ncols);
+    for (int i = 1; i < nrows; i++) {
+        if (keys[i] < keys[i-1])
+            tw_error(TW_LOC, "parameter table keys must be sorted "
+                    "(row %d: %llu after %llu)\n", i,
+                    (unsigned long long)keys[i],
+                    (unsigned long long)keys[i-1]);
+    }
+
+    struct codes_ptable *tt = malloc(sizeof(*tt));
+    assert(tt);
+    tt->nrows = nrows;
+    tt->ncols = ncols;
+    tt->mode = mode;
+    tt->keys = malloc(nrows * sizeof(*tt->keys));
+    tt->vals = malloc((size_t)nrows * ncols * sizeof(*tt->vals));
+    assert(tt->keys && tt->vals);
+    memcpy(tt->keys, keys, nrows * sizeof(*tt->keys));
+    memcpy(tt->vals, vals, (size_t)nrows * ncols * sizeof(*tt->vals));
+
+    /* rows with key < 2^b; the last bucket covers everything */
+    int r = 0;
+    for (int b = 0; b < PTABLE_NBUCKETS-1; b++) {
+        uint64_t lim = ((uint64_t)1) << b;
+        while (r < nrows && tt->keys[r] < lim)
+            r++;
+        tt->bucket_end[b] = r;
+    }
+    tt->bucket_end[PTABLE_NBUCKETS-1] = nrows;
+
+    *t = tt;
+}
+
+void codes_ptable_destroy(struct codes_ptable *t)
+{
+    if (t == NULL)
+        return;
+    free(t->keys);
+    free(t->vals);
+    free(t);
+}
+
+enum codes_ptable_mode codes_ptable_mode_from_str(
+        char const *str,
+        enum codes_ptable_mode step_mode)
+{
+    if (str == NULL || str[0] == '\0' || strcmp(str, "step") == 0)
+        return step_mode;
+    else if (strcmp(str, "linear") == 0)
+        return CODES_PTABLE_LINEAR;
+    tw_error(TW_LOC, "unknown parameter table interpolation \"%s\" "
+            "(expected \"step\" or \"linear\")\n", str);
+    return step_mode;
+}
+
+int codes_ptable_rows(struct codes_ptable const *t) { return t->nrows; }
+int codes_ptable_cols(struct codes_ptable const *t) { return t->ncols; }
+
+uint64_t codes_ptable_key(struct codes_ptable const *t, int row)
+{
+    assert(row >= 0 && row < t->nrows);
+    return t->keys[row];
+}
+
+double const * codes_ptable_row(struct codes_ptable const *t, int row)
+{
+    assert(row >= 0 && row < t->nrows);
+    return &t->vals[(size_t)row * t->ncols];
+}
+
+int codes_ptable_floor(struct codes_ptable const *t, uint64_t key)
+{
+    int ub = upper_bound(t, key);
+    return ub > 0 ? ub - 1 : 0;
+}
+
+int codes_ptable_above(struct codes_ptable const *t, uint64_t key)
+{
+    int ub = upper_bound(t, key);
+    return ub < t->nrows ? ub : t->nrows - 1;
+}
+
+void codes_ptable_lookup(
+        struct codes_ptable const *t,
+        uint64_t key,
+        double *out)
+{
+    double const *row;
+
+    switch (t->mode) {
+        case CODES_PTABLE_FLOOR:
+            row = codes_ptable_row(t, codes_ptable_floor(t, key));
+            break;
+        case CODES_PTABLE_ABOVE:
+            row = codes_ptable_row(t, codes_ptable_above(t, key));
+            break;
+        case CODES_PTABLE_LINEAR: {
+            int ub = upper_bound(t, key);
+            if (ub == 0)
+                row = codes_ptable_row(t, 0);
+            else if (ub == t->nrows)
+                row = codes_ptable_row(t, t->nrows - 1);
+            else {
+                /* keys[ub-1] <= key < keys[ub], so the span is non-zero */
+                double const *lo = codes_ptable_row(t, ub - 1);
+                double const *hi = codes_ptable_row(t, ub);
+                double frac = (double)(key - t->keys[ub-1]) /
+                    (double)(t->keys[ub] - t->keys[ub-1]);
+                for (int c = 0; c < t->ncols; c++)
+                    out[c] = lo[c] + frac * (hi[c] - lo[c]);
+                return;
+            }
+            break;
+        }
+        default:
+            assert(0);
+            return;
+    }
+    memcpy(out, row, t->ncols * sizeof(*out));
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
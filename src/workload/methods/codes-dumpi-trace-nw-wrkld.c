@@ -595,6 +595,7 @@ int handleDUMPIBcast(const dumpi_bcast *prm, uint16_t thread,
 
         wrkld_per_rank.op_type = CODES_WK_BCAST;
         wrkld_per_rank.u.collective.num_bytes = prm->count * get_num_bytes(myctx,prm->datatype);
+        wrkld_per_rank.u.collective.root = prm->root;
 	    assert(wrkld_per_rank.u.collective.num_bytes >= 0);
 
         update_times_and_insert(&wrkld_per_rank, wall, myctx);
@@ -697,6 +698,7 @@ int handleDUMPIReduce(const dumpi_reduce *prm, uint16_t thread,
 
         wrkld_per_rank.op_type = CODES_WK_REDUCE;
         wrkld_per_rank.u.collective.num_bytes = prm->count * get_num_bytes(myctx,prm->datatype);
+        wrkld_per_rank.u.collective.root = prm->root;
 	    assert(wrkld_per_rank.u.collective.num_bytes > 0);
 
         update_times_and_insert(&wrkld_per_rank, wall, myctx);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <ross.h>
+#include "codes/codes-rand.h"
+
+/* known-answer vectors of Philox-4x32-10 from Random123 */
+static void check_kat(void)
+{
+    static const struct {
+        uint32_t ctr[4], key[2], out[4];
+    } kat[] = {
+        { {0, 0, 0, 0}, {0, 0},
+          {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8} },
+        { {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+          {0xffffffff, 0xffffffff},
+          {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd} },
+        { {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+          {0xa4093822, 0x299f31d0},
+          {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1} },
+    };
+
+    for (size_t i = 0; i < sizeof(kat)/sizeof(kat[0]); i++) {
+        uint32_t ctr[4];
+        memcpy(ctr, kat[i].ctr, sizeof(ctr));
+        codes_rand_philox4x32(ctr, kat[i].key);
+        assert(memcmp(ctr, kat[i].out, sizeof(ctr)) == 0);
+    }
+}
+
+/* a stream as codes_rand_begin would set it up */
+static void stream(codes_rand *r, uint32_t lp, uint32_t salt, uint32_t now)
+{
+    r->key[0] = lp;
+    r->key[1] = 0;
+    r->ctr[0] = 0;
+    r->ctr[1] = salt;
+    r->ctr[2] = now;
+    r->ctr[3] = 0;
+}
+
+int main()
+{
+    codes_rand a, b;
+    int const n = 100000;
+    double sum = 0;
+    int counts[10] = {0};
+
+    check_kat();
+
+    /* draws are in range and roughly uniform */
+    stream(&a, 1, 0, 0);
+    for (int i = 0; i < n; i++) {
+        double u = codes_rand_unif(&a);
+        assert(u > 0 && u < 1);
+        sum += u;
+        long k = codes_rand_integer(&a, 0, 9);
+        assert(k >= 0 && k <= 9);
+        counts[k]++;
+        assert(codes_rand_exponential(&a, 10.0) > 0);
+    }
+    assert(sum / n > 0.49 && sum / n < 0.51);
+    for (int k = 0; k < 10; k++)
+        assert(counts[k] > n / 10 * 0.95 && counts[k] < n / 10 * 1.05);
+    assert(codes_rand_integer(&a, 5, 4) == 5);
+    assert(codes_rand_integer(&a, 3, 3) == 3);
+
+    /* the same (LP, event, draw) gives the same number... */
+    stream(&a, 7, 2, 1234);
+    stream(&b, 7, 2, 1234);
+    for (int i = 0; i < 100; i++)
+        assert(codes_rand_unif(&a) == codes_rand_unif(&b));
+
+    /* ...and a different LP, salt or event time a different one */
+    stream(&a, 7, 2, 1234);
+    stream(&b, 8, 2, 1234);
+    assert(codes_rand_unif(&a) != codes_rand_unif(&b));
+    stream(&a, 7, 2, 1234);
+    stream(&b, 7, 3, 1234);
+    assert(codes_rand_unif(&a) != codes_rand_unif(&b));
+    stream(&a, 7, 2, 1234);
+    stream(&b, 7, 2, 1235);
+    assert(codes_rand_unif(&a) != codes_rand_unif(&b));
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
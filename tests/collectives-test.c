@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <ross.h>
+#include "codes/codes-collectives.h"
+
+#define MAX_RANKS 40
+
+/* every send of a round has the matching receive on the peer in the same
+ * round and vice versa; returns the number of rounds */
+static int check_pairing(struct codes_col_desc const *d, int p)
+{
+    struct codes_col_step s[MAX_RANKS], ps;
+    int nrounds = codes_col_num_rounds(&d[0]);
+
+    for (int r = 0; r < p; r++)
+        assert(codes_col_num_rounds(&d[r]) == nrounds);
+
+    for (int round = 0; round < nrounds; round++) {
+        for (int r = 0; r < p; r++)
+            codes_col_get_step(&d[r], round, &s[r]);
+        for (int r = 0; r < p; r++) {
+            if (s[r].send_peer >= 0) {
+                assert(s[r].send_peer < p && s[r].send_peer != r);
+                ps = s[s[r].send_peer];
+                assert(ps.recv_peer == r);
+                assert(ps.recv_bytes == s[r].send_bytes);
+            }
+            if (s[r].recv_peer >= 0) {
+                assert(s[r].recv_peer < p && s[r].recv_peer != r);
+                assert(s[s[r].recv_peer].send_peer == r);
+            }
+        }
+    }
+    return nrounds;
+}
+
+/* data only flows out of ranks that already hold it (bcast) or have
+ * finished collecting it (reduce) */
+static void check_tree(struct codes_col_desc const *d, int p)
+{
+    int have[MAX_RANKS], sent[MAX_RANKS];
+    struct codes_col_step s;
+    int is_bcast = d[0].type == CODES_COL_BCAST;
+
+    for (int r = 0; r < p; r++) {
+        have[r] = is_bcast ? r == d[0].root : 1;
+        sent[r] = 0;
+    }
+    for (int round = 0; round < codes_col_num_rounds(&d[0]); round++) {
+        int next[MAX_RANKS];
+        for (int r = 0; r < p; r++)
+            next[r] = have[r];
+        for (int r = 0; r < p; r++) {
+            codes_col_get_step(&d[r], round, &s);
+            if (s.send_peer >= 0) {
+                assert(have[r] && !sent[r]);
+                if (is_bcast)
+                    next[s.send_peer] = 1;
+                else {
+                    next[s.send_peer] += have[r];
+                    sent[r] = 1;
+                }
+            }
+        }
+        for (int r = 0; r < p; r++)
+            have[r] = sent[r] ? 0 : next[r];
+    }
+    for (int r = 0; r < p; r++) {
+        if (is_bcast)
+            assert(have[r]);
+        else
+            assert(have[r] == (r == d[0].root ? p : 0));
+    }
+}
+
+/* total bytes each rank receives */
+static void check_recv_total(struct codes_col_desc const *d, int p,
+        int64_t expected)
+{
+    struct codes_col_step s;
+    for (int r = 0; r < p; r++) {
+        int64_t total = 0;
+        for (int round = 0; round < codes_col_num_rounds(&d[r]); round++) {
+            codes_col_get_step(&d[r], round, &s);
+            if (s.recv_peer >= 0)
+                total += s.recv_bytes;
+        }
+        assert(total == expected);
+    }
+}
+
+/* first of the n posted receives (tags[i], srcs[i]) that takes a message,
+ * in posting order as the replay's queues; -1 if none */
+static int first_match(int const *tags, int const *srcs, int n, int msg_tag,
+        int msg_src)
+{
+    for (int i = 0; i < n; i++) {
+        if (codes_col_recv_matches(tags[i], srcs[i], msg_tag, msg_src,
+                    CODES_COL_IS_TAG(msg_tag)))
+            return i;
+    }
+    return -1;
+}
+
+/* each rank posts a wildcard receive before the collective, then the
+ * receives of the collective. The messages of the collective go to the
+ * receives posted for them, whether they arrive after or before the
+ * wildcard is posted, and the wildcard is left for the application's
+ * message */
+static void check_wildcard(struct codes_col_desc const *d, int p, int seq)
+{
+    struct codes_col_step s;
+    int tags[MAX_RANKS * 2 + 1], srcs[MAX_RANKS * 2 + 1];
+
+    for (int r = 0; r < p; r++) {
+        int n = 1;
+        tags[0] = -1;
+        srcs[0] = -1;
+        for (int round = 0; round < codes_col_num_rounds(&d[r]); round++) {
+            codes_col_get_step(&d[r], round, &s);
+            if (s.recv_peer >= 0) {
+                tags[n] = CODES_COL_TAG(seq, round);
+                srcs[n++] = s.recv_peer;
+            }
+        }
+        assert(n <= MAX_RANKS * 2 + 1);
+
+        /* messages of the collective arriving with the receives posted */
+        for (int i = 1; i < n; i++)
+            assert(first_match(tags, srcs, n, tags[i], srcs[i]) == i);
+        /* ... and queued before the wildcard is posted */
+        for (int i = 1; i < n; i++)
+            assert(!codes_col_recv_matches(-1, -1, tags[i], srcs[i], 1));
+        assert(first_match(tags, srcs, n, 7, (r + 1) % p) == 0);
+    }
+}
+
+static void init_all(struct codes_col_desc *d, enum codes_col_type type,
+        enum codes_col_algo algo, int p, int root, int64_t bytes)
+{
+    for (int r = 0; r < p; r++)
+        codes_col_init(&d[r], type, algo, p, r, root, bytes, NULL);
+}
+
+int main()
+{
+    struct codes_col_desc d[MAX_RANKS];
+    int64_t sizes[] = { 1, 8, 1000, 4096, 1 << 20 };
+    int nsizes = sizeof(sizes)/sizeof(sizes[0]);
+
+    for (int p = 1; p <= MAX_RANKS; p++) {
+        for (int si = 0; si < nsizes; si++) {
+            int64_t n = sizes[si];
+
+            for (int root = 0; root < p; root += 3) {
+                init_all(d, CODES_COL_BCAST, CODES_COL_ALGO_AUTO, p, root, n);
+                check_pairing(d, p);
+                check_tree(d, p);
+                init_all(d, CODES_COL_REDUCE, CODES_COL_ALGO_AUTO, p, root, n);
+                check_pairing(d, p);
+                check_tree(d, p);
+            }
+
+            init_all(d, CODES_COL_ALLREDUCE, CODES_COL_ALGO_RING, p, 0, n);
+            check_pairing(d, p);
+            /* reduce-scatter + allgather: every chunk but our own, twice */
+            for (int r = 0; r < p; r++) {
+                struct codes_col_step s;
+                int64_t total = 0;
+                for (int round = 0; round < codes_col_num_rounds(&d[r]);
+                        round++) {
+                    codes_col_get_step(&d[r], round, &s);
+                    total += s.recv_bytes;
+                }
+                assert(p == 1 || total <= 2*n);
+            }
+
+            init_all(d, CODES_COL_ALLREDUCE,
+                    CODES_COL_ALGO_RECURSIVE_DOUBLING, p, 0, n);
+            check_pairing(d, p);
+            init_all(d, CODES_COL_ALLREDUCE, CODES_COL_ALGO_RABENSEIFNER,
+                    p, 0, n);
+            check_pairing(d, p);
+            init_all(d, CODES_COL_ALLREDUCE, CODES_COL_ALGO_AUTO, p, 0, n);
+            check_pairing(d, p);
+
+            init_all(d, CODES_COL_ALLGATHER, CODES_COL_ALGO_RING, p, 0, n);
+            check_pairing(d, p);
+            check_recv_total(d, p, n * (p-1));
+            init_all(d, CODES_COL_ALLGATHER, CODES_COL_ALGO_AUTO, p, 0, n);
+            check_pairing(d, p);
+            check_recv_total(d, p, n * (p-1));
+
+            init_all(d, CODES_COL_ALLTOALL, CODES_COL_ALGO_AUTO, p, 0, n);
+            assert(check_pairing(d, p) == p-1);
+            check_recv_total(d, p, n * (p-1));
+            check_wildcard(d, p, si);
+        }
+    }
+
+    /* size-based selection */
+    codes_col_init(&d[0], CODES_COL_ALLREDUCE, CODES_COL_ALGO_AUTO, 16, 0, 0,
+            64, NULL);
+    assert(d[0].algo == CODES_COL_ALGO_RECURSIVE_DOUBLING);
+    codes_col_init(&d[0], CODES_COL_ALLREDUCE, CODES_COL_ALGO_AUTO, 16, 0, 0,
+            1 << 16, NULL);
+    assert(d[0].algo == CODES_COL_ALGO_RABENSEIFNER);
+    codes_col_init(&d[0], CODES_COL_ALLREDUCE, CODES_COL_ALGO_AUTO, 16, 0, 0,
+            1 << 26, NULL);
+    assert(d[0].algo == CODES_COL_ALGO_RING);
+    codes_col_init(&d[0], CODES_COL_ALLGATHER, CODES_COL_ALGO_AUTO, 12, 0, 0,
+            64, NULL);
+    assert(d[0].algo == CODES_COL_ALGO_RING);
+
+    assert(codes_col_algo_from_str("rabenseifner") ==
+            CODES_COL_ALGO_RABENSEIFNER);
+    assert(codes_col_algo_from_str("auto") == CODES_COL_ALGO_AUTO);
+
+    /* wildcards still take any application message */
+    assert(codes_col_recv_matches(-1, -1, 3, 5, 0));
+    assert(codes_col_recv_matches(3, -1, 3, 5, 0));
+    assert(!codes_col_recv_matches(4, -1, 3, 5, 0));
+    assert(codes_col_recv_matches(CODES_COL_TAG(2, 1), 5, CODES_COL_TAG(2, 1),
+                5, 1));
+    assert(!codes_col_recv_matches(-1, 5, CODES_COL_TAG(2, 1), 5, 1));
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
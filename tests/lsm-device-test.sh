@@ -0,0 +1,14 @@
+#!/bin/bash
+
+if [ -z $srcdir ]; then
+    echo srcdir variable not set.
+    exit 1
+fi
+
+tests/lsm-test --sync=1 --conf=$srcdir/tests/conf/lsm-device-test.conf
+err=$?
+if [[ $err -ne 0 ]]; then
+    exit $err
+fi
+
+tests/lsm-test --sync=3 --conf=$srcdir/tests/conf/lsm-device-test.conf
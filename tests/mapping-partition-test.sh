@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# runs mapping_test over several PEs with the "group" and "file" LP-to-PE
+# partitions; the mapping is checked by the LPs themselves at init and the
+# per-LP ids must match the serial run
+
+tst=$srcdir/tests
+set -e
+
+grep TEST2 $tst/expected/mapping_test.out | sort > mapping-partition-test.exp
+
+for part in group file ; do
+    mpirun -np 3 tests/mapping_test --sync=3 \
+        --codes-config=$tst/conf/mapping_test_$part.conf \
+        2> mapping-partition-test.err \
+        1| grep TEST2 | sort > mapping-partition-test.out
+
+    if [ -s mapping-partition-test.err ] ; then
+        echo ERROR: pe_partition=$part, see mapping-partition-test.err
+        exit 1
+    fi
+    diff mapping-partition-test.exp mapping-partition-test.out
+done
+
+rm mapping-partition-test.exp mapping-partition-test.out mapping-partition-test.err
+exit 0
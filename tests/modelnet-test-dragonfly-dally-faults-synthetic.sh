@@ -0,0 +1,9 @@
+#!/bin/bash
+
+src/network-workloads/model-net-synthetic-dally-dfly --sync=1 --num_messages=1 -- src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally-faults.conf
+err=$?
+if [[ $err -ne 0 ]]; then
+    exit $err
+fi
+
+mpirun -np 2 src/network-workloads/model-net-synthetic-dally-dfly --sync=3 --num_messages=1 -- src/network-workloads/conf/dragonfly-dally/modelnet-test-dragonfly-dally-faults.conf
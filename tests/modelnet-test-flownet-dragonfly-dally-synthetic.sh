@@ -0,0 +1,9 @@
+#!/bin/bash
+
+src/network-workloads/model-net-synthetic-generic --sync=1 -- src/network-workloads/conf/dragonfly-dally/modelnet-test-flownet-dragonfly-dally.conf
+err=$?
+if [[ $err -ne 0 ]]; then
+    exit $err
+fi
+
+mpirun -np 2 src/network-workloads/model-net-synthetic-generic --sync=3 -- src/network-workloads/conf/dragonfly-dally/modelnet-test-flownet-dragonfly-dally.conf
@@ -0,0 +1,14 @@
+#!/bin/bash
+
+if [ -z $srcdir ]; then
+    echo srcdir variable not set.
+    exit 1
+fi
+
+src/network-workloads/model-net-synthetic-generic --sync=1 -- $srcdir/src/network-workloads/conf/modelnet-synthetic-flownet.conf
+err=$?
+if [[ $err -ne 0 ]]; then
+    exit $err
+fi
+
+mpirun -np 2 src/network-workloads/model-net-synthetic-generic --sync=3 -- $srcdir/src/network-workloads/conf/modelnet-synthetic-flownet.conf
@@ -1,4 +1,10 @@
 #!/bin/bash
 
 src/network-workloads/model-net-synthetic-slimfly --sync=1 -- $srcdir/src/network-workloads/conf/modelnet-synthetic-slimfly-min.conf 
+err=$?
+if [[ $err -ne 0 ]]; then
+    exit $err
+fi
 
+# 3D nearest neighbor: six destinations per model_net_event_multi batch
+mpirun -np 2 src/network-workloads/model-net-synthetic-slimfly --sync=3 --traffic=5 -- $srcdir/src/network-workloads/conf/modelnet-synthetic-slimfly-min.conf
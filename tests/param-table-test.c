@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2014 University of Chicago.
+ * See COPYRIGHT notice in top-level directory.
+ *
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <ross.h>
+#include "codes/param-table.h"
+
+#define NROWS 6
+#define NCOLS 2
+
+static int close_to(double a, double b) { return fabs(a-b) < 1e-9; }
+
+int main()
+{
+    uint64_t keys[NROWS] = { 0, 8, 64, 65, 4096, 1ULL<<40 };
+    double vals[NROWS*NCOLS] = {
+        0.0, 100.0,
+        8.0, 108.0,
+        64.0, 164.0,
+        65.0, 165.0,
+        4096.0, 4196.0,
+        1.0, 2.0 };
+    double out[NCOLS];
+
+    struct codes_ptable *t;
+
+    /* floor / above index rules, including keys sharing a power of two and
+     * keys past either end of the table */
+    codes_ptable_create(NROWS, NCOLS, keys, vals, CODES_PTABLE_FLOOR, &t);
+    assert(NROWS == codes_ptable_rows(t));
+    assert(NCOLS == codes_ptable_cols(t));
+    assert(0 == codes_ptable_floor(t, 0));
+    assert(0 == codes_ptable_floor(t, 7));
+    assert(1 == codes_ptable_floor(t, 8));
+    assert(1 == codes_ptable_floor(t, 63));
+    assert(2 == codes_ptable_floor(t, 64));
+    assert(3 == codes_ptable_floor(t, 65));
+    assert(3 == codes_ptable_floor(t, 4095));
+    assert(4 == codes_ptable_floor(t, 4096));
+    assert(5 == codes_ptable_floor(t, UINT64_MAX));
+    assert(1 == codes_ptable_above(t, 0));
+    assert(2 == codes_ptable_above(t, 8));
+    assert(3 == codes_ptable_above(t, 64));
+    assert(4 == codes_ptable_above(t, 65));
+    assert(5 == codes_ptable_above(t, 1ULL<<39));
+    assert(5 == codes_ptable_above(t, UINT64_MAX));
+
+    codes_ptable_lookup(t, 100, out);
+    assert(close_to(out[0], 65.0) && close_to(out[1], 165.0));
+    codes_ptable_destroy(t);
+
+    codes_ptable_create(NROWS, NCOLS, keys, vals, CODES_PTABLE_ABOVE, &t);
+    codes_ptable_lookup(t, 100, out);
+    assert(close_to(out[0], 4096.0) && close_to(out[1], 4196.0));
+    codes_ptable_destroy(t);
+
+    /* interpolation, clamped at the table edges */
+    codes_ptable_create(NROWS, NCOLS, keys, vals, CODES_PTABLE_LINEAR, &t);
+    codes_ptable_lookup(t, 4, out);
+    assert(close_to(out[0], 4.0) && close_to(out[1], 104.0));
+    codes_ptable_lookup(t, 64, out);
+    assert(close_to(out[0], 64.0) && close_to(out[1], 164.0));
+    codes_ptable_lookup(t, 2080, out);
+    assert(close_to(out[0], 2080.0) && close_to(out[1], 2180.0));
+    codes_ptable_lookup(t, UINT64_MAX, out);
+    assert(close_to(out[0], 1.0) && close_to(out[1], 2.0));
+    codes_ptable_destroy(t);
+
+    /* duplicate keys and a single-row table */
+    uint64_t dkeys[3] = { 16, 16, 32 };
+    double dvals[3] = { 1.0, 2.0, 4.0 };
+    codes_ptable_create(3, 1, dkeys, dvals, CODES_PTABLE_LINEAR, &t);
+    assert(1 == codes_ptable_floor(t, 16));
+    codes_ptable_lookup(t, 24, out);
+    assert(close_to(out[0], 3.0));
+    codes_ptable_destroy(t);
+
+    codes_ptable_create(1, 1, dkeys, dvals, CODES_PTABLE_LINEAR, &t);
+    codes_ptable_lookup(t, 0, out);
+    assert(close_to(out[0], 1.0));
+    codes_ptable_lookup(t, 1000, out);
+    assert(close_to(out[0], 1.0));
+    codes_ptable_destroy(t);
+
+    assert(CODES_PTABLE_ABOVE ==
+            codes_ptable_mode_from_str("", CODES_PTABLE_ABOVE));
+    assert(CODES_PTABLE_FLOOR ==
+            codes_ptable_mode_from_str("step", CODES_PTABLE_FLOOR));
+    assert(CODES_PTABLE_LINEAR ==
+            codes_ptable_mode_from_str("linear", CODES_PTABLE_FLOOR));
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */